@@ -19,3 +19,8 @@
 # If you keep the line number information, uncomment this to
 # hide the original source file name.
 #-renamesourcefileattribute SourceFile
+
+# Fields accessed from JNI.
+-keep class me.zhanghai.android.libselinux.SelinuxOpt {
+    <fields>;
+}
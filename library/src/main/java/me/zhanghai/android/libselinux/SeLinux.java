@@ -11,24 +11,218 @@ import android.system.ErrnoException;
 import java.io.FileDescriptor;
 
 import androidx.annotation.NonNull;
+import androidx.annotation.Nullable;
 
 public class SeLinux {
 
+    public static final int AVC_OPT_SETENFORCE = 1;
+
+    public static final int AVC_CACHE_STATS_LOOKUPS = 0;
+    public static final int AVC_CACHE_STATS_HITS = 1;
+    public static final int AVC_CACHE_STATS_MISSES = 2;
+    public static final int AVC_CACHE_STATS_EVICTIONS = 3;
+    public static final int AVC_CACHE_STATS_PROBES = 4;
+    public static final int AVC_CACHE_STATS_CAPACITY = 5;
+    public static final int AVC_CACHE_STATS_SID_COUNT = 6;
+    public static final int AVC_CACHE_STATS_SID_CAPACITY = 7;
+    // Followed by AVC_CACHE_STATS_SID_PROBE_HISTOGRAM_SIZE counts of SIDs found after 1, 2, 3,
+    // 4, 5-8, 9-16, 17-32 and more probes.
+    public static final int AVC_CACHE_STATS_SID_PROBE_HISTOGRAM = 8;
+    public static final int AVC_CACHE_STATS_SID_PROBE_HISTOGRAM_SIZE = 8;
+
+    public static final int MLS_LEVELS_OP_DOMINATES = 0;
+    public static final int MLS_LEVELS_OP_EQUALS = 1;
+    public static final int MLS_LEVELS_OP_INTERSECTS = 2;
+    public static final int MLS_LEVELS_OP_CONTAINS = 3;
+
+    public static final int PROC_SCAN_ENTRY_PID = 0;
+    public static final int PROC_SCAN_ENTRY_TID = 1;
+    public static final int PROC_SCAN_ENTRY_CONTEXT = 2;
+    public static final int PROC_SCAN_ENTRY_SIZE = 3;
+
+    public static final int SELABEL_CTX_FILE = 0;
+    public static final int SELABEL_CTX_ANDROID_PROP = 4;
+    public static final int SELABEL_CTX_ANDROID_SERVICE = 5;
+
+    public static final int SELABEL_OPT_VALIDATE = 1;
+    public static final int SELABEL_OPT_BASEONLY = 2;
+    public static final int SELABEL_OPT_PATH = 3;
+    public static final int SELABEL_OPT_SUBSET = 4;
+    public static final int SELABEL_OPT_DIGEST = 5;
+
+    public static final int SELABEL_FOOTPRINT_SPECS = 0;
+    public static final int SELABEL_FOOTPRINT_STRINGS = 1;
+    public static final int SELABEL_FOOTPRINT_POOLED_STRINGS = 2;
+    public static final int SELABEL_FOOTPRINT_REGEXES = 3;
+    public static final int SELABEL_FOOTPRINT_JIT = 4;
+    public static final int SELABEL_FOOTPRINT_MAPPED = 5;
+
+    public static final int SELABEL_SPEC_STATS_LINE_NUMBER = 0;
+    public static final int SELABEL_SPEC_STATS_CANDIDATES = 1;
+    public static final int SELABEL_SPEC_STATS_MATCHES = 2;
+    public static final int SELABEL_SPEC_STATS_MATCH_NANOS = 3;
+    public static final int SELABEL_SPEC_STATS_SIZE = 4;
+
+    public static final int SEAPP_KIND_DOMAIN = 0;
+    public static final int SEAPP_KIND_TYPE = 1;
+
+    public static final int SEAPP_IS_SYSTEM_SERVER = 0x1;
+    public static final int SEAPP_IS_EPHEMERAL_APP = 0x2;
+    public static final int SEAPP_IS_PRIV_APP = 0x4;
+    public static final int SEAPP_FROM_RUN_AS = 0x8;
+    public static final int SEAPP_IS_ISOLATED_COMPUTE_APP = 0x10;
+    public static final int SEAPP_IS_SDK_SANDBOX_AUDIT = 0x20;
+    public static final int SEAPP_IS_SDK_SANDBOX_NEXT = 0x40;
+
     static {
         System.loadLibrary("selinux-jni");
     }
 
     private SeLinux() {}
 
+    /**
+     * Returns the {@code AVC_CACHE_STATS_*} counters of the cache in front of the AVC, and the
+     * occupancy of the SID table.
+     */
+    @NonNull
+    public static native long[] avc_cache_stats();
+
+    /**
+     * Returns the SIDs of the raw contexts that new objects of each target class would get when
+     * created by each source SID in each target SID, e.g. to predict the labels of files before
+     * creating them. Results are memoized until the next policy load, which needs the AVC to be
+     * open to be noticed.
+     */
+    @NonNull
+    public static native long[] avc_compute_create_batch(@NonNull long[] sourceSids,
+                                                         @NonNull long[] targetSids,
+                                                         @NonNull int[] targetClasses)
+            throws ErrnoException;
+
+    /**
+     * Returns the SID for the raw context, which stays valid for the lifetime of the process.
+     */
+    public static native long avc_context_to_sid(@NonNull byte[] context) throws ErrnoException;
+
+    public static native void avc_destroy();
+
+    /**
+     * Checks whether each source SID has the requested permissions on the target SID and class,
+     * without auditing. Bit {@code i % 64} of element {@code i / 64} of the result is set if query
+     * {@code i} is allowed.
+     */
+    @NonNull
+    public static native long[] avc_has_perm_batch(@NonNull long[] sourceSids,
+                                                   @NonNull long[] targetSids,
+                                                   @NonNull int[] targetClasses,
+                                                   @NonNull int[] requestedPermissions)
+            throws ErrnoException;
+
+    /**
+     * Opens the userspace AVC if it isn't open yet. {@link #AVC_OPT_SETENFORCE} with a non-null
+     * value makes it answer as if enforcing regardless of the kernel.
+     */
+    public static native void avc_open(@Nullable SelinuxOpt[] options) throws ErrnoException;
+
+    /**
+     * Computes the decisions recorded in a file saved by {@link #avc_save_recording(byte[])} into
+     * the open AVC, so that the first real queries hit. This takes a while for a large recording,
+     * so call it on a background thread after {@link #avc_open(SelinuxOpt[])} or a policy reload.
+     * Returns the number of decisions cached.
+     */
+    public static native int avc_prewarm(@NonNull byte[] path) throws ErrnoException;
+
+    /**
+     * Saves the source and target contexts and the class of every query that missed since
+     * recording started.
+     */
+    public static native void avc_save_recording(@NonNull byte[] path) throws ErrnoException;
+
+    /**
+     * Sets the number of decisions cached in front of the AVC, dropping the cached ones.
+     */
+    public static native void avc_set_cache_threshold(int threshold) throws ErrnoException;
+
+    /**
+     * Starts recording queries for {@link #avc_save_recording(byte[])}, discarding any previous
+     * recording, or stops and discards it.
+     */
+    public static native void avc_set_recording(boolean enabled) throws ErrnoException;
+
+    /**
+     * Returns the raw context of a SID from {@link #avc_context_to_sid(byte[])}.
+     */
+    @NonNull
+    public static native byte[] avc_sid_to_context(long sid);
+
+    @Nullable
+    public static native byte[] class_map_class_to_string(long map, int securityClass);
+
+    public static native void class_map_close(long map);
+
+    /**
+     * Loads the security classes and permissions of the loaded policy from selinuxfs, for
+     * resolving their names without a string scan. Load it again after a policy load that changes
+     * classes.
+     */
+    public static native long class_map_load() throws ErrnoException;
+
+    /**
+     * Returns the permission bit for each name in the corresponding class, or 0 if unknown.
+     */
+    @NonNull
+    public static native int[] class_map_string_to_av_perm_batch(long map,
+                                                                 @NonNull int[] securityClasses,
+                                                                 @NonNull byte[][] names)
+            throws ErrnoException;
+
+    /**
+     * Returns the class for each name, or 0 if unknown.
+     */
+    @NonNull
+    public static native int[] class_map_string_to_class_batch(long map, @NonNull byte[][] names)
+            throws ErrnoException;
+
     @NonNull
     public static native byte[] fgetfilecon(@NonNull FileDescriptor fd) throws ErrnoException;
 
+    /**
+     * Creates each path with its raw context already applied, as a directory if its mode has
+     * {@code S_IFDIR} set or otherwise as an empty regular file, so that no separate
+     * {@link #lsetfilecon(byte[], byte[])} is needed. {@code setfscreatecon()} is called once per
+     * distinct context, and the previous fscreate context of the calling thread is restored
+     * afterwards. Returns the {@code errno} for each path, or 0 if it was created.
+     */
+    @NonNull
+    public static native int[] file_label_create_batch(@NonNull byte[][] paths,
+                                                       @NonNull byte[][] contexts,
+                                                       @NonNull int[] modes)
+            throws ErrnoException;
+
+    /**
+     * Sets the raw context of each path like {@link #lsetfilecon(byte[], byte[])}, but only writes
+     * it if the current one differs. Stores the {@code errno} for each path, or 0, into
+     * {@code errors}, which must be as long as {@code paths}. Returns the number of writes skipped
+     * because the path already carried its context.
+     */
+    public static native int file_label_set_batch(@NonNull byte[][] paths,
+                                                  @NonNull byte[][] contexts,
+                                                  @NonNull int[] errors)
+            throws ErrnoException;
+
     public static native void fsetfilecon(@NonNull FileDescriptor fd, @NonNull byte[] context)
             throws ErrnoException;
 
     @NonNull
     public static native byte[] getfilecon(@NonNull byte[] path) throws ErrnoException;
 
+    /**
+     * Returns the context of the peer of a connected socket, like {@code getpeercon()} but taking
+     * the raw file descriptor number.
+     */
+    @NonNull
+    public static native byte[] getpeercon(int fd) throws ErrnoException;
+
     public static native boolean is_selinux_enabled();
 
     @NonNull
@@ -37,8 +231,273 @@ public class SeLinux {
     public static native void lsetfilecon(@NonNull byte[] path, @NonNull byte[] context)
             throws ErrnoException;
 
+    /**
+     * Adds MLS ranges like {@code s0-s0:c0.c1023} or levels like {@code s0:c512,c768}, or those of
+     * contexts if {@code areContexts}, to a pool that parses each unique one once. Returns the
+     * index of each in the pool, or -1 if it isn't valid.
+     */
+    @NonNull
+    public static native int[] mls_levels_add_batch(long levels, @NonNull byte[][] strings,
+                                                    boolean areContexts) throws ErrnoException;
+
+    public static native void mls_levels_close(long levels);
+
+    /**
+     * Compares the ranges at each pair of indices with one of the {@code MLS_LEVELS_OP_*}
+     * operations, which work on the low levels except for equality and containment of ranges. Bit
+     * {@code i % 64} of element {@code i / 64} of the result is set if the operation holds for
+     * pair {@code i}.
+     */
+    @NonNull
+    public static native long[] mls_levels_compare_batch(long levels, int op,
+                                                         @NonNull int[] indices1,
+                                                         @NonNull int[] indices2)
+            throws ErrnoException;
+
+    public static native long mls_levels_create() throws ErrnoException;
+
+    public static native void peer_contexts_close(long contexts);
+
+    /**
+     * Creates a thread-safe pool of socket peer contexts for
+     * {@link #peer_contexts_get(long, int)}.
+     */
+    public static native long peer_contexts_create() throws ErrnoException;
+
+    /**
+     * Returns the index of the context of the peer of a connected socket in the pool, which is the
+     * same for every peer with the same context. A server can then map indices to contexts once
+     * with {@link #peer_contexts_get_context(long, int)}, instead of getting a new {@code byte[]}
+     * for every connection like {@link #getpeercon(int)}.
+     */
+    public static native int peer_contexts_get(long contexts, int fd) throws ErrnoException;
+
+    @Nullable
+    public static native byte[] peer_contexts_get_context(long contexts, int index);
+
+    public static native void proc_scan_close(long scan);
+
+    /**
+     * Creates a scanner of process contexts, which keeps {@code /proc} open and its buffers across
+     * scans.
+     */
+    public static native long proc_scan_create() throws ErrnoException;
+
+    /**
+     * Returns the context of a {@link #PROC_SCAN_ENTRY_CONTEXT} index, which stays the same for
+     * the lifetime of the scanner.
+     */
+    @Nullable
+    public static native byte[] proc_scan_get_context(long scan, int context);
+
+    /**
+     * Scans the contexts of all processes, and of all their threads if {@code includeThreads}.
+     * Returns {@link #PROC_SCAN_ENTRY_SIZE} elements per process or thread, at the
+     * {@code PROC_SCAN_ENTRY_*} offsets.
+     */
+    @NonNull
+    public static native int[] proc_scan_run(long scan, boolean includeThreads)
+            throws ErrnoException;
+
+    /**
+     * Builds a trie over the property_contexts spec files, with the same matching rules as
+     * {@link #selabel_lookup(long, byte[], int)} on a {@link #SELABEL_CTX_ANDROID_PROP} handle.
+     */
+    public static native long property_trie_build(@NonNull byte[][] specFiles)
+            throws ErrnoException;
+
+    public static native void property_trie_close(long trie);
+
+    @NonNull
+    public static native byte[][] property_trie_get_contexts(long trie);
+
+    public static native long property_trie_load(@NonNull byte[] path) throws ErrnoException;
+
+    @NonNull
+    public static native byte[] property_trie_lookup(long trie, @NonNull byte[] name)
+            throws ErrnoException;
+
+    /**
+     * Returns the index into {@link #property_trie_get_contexts(long)} for each name, or -1 if
+     * there is no context for it.
+     */
+    @NonNull
+    public static native int[] property_trie_lookup_batch(long trie, @NonNull byte[][] names)
+            throws ErrnoException;
+
+    public static native void property_trie_save(long trie, @NonNull byte[] path)
+            throws ErrnoException;
+
+    /**
+     * Parses the seapp_contexts spec files into rules presorted by specificity and indexed by
+     * package name, with the same matching rules as android_seapp.c.
+     */
+    public static native long seapp_contexts_build(@NonNull byte[][] specFiles)
+            throws ErrnoException;
+
+    public static native void seapp_contexts_close(long contexts);
+
+    /**
+     * Returns the domain context for {@link #SEAPP_KIND_DOMAIN} or the app data directory context
+     * for {@link #SEAPP_KIND_TYPE}, with the level computed from {@code uid}. A {@code null}
+     * {@code user} is derived from {@code uid} for app, SDK sandbox and isolated uids.
+     */
+    @NonNull
+    public static native byte[] seapp_contexts_lookup(long contexts, int kind,
+                                                      @Nullable byte[] user,
+                                                      @Nullable byte[] seinfo,
+                                                      @Nullable byte[] name, int flags,
+                                                      int targetSdkVersion, int uid)
+            throws ErrnoException;
+
+    /**
+     * Looks up the contexts for the packages described by the parallel arrays, returning a
+     * {@code null} element for a package that matches no rule.
+     */
+    @NonNull
+    public static native byte[][] seapp_contexts_lookup_batch(long contexts, int kind,
+                                                              @Nullable byte[][] users,
+                                                              @Nullable byte[][] seinfos,
+                                                              @Nullable byte[][] names,
+                                                              @NonNull int[] flags,
+                                                              @NonNull int[] targetSdkVersions,
+                                                              @NonNull int[] uids)
+            throws ErrnoException;
+
     public static native boolean security_getenforce() throws ErrnoException;
 
+    public static native void selabel_close(long handle);
+
+    public static native void selabel_concurrent_close(long handle);
+
+    @NonNull
+    public static native long[] selabel_concurrent_get_footprint(long handle)
+            throws ErrnoException;
+
+    /**
+     * Returns {@link #SELABEL_SPEC_STATS_SIZE} values for each spec of an instrumented file_contexts
+     * handle, in file order.
+     */
+    @NonNull
+    public static native long[] selabel_concurrent_get_spec_stats(long handle);
+
+    @NonNull
+    public static native byte[] selabel_concurrent_lookup(long handle, @NonNull byte[] key,
+                                                          int type) throws ErrnoException;
+
+    /**
+     * Opens a label handle for lookups from many threads at once, which don't take any lock for
+     * file_contexts. If {@code instrumented} is true, lookups also collect stats per spec.
+     */
+    public static native long selabel_concurrent_open(int backend,
+                                                      @Nullable SelinuxOpt[] options,
+                                                      boolean instrumented)
+            throws ErrnoException;
+
+    /**
+     * Returns the bytes used by a file_contexts handle, indexed by the
+     * {@code SELABEL_FOOTPRINT_*} constants.
+     */
+    @NonNull
+    public static native long[] selabel_get_footprint(long handle) throws ErrnoException;
+
+    @NonNull
+    public static native byte[] selabel_lookup(long handle, @NonNull byte[] key, int type)
+            throws ErrnoException;
+
+    public static native long selabel_open(int backend, @Nullable SelinuxOpt[] options)
+            throws ErrnoException;
+
+    public static native void selabel_reloadable_close(long handle);
+
+    @NonNull
+    public static native byte[] selabel_reloadable_lookup(long handle, @NonNull byte[] key,
+                                                          int type) throws ErrnoException;
+
+    /**
+     * Opens a label handle that can be reloaded without blocking concurrent lookups.
+     */
+    public static native long selabel_reloadable_open(int backend,
+                                                      @Nullable SelinuxOpt[] options)
+            throws ErrnoException;
+
+    /**
+     * Reloads the handle if its spec files changed and their digest differs, or unconditionally
+     * if {@code force} is true. Returns whether a new handle was swapped in.
+     */
+    public static native boolean selabel_reloadable_reload(long handle, boolean force)
+            throws ErrnoException;
+
+    public static native void selabel_reloadable_reload_async(long handle, boolean force)
+            throws ErrnoException;
+
+    /**
+     * Returns the enforcing mode like {@link #security_getenforce()}, but from the status page of
+     * selinuxfs, which is mapped once and then read without any system call.
+     */
+    public static native boolean selinux_status_getenforce() throws ErrnoException;
+
+    /**
+     * Returns whether a policy was loaded since {@link #selinux_status_policyload()} returned
+     * {@code policyload}, without any system call if the status page is available. Returns
+     * {@code true} if the status can't be read.
+     */
+    public static native boolean selinux_status_policy_changed(int policyload);
+
+    /**
+     * Returns the number of policy loads from the status page, which is only meaningful for
+     * comparing with a later value.
+     */
+    public static native int selinux_status_policyload() throws ErrnoException;
+
+    /**
+     * Checks whether each raw context is valid like {@code security_check_context()}, with each
+     * unique context not yet in the validation cache checked once. Bit {@code i % 64} of element
+     * {@code i / 64} of the result is set if context {@code i} is valid. The cache is flushed when
+     * a policy load is seen.
+     */
+    @NonNull
+    public static native long[] selinux_validate_batch(@NonNull byte[][] contexts)
+            throws ErrnoException;
+
+    /**
+     * Validates the unique contexts in the spec files with up to {@code threadCount} threads ahead
+     * of a {@link #selabel_open(int, SelinuxOpt[])} with {@link #SELABEL_OPT_VALIDATE}, which will
+     * then only hit the validation cache.
+     */
+    public static native void selinux_validate_prefetch(@NonNull byte[][] specFiles,
+                                                        int threadCount) throws ErrnoException;
+
+    /**
+     * Builds a hash table over the service_contexts spec files, with the same matching rules as
+     * {@link #selabel_lookup(long, byte[], int)} on a {@link #SELABEL_CTX_ANDROID_SERVICE} handle.
+     */
+    public static native long service_table_build(@NonNull byte[][] specFiles)
+            throws ErrnoException;
+
+    public static native void service_table_close(long table);
+
+    @NonNull
+    public static native byte[][] service_table_get_contexts(long table);
+
+    @NonNull
+    public static native byte[] service_table_lookup(long table, @NonNull byte[] name)
+            throws ErrnoException;
+
+    /**
+     * Returns the index into {@link #service_table_get_contexts(long)} for each name, or -1 if
+     * there is no context for it.
+     */
+    @NonNull
+    public static native int[] service_table_lookup_batch(long table, @NonNull byte[][] names)
+            throws ErrnoException;
+
     public static native void setfilecon(@NonNull byte[] path, @NonNull byte[] context)
             throws ErrnoException;
+
+    public static native int string_to_av_perm(int targetClass, @NonNull byte[] name)
+            throws ErrnoException;
+
+    public static native int string_to_security_class(@NonNull byte[] name)
+            throws ErrnoException;
 }
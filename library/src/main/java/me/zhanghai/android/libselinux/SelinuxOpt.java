@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+package me.zhanghai.android.libselinux;
+
+import androidx.annotation.Nullable;
+
+/**
+ * {@code struct selinux_opt}. For boolean options like {@link SeLinux#SELABEL_OPT_VALIDATE}, any
+ * non-null value means true.
+ */
+public final class SelinuxOpt {
+
+    public final int type;
+
+    @Nullable
+    public final byte[] value;
+
+    public SelinuxOpt(int type, @Nullable byte[] value) {
+        this.type = type;
+        this.value = value;
+    }
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "atomic_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int atomic_file_write(const char *path, const void *data, size_t size) {
+    char *temporaryPath;
+    if (asprintf(&temporaryPath, "%s.tmp", path) == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int fd = TEMP_FAILURE_RETRY(open(temporaryPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                                     0644));
+    if (fd == -1) {
+        int savedErrno = errno;
+        free(temporaryPath);
+        errno = savedErrno;
+        return -1;
+    }
+    int result = 0;
+    for (size_t written = 0; written < size; ) {
+        ssize_t writeResult = TEMP_FAILURE_RETRY(write(fd, (const char *) data + written,
+                                                       size - written));
+        if (writeResult == -1) {
+            result = -1;
+            break;
+        }
+        written += (size_t) writeResult;
+    }
+    if (!result) {
+        result = fsync(fd);
+    }
+    int savedErrno = errno;
+    close(fd);
+    if (!result) {
+        result = rename(temporaryPath, path);
+        savedErrno = errno;
+    }
+    if (result) {
+        unlink(temporaryPath);
+    }
+    free(temporaryPath);
+    errno = savedErrno;
+    return result;
+}
+
+void *atomic_file_read(const char *path, size_t *outSize) {
+    int fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1) {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return NULL;
+    }
+    size_t size = (size_t) fileStat.st_size;
+    // One more byte so that an empty file still gets a buffer.
+    char *data = malloc(size + 1);
+    if (!data) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    size_t readSize = 0;
+    while (readSize < size) {
+        ssize_t readResult = TEMP_FAILURE_RETRY(read(fd, data + readSize, size - readSize));
+        if (readResult <= 0) {
+            int savedErrno = readResult ? errno : EIO;
+            free(data);
+            close(fd);
+            errno = savedErrno;
+            return NULL;
+        }
+        readSize += (size_t) readResult;
+    }
+    close(fd);
+    *outSize = size;
+    return data;
+}
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_ATOMIC_FILE_H
+#define LIBSELINUX_JNI_ATOMIC_FILE_H
+
+#include <stddef.h>
+
+// Writes the data to a temporary file next to path and renames it over path, so that readers
+// never see a partial file. Returns 0 on success, or -1 with errno set.
+int atomic_file_write(const char *path, const void *data, size_t size);
+
+// Reads the whole file into a newly allocated buffer. Returns the buffer with its size in
+// outSize, or NULL with errno set.
+void *atomic_file_read(const char *path, size_t *outSize);
+
+#endif // LIBSELINUX_JNI_ATOMIC_FILE_H
@@ -0,0 +1,993 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "avc_query.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <selinux/selinux.h>
+
+#include "class_map.h"
+#include "decision_set.h"
+#include "hash.h"
+#include "reader_epoch.h"
+#include "status_page.h"
+
+#define BUCKET_WAYS 8
+
+// The same default as AVC_CACHE_THRESHOLD in avc.c.
+#define DEFAULT_CACHE_THRESHOLD 512
+
+// The number of decisions prewarmed per hold of avcMutex, so that real queries aren't held up
+// behind a whole prewarm.
+#define PREWARM_BATCH_SIZE 64
+
+// The create memo is dropped when it grows beyond this, since a workload rarely needs more and
+// the memo doesn't evict.
+#define CREATE_MEMO_MAX_COUNT 65536
+
+// CPUs beyond this share counters.
+#define COUNTER_CPU_COUNT 32
+
+#define ENTRY_PERMISSIVE 0x1
+#define ENTRY_ENFORCING 0x2
+
+// A decision of the AVC as seen by avc_has_perm_noaudit().
+struct FrontCacheEntry {
+    // Valid only if equal to frontCacheGeneration.
+    unsigned int generation;
+    security_id_t sourceSid;
+    security_id_t targetSid;
+    security_class_t targetClass;
+    access_vector_t allowed;
+    // ENTRY_PERMISSIVE if the AVC was seen granting something outside allowed, because either it
+    // or the domain is permissive, and ENTRY_ENFORCING if it was seen denying something.
+    unsigned int flags;
+};
+
+// A set of entries published with a seqlock, so that hits never take avcMutex. Writers hold
+// avcMutex, and replace entries with CLOCK, a.k.a. second chance, within the set.
+struct FrontCacheBucket {
+    // Odd while being written.
+    unsigned int sequence;
+    // Only touched by writers.
+    unsigned int hand;
+    // Set by hits outside the seqlock, and cleared as the hand passes.
+    unsigned char referenced[BUCKET_WAYS];
+    struct FrontCacheEntry entries[BUCKET_WAYS];
+};
+
+struct FrontCache {
+    size_t bucketMask;
+    struct FrontCacheBucket buckets[];
+};
+
+static pthread_mutex_t avcMutex = PTHREAD_MUTEX_INITIALIZER;
+static bool avcOpen = false;
+
+// Replaced when resized. Batches use it without a lock, and a resize waits for them before freeing
+// the old cache.
+static struct FrontCache *frontCache;
+static struct reader_epoch frontCacheReaderEpoch;
+static unsigned int cacheThreshold = DEFAULT_CACHE_THRESHOLD;
+// Advanced on open, close, policy load and enforcing changes. Starts at 1 so that zeroed entries
+// are invalid.
+static unsigned int frontCacheGeneration = 1;
+// The sequence of the kernel status that the caches were last brought up to date with.
+static uint32_t syncedStatusSequence;
+
+// Counters are kept per CPU so that concurrent batches don't bounce a shared cacheline, and are
+// only summed up when read. A thread may migrate while adding to them, so additions are still
+// atomic, but almost never contended.
+struct CpuCounters {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t probes;
+} __attribute__((aligned(64)));
+
+static struct CpuCounters cpuCounters[COUNTER_CPU_COUNT];
+
+static struct sid_table *sidTable;
+
+// Non-NULL while recording. Taken inside avcMutex by misses, and alone by saving.
+static pthread_mutex_t recordingMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct decision_set *recording;
+
+// Resolves class names for recording and prewarming instead of the class cache of stringrep.c,
+// which isn't thread safe and is also used without a lock by the bindings of
+// string_to_security_class(). classMapMutex guards the map and is taken inside avcMutex, while
+// loads read selinuxfs holding only classMapLoadMutex. classMapGeneration is advanced under
+// avcMutex when a policy load may have changed the classes.
+static pthread_mutex_t classMapMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t classMapLoadMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct class_map *classMap;
+static unsigned int classMapLoadedGeneration;
+static unsigned int classMapGeneration;
+
+// Memoized results of security_compute_create_raw(), keyed by interned SIDs and guarded by
+// avcMutex. The AVC invokes our callbacks with avcMutex held, so a policy load can simply mark it
+// stale.
+struct CreateMemoEntry {
+    security_id_t sourceSid;
+    security_id_t targetSid;
+    security_class_t targetClass;
+    security_id_t newSid;
+};
+
+static struct CreateMemoEntry *createMemo;
+static size_t createMemoCount;
+static size_t createMemoCapacity;
+static bool createMemoStale;
+// Advanced whenever the memo is marked stale, so that answers computed across a policy load
+// aren't memoized.
+static unsigned int createMemoGeneration;
+
+static union selinux_callback previousSetenforceCallback;
+static union selinux_callback previousPolicyloadCallback;
+
+static void invalidateFrontCache(void) {
+    __atomic_fetch_add(&frontCacheGeneration, 1, __ATOMIC_RELEASE);
+}
+
+// Must be called with avcMutex held.
+static void invalidateCreateMemoLocked(void) {
+    createMemoStale = true;
+    ++createMemoGeneration;
+}
+
+// Must be called with avcMutex held.
+static void invalidateClassMapLocked(void) {
+    __atomic_fetch_add(&classMapGeneration, 1, __ATOMIC_RELEASE);
+}
+
+static int setenforceCallback(int enforcing) {
+    invalidateFrontCache();
+    return previousSetenforceCallback.func_setenforce(enforcing);
+}
+
+static int policyloadCallback(int seqno) {
+    invalidateFrontCache();
+    invalidateCreateMemoLocked();
+    invalidateClassMapLocked();
+    return previousPolicyloadCallback.func_policyload(seqno);
+}
+
+static void installCallbacks(void) {
+    previousSetenforceCallback = selinux_get_callback(SELINUX_CB_SETENFORCE);
+    previousPolicyloadCallback = selinux_get_callback(SELINUX_CB_POLICYLOAD);
+    union selinux_callback callback;
+    callback.func_setenforce = setenforceCallback;
+    selinux_set_callback(SELINUX_CB_SETENFORCE, callback);
+    callback.func_policyload = policyloadCallback;
+    selinux_set_callback(SELINUX_CB_POLICYLOAD, callback);
+}
+
+// Returns whether the caches may be behind the kernel, without any system call if the status page
+// is mapped.
+static bool isStatusChanged(bool *hasStatus, uint32_t *sequence) {
+    struct status_page_state state;
+    *hasStatus = !status_page_read(&state);
+    if (!*hasStatus) {
+        return true;
+    }
+    *sequence = state.sequence;
+    return state.sequence != __atomic_load_n(&syncedStatusSequence, __ATOMIC_RELAXED);
+}
+
+// Brings the AVC and our caches up to date with the kernel.
+static void syncStatusLocked(bool hasStatus, uint32_t sequence) {
+    // The kernel sends the netlink notification before it updates the status page, so the AVC can
+    // process it by now, which also invokes our callbacks.
+    avc_netlink_check_nb();
+    if (hasStatus && sequence != syncedStatusSequence) {
+        // In case the AVC doesn't get notifications, e.g. with its own netlink thread.
+        invalidateFrontCache();
+        invalidateCreateMemoLocked();
+        invalidateClassMapLocked();
+        __atomic_store_n(&syncedStatusSequence, sequence, __ATOMIC_RELAXED);
+    }
+}
+
+static struct FrontCache *newFrontCache(unsigned int threshold) {
+    size_t bucketCount = 1;
+    while (bucketCount * BUCKET_WAYS < threshold) {
+        bucketCount *= 2;
+    }
+    struct FrontCache *cache = calloc(1, sizeof(*cache) + bucketCount * sizeof(*cache->buckets));
+    if (!cache) {
+        return NULL;
+    }
+    cache->bucketMask = bucketCount - 1;
+    return cache;
+}
+
+// Must be called with avcMutex held.
+static void replaceFrontCacheLocked(struct FrontCache *newCache) {
+    struct FrontCache *oldCache = __atomic_exchange_n(&frontCache, newCache, __ATOMIC_SEQ_CST);
+    reader_epoch_synchronize(&frontCacheReaderEpoch);
+    free(oldCache);
+}
+
+static struct FrontCache *acquireFrontCache(unsigned int *outReaderIndex) {
+    *outReaderIndex = reader_epoch_enter(&frontCacheReaderEpoch);
+    return __atomic_load_n(&frontCache, __ATOMIC_SEQ_CST);
+}
+
+static void releaseFrontCache(unsigned int readerIndex) {
+    reader_epoch_leave(&frontCacheReaderEpoch, readerIndex);
+}
+
+int avc_query_open(const struct selinux_opt *options, unsigned int optionCount) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, installCallbacks);
+    pthread_mutex_lock(&avcMutex);
+    int result = 0;
+    if (!avcOpen) {
+        if (!frontCache) {
+            struct FrontCache *cache = newFrontCache(cacheThreshold);
+            if (cache) {
+                __atomic_store_n(&frontCache, cache, __ATOMIC_RELEASE);
+            } else {
+                errno = ENOMEM;
+                result = -1;
+            }
+        }
+        if (!result) {
+            result = avc_open((struct selinux_opt *) options, optionCount);
+        }
+        if (!result) {
+            invalidateFrontCache();
+            // The policy may have been reloaded while nobody was listening.
+            invalidateCreateMemoLocked();
+            __atomic_store_n(&avcOpen, true, __ATOMIC_RELEASE);
+        }
+    }
+    int savedErrno = errno;
+    pthread_mutex_unlock(&avcMutex);
+    errno = savedErrno;
+    return result;
+}
+
+void avc_query_close(void) {
+    pthread_mutex_lock(&avcMutex);
+    if (avcOpen) {
+        // The next open may have different options.
+        __atomic_store_n(&avcOpen, false, __ATOMIC_RELEASE);
+        invalidateFrontCache();
+        avc_destroy();
+    }
+    pthread_mutex_unlock(&avcMutex);
+}
+
+int avc_query_set_cache_threshold(unsigned int threshold) {
+    if (!threshold) {
+        errno = EINVAL;
+        return -1;
+    }
+    pthread_mutex_lock(&avcMutex);
+    int result = 0;
+    struct FrontCache *cache = newFrontCache(threshold);
+    if (cache) {
+        cacheThreshold = threshold;
+        replaceFrontCacheLocked(cache);
+    } else {
+        errno = ENOMEM;
+        result = -1;
+    }
+    int savedErrno = errno;
+    pthread_mutex_unlock(&avcMutex);
+    errno = savedErrno;
+    return result;
+}
+
+static void addCpuCounters(const struct CpuCounters *counters) {
+    int cpu = sched_getcpu();
+    struct CpuCounters *cpuCounter = &cpuCounters[cpu > 0 ? cpu % COUNTER_CPU_COUNT : 0];
+    __atomic_fetch_add(&cpuCounter->lookups, counters->lookups, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&cpuCounter->hits, counters->hits, __ATOMIC_RELAXED);
+    if (counters->misses) {
+        __atomic_fetch_add(&cpuCounter->misses, counters->misses, __ATOMIC_RELAXED);
+    }
+    if (counters->evictions) {
+        __atomic_fetch_add(&cpuCounter->evictions, counters->evictions, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&cpuCounter->probes, counters->probes, __ATOMIC_RELAXED);
+}
+
+void avc_query_get_cache_stats(struct avc_query_cache_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < COUNTER_CPU_COUNT; ++i) {
+        const struct CpuCounters *cpuCounter = &cpuCounters[i];
+        stats->lookups += __atomic_load_n(&cpuCounter->lookups, __ATOMIC_RELAXED);
+        stats->hits += __atomic_load_n(&cpuCounter->hits, __ATOMIC_RELAXED);
+        stats->misses += __atomic_load_n(&cpuCounter->misses, __ATOMIC_RELAXED);
+        stats->evictions += __atomic_load_n(&cpuCounter->evictions, __ATOMIC_RELAXED);
+        stats->probes += __atomic_load_n(&cpuCounter->probes, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_lock(&avcMutex);
+    stats->capacity = frontCache ? (frontCache->bucketMask + 1) * BUCKET_WAYS : 0;
+    pthread_mutex_unlock(&avcMutex);
+    struct sid_table *table = __atomic_load_n(&sidTable, __ATOMIC_ACQUIRE);
+    if (table) {
+        sid_table_get_stats(table, &stats->sid_table);
+    }
+}
+
+static void createSidTable(void) {
+    __atomic_store_n(&sidTable, sid_table_create(), __ATOMIC_RELEASE);
+}
+
+int avc_query_context_to_sid(const char *context, security_id_t *sid) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, createSidTable);
+    if (!sidTable) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return sid_table_context_to_sid(sidTable, context, sid);
+}
+
+static struct FrontCacheBucket *getFrontCacheBucket(struct FrontCache *cache,
+                                                    security_id_t sourceSid,
+                                                    security_id_t targetSid,
+                                                    security_class_t targetClass) {
+    uint64_t hash = (uint64_t) (uintptr_t) sourceSid * UINT64_C(0x9e3779b97f4a7c15)
+            ^ (uint64_t) (uintptr_t) targetSid * UINT64_C(0xc2b2ae3d27d4eb4f) ^ targetClass;
+    hash ^= hash >> 29;
+    return &cache->buckets[hash & cache->bucketMask];
+}
+
+static bool entryMatches(const struct FrontCacheEntry *entry, security_id_t sourceSid,
+                         security_id_t targetSid, security_class_t targetClass) {
+    return __atomic_load_n(&entry->sourceSid, __ATOMIC_RELAXED) == sourceSid
+            && __atomic_load_n(&entry->targetSid, __ATOMIC_RELAXED) == targetSid
+            && __atomic_load_n(&entry->targetClass, __ATOMIC_RELAXED) == targetClass;
+}
+
+// Returns whether the front cache has a decision for the query, without taking any lock.
+static bool lookupFrontCache(struct FrontCache *cache, security_id_t sourceSid,
+                             security_id_t targetSid, security_class_t targetClass,
+                             access_vector_t requested, bool *outAllowed,
+                             struct CpuCounters *counters) {
+    struct FrontCacheBucket *bucket = getFrontCacheBucket(cache, sourceSid, targetSid,
+                                                          targetClass);
+    unsigned int sequence = __atomic_load_n(&bucket->sequence, __ATOMIC_ACQUIRE);
+    if (sequence & 1) {
+        return false;
+    }
+    size_t way;
+    for (way = 0; way < BUCKET_WAYS; ++way) {
+        if (entryMatches(&bucket->entries[way], sourceSid, targetSid, targetClass)) {
+            break;
+        }
+    }
+    counters->probes += way < BUCKET_WAYS ? way + 1 : BUCKET_WAYS;
+    if (way == BUCKET_WAYS) {
+        return false;
+    }
+    const struct FrontCacheEntry *entry = &bucket->entries[way];
+    unsigned int generation = __atomic_load_n(&entry->generation, __ATOMIC_RELAXED);
+    access_vector_t allowed = __atomic_load_n(&entry->allowed, __ATOMIC_RELAXED);
+    unsigned int flags = __atomic_load_n(&entry->flags, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&bucket->sequence, __ATOMIC_RELAXED) != sequence
+            || generation != __atomic_load_n(&frontCacheGeneration, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    bool known = true;
+    if (!(requested & ~allowed) || flags & ENTRY_PERMISSIVE) {
+        *outAllowed = true;
+    } else if (flags & ENTRY_ENFORCING) {
+        *outAllowed = false;
+    } else {
+        // We don't know yet whether the AVC would enforce this denial.
+        known = false;
+    }
+    // Avoid dirtying the cacheline when it's already set.
+    if (known && !__atomic_load_n(&bucket->referenced[way], __ATOMIC_RELAXED)) {
+        __atomic_store_n(&bucket->referenced[way], 1, __ATOMIC_RELAXED);
+    }
+    if (known) {
+        ++counters->hits;
+    }
+    return known;
+}
+
+// Must be called with avcMutex held.
+static void updateFrontCacheLocked(struct FrontCache *cache, security_id_t sourceSid,
+                                   security_id_t targetSid, security_class_t targetClass,
+                                   access_vector_t requested, const struct av_decision *decision,
+                                   bool allowed, unsigned int generation,
+                                   struct CpuCounters *counters) {
+    struct FrontCacheBucket *bucket = getFrontCacheBucket(cache, sourceSid, targetSid,
+                                                          targetClass);
+    unsigned int currentGeneration = __atomic_load_n(&frontCacheGeneration, __ATOMIC_ACQUIRE);
+    size_t way;
+    for (way = 0; way < BUCKET_WAYS; ++way) {
+        if (entryMatches(&bucket->entries[way], sourceSid, targetSid, targetClass)) {
+            break;
+        }
+    }
+    unsigned int flags = 0;
+    if (way < BUCKET_WAYS && bucket->entries[way].generation == generation) {
+        flags = bucket->entries[way].flags;
+    } else if (way == BUCKET_WAYS) {
+        // Prefer a stale entry, and otherwise give referenced entries a second chance. This takes
+        // at most two turns of the hand.
+        for (way = 0; way < BUCKET_WAYS; ++way) {
+            if (bucket->entries[way].generation != currentGeneration) {
+                break;
+            }
+        }
+        if (way == BUCKET_WAYS) {
+            for (;;) {
+                way = bucket->hand;
+                bucket->hand = (bucket->hand + 1) % BUCKET_WAYS;
+                if (!__atomic_load_n(&bucket->referenced[way], __ATOMIC_RELAXED)) {
+                    break;
+                }
+                __atomic_store_n(&bucket->referenced[way], 0, __ATOMIC_RELAXED);
+            }
+            ++counters->evictions;
+        }
+    }
+    if (allowed && requested & ~decision->allowed) {
+        flags |= ENTRY_PERMISSIVE;
+    } else if (!allowed) {
+        flags |= ENTRY_ENFORCING;
+    }
+    struct FrontCacheEntry *entry = &bucket->entries[way];
+    unsigned int sequence = bucket->sequence;
+    __atomic_store_n(&bucket->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&entry->generation, generation, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->sourceSid, sourceSid, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->targetSid, targetSid, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->targetClass, targetClass, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->allowed, decision->allowed, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->flags, flags, __ATOMIC_RELAXED);
+    __atomic_store_n(&bucket->sequence, sequence + 2, __ATOMIC_RELEASE);
+    // A new entry starts unreferenced, so that one-off queries are the first to go.
+    __atomic_store_n(&bucket->referenced[way], 0, __ATOMIC_RELAXED);
+}
+
+// Loads the class map if there is none yet or a policy load has made it stale. Returns 0 on
+// success, or -1 with errno set. Must not be called with avcMutex held.
+static int refreshClassMap(void) {
+    pthread_mutex_lock(&classMapLoadMutex);
+    // Read before loading, so that a policy load in the middle leaves the new map stale.
+    unsigned int generation = __atomic_load_n(&classMapGeneration, __ATOMIC_ACQUIRE);
+    pthread_mutex_lock(&classMapMutex);
+    bool stale = !classMap || classMapLoadedGeneration != generation;
+    pthread_mutex_unlock(&classMapMutex);
+    int result = 0;
+    if (stale) {
+        struct class_map *map = class_map_load();
+        if (map) {
+            pthread_mutex_lock(&classMapMutex);
+            struct class_map *oldMap = classMap;
+            classMap = map;
+            classMapLoadedGeneration = generation;
+            pthread_mutex_unlock(&classMapMutex);
+            if (oldMap) {
+                class_map_destroy(oldMap);
+            }
+        } else {
+            result = -1;
+        }
+    }
+    int savedErrno = errno;
+    pthread_mutex_unlock(&classMapLoadMutex);
+    errno = savedErrno;
+    return result;
+}
+
+// Only the first miss of each tuple gets here, so recording costs nothing on hits.
+static void recordDecision(security_id_t sourceSid, security_id_t targetSid,
+                           security_class_t targetClass) {
+    if (!__atomic_load_n(&recording, __ATOMIC_RELAXED)) {
+        return;
+    }
+    int savedErrno = errno;
+    pthread_mutex_lock(&classMapMutex);
+    // Skipped while the map is stale, until the next batch loads it again.
+    if (classMap && classMapLoadedGeneration == __atomic_load_n(&classMapGeneration,
+                                                                __ATOMIC_RELAXED)) {
+        const char *className = class_map_class_to_string(classMap, targetClass);
+        if (className) {
+            pthread_mutex_lock(&recordingMutex);
+            if (recording) {
+                // Best effort, a tuple missing from the recording only means a colder start.
+                decision_set_add(recording, sourceSid->ctx, targetSid->ctx, className);
+            }
+            pthread_mutex_unlock(&recordingMutex);
+        }
+    }
+    pthread_mutex_unlock(&classMapMutex);
+    errno = savedErrno;
+}
+
+int avc_query_has_perm_batch(const security_id_t *sourceSids, const security_id_t *targetSids,
+                             const security_class_t *targetClasses,
+                             const access_vector_t *requestedPermissions, size_t count,
+                             uint64_t *decisions) {
+    memset(decisions, 0, (count + 63) / 64 * sizeof(*decisions));
+    if (!__atomic_load_n(&avcOpen, __ATOMIC_ACQUIRE)) {
+        errno = EBADF;
+        return -1;
+    }
+    // Counted locally and added to the counters of this CPU once per batch.
+    struct CpuCounters counters = {};
+    counters.lookups = count;
+    unsigned int readerIndex;
+    struct FrontCache *cache = acquireFrontCache(&readerIndex);
+    // Answer what we can without a lock, and leave the rest to a single locked pass.
+    size_t firstMissIndex = count;
+    bool hasStatus;
+    uint32_t statusSequence = 0;
+    if (isStatusChanged(&hasStatus, &statusSequence)) {
+        firstMissIndex = 0;
+    }
+    for (size_t i = 0; i < firstMissIndex; ++i) {
+        bool allowed;
+        if (!lookupFrontCache(cache, sourceSids[i], targetSids[i], targetClasses[i],
+                              requestedPermissions[i], &allowed, &counters)) {
+            firstMissIndex = i;
+            break;
+        }
+        if (allowed) {
+            decisions[i / 64] |= UINT64_C(1) << (i % 64);
+        }
+    }
+    releaseFrontCache(readerIndex);
+    if (firstMissIndex == count) {
+        addCpuCounters(&counters);
+        return 0;
+    }
+    if (__atomic_load_n(&recording, __ATOMIC_RELAXED)) {
+        // Best effort like recording itself, and before taking avcMutex since it reads selinuxfs.
+        refreshClassMap();
+    }
+    pthread_mutex_lock(&avcMutex);
+    // Resizes happen under avcMutex, so the cache can't go away while we hold it.
+    cache = frontCache;
+    int result = 0;
+    if (!avcOpen) {
+        errno = EBADF;
+        result = -1;
+    } else {
+        syncStatusLocked(hasStatus, statusSequence);
+    }
+    for (size_t i = firstMissIndex; !result && i < count; ++i) {
+        bool allowed;
+        if (i != firstMissIndex && lookupFrontCache(cache, sourceSids[i], targetSids[i],
+                                                    targetClasses[i], requestedPermissions[i],
+                                                    &allowed, &counters)) {
+            if (allowed) {
+                decisions[i / 64] |= UINT64_C(1) << (i % 64);
+            }
+            continue;
+        }
+        // Misses are computed by the kernel and cached, hits never leave the AVC. No auditing,
+        // since these are queries rather than accesses. A notification processed inside the AVC
+        // may advance the generation, so read it before.
+        unsigned int generation = __atomic_load_n(&frontCacheGeneration, __ATOMIC_ACQUIRE);
+        struct avc_entry_ref entryRef;
+        avc_entry_ref_init(&entryRef);
+        struct av_decision decision;
+        if (!avc_has_perm_noaudit(sourceSids[i], targetSids[i], targetClasses[i],
+                                  requestedPermissions[i], &entryRef, &decision)) {
+            allowed = true;
+        } else if (errno == EACCES) {
+            allowed = false;
+        } else {
+            result = -1;
+            break;
+        }
+        ++counters.misses;
+        recordDecision(sourceSids[i], targetSids[i], targetClasses[i]);
+        if (allowed) {
+            decisions[i / 64] |= UINT64_C(1) << (i % 64);
+        }
+        updateFrontCacheLocked(cache, sourceSids[i], targetSids[i], targetClasses[i],
+                               requestedPermissions[i], &decision, allowed, generation,
+                               &counters);
+    }
+    int savedErrno = errno;
+    pthread_mutex_unlock(&avcMutex);
+    addCpuCounters(&counters);
+    errno = savedErrno;
+    return result;
+}
+
+int avc_query_set_recording(bool enabled) {
+    struct decision_set *newRecording = NULL;
+    if (enabled) {
+        if (refreshClassMap()) {
+            return -1;
+        }
+        newRecording = decision_set_create();
+        if (!newRecording) {
+            return -1;
+        }
+    }
+    pthread_mutex_lock(&recordingMutex);
+    struct decision_set *oldRecording = recording;
+    __atomic_store_n(&recording, newRecording, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&recordingMutex);
+    if (oldRecording) {
+        decision_set_destroy(oldRecording);
+    }
+    return 0;
+}
+
+int avc_query_save_recording(const char *path) {
+    pthread_mutex_lock(&recordingMutex);
+    int result;
+    if (recording) {
+        result = decision_set_save(recording, path);
+    } else {
+        errno = EINVAL;
+        result = -1;
+    }
+    int savedErrno = errno;
+    pthread_mutex_unlock(&recordingMutex);
+    errno = savedErrno;
+    return result;
+}
+
+struct PrewarmQuery {
+    security_id_t sourceSid;
+    security_id_t targetSid;
+    const char *className;
+    // Resolved through the class map, before taking avcMutex.
+    security_class_t targetClass;
+};
+
+// Resolves the classes of the queries, and returns the generation of the class map they came
+// from. Returns 0 on success, or -1 with errno set.
+static int resolvePrewarmClasses(struct PrewarmQuery *queries, size_t count,
+                                 unsigned int *outGeneration) {
+    if (refreshClassMap()) {
+        return -1;
+    }
+    pthread_mutex_lock(&classMapMutex);
+    for (size_t i = 0; i < count; ++i) {
+        queries[i].targetClass = class_map_string_to_class(classMap, queries[i].className);
+    }
+    *outGeneration = classMapLoadedGeneration;
+    pthread_mutex_unlock(&classMapMutex);
+    return 0;
+}
+
+// Puts the decisions for the queries into the AVC and the front cache. Returns the number of
+// decisions put, or -1 with errno set if the AVC isn't open.
+static ssize_t prewarmBatch(const struct PrewarmQuery *queries, size_t count,
+                            unsigned int classGeneration) {
+    pthread_mutex_lock(&avcMutex);
+    if (!avcOpen) {
+        pthread_mutex_unlock(&avcMutex);
+        errno = EBADF;
+        return -1;
+    }
+    struct CpuCounters counters = {};
+    for (size_t i = 0; i < count; ++i) {
+        const struct PrewarmQuery *query = &queries[i];
+        // A policy load since resolving may have renumbered the classes, and one inside the AVC
+        // may happen at any query.
+        if (__atomic_load_n(&classMapGeneration, __ATOMIC_RELAXED)
+                != classGeneration) {
+            break;
+        }
+        security_class_t targetClass = query->targetClass;
+        if (!targetClass) {
+            continue;
+        }
+        unsigned int generation = __atomic_load_n(&frontCacheGeneration, __ATOMIC_ACQUIRE);
+        struct avc_entry_ref entryRef;
+        avc_entry_ref_init(&entryRef);
+        struct av_decision decision;
+        // Requesting no permission computes and caches the whole decision, and the AVC then
+        // succeeds only if it would grant anything, i.e. is permissive for the domain.
+        bool permissive;
+        if (!avc_has_perm_noaudit(query->sourceSid, query->targetSid, targetClass, 0, &entryRef,
+                                  &decision)) {
+            permissive = true;
+        } else if (errno == EACCES) {
+            permissive = false;
+        } else {
+            // The policy may no longer know about the contexts.
+            continue;
+        }
+        ++counters.misses;
+        // Requesting everything gets ENTRY_PERMISSIVE or ENTRY_ENFORCING set accordingly.
+        updateFrontCacheLocked(frontCache, query->sourceSid, query->targetSid, targetClass,
+                               ~(access_vector_t) 0, &decision, permissive, generation,
+                               &counters);
+    }
+    pthread_mutex_unlock(&avcMutex);
+    addCpuCounters(&counters);
+    return (ssize_t) counters.misses;
+}
+
+ssize_t avc_query_prewarm(const char *path) {
+    struct decision_set *set = decision_set_load(path);
+    if (!set) {
+        return -1;
+    }
+    ssize_t result = 0;
+    size_t count = decision_set_get_count(set);
+    struct PrewarmQuery queries[PREWARM_BATCH_SIZE];
+    size_t queryCount = 0;
+    for (size_t i = 0; i <= count; ++i) {
+        if (queryCount == PREWARM_BATCH_SIZE || (i == count && queryCount)) {
+            unsigned int generation;
+            ssize_t batchResult = resolvePrewarmClasses(queries, queryCount, &generation) ? -1
+                    : prewarmBatch(queries, queryCount, generation);
+            if (batchResult == -1) {
+                result = -1;
+                break;
+            }
+            result += batchResult;
+            queryCount = 0;
+        }
+        if (i == count) {
+            break;
+        }
+        const char *sourceContext;
+        const char *targetContext;
+        const char *className;
+        decision_set_get(set, i, &sourceContext, &targetContext, &className);
+        struct PrewarmQuery *query = &queries[queryCount];
+        query->className = className;
+        if (avc_query_context_to_sid(sourceContext, &query->sourceSid) == -1
+                || avc_query_context_to_sid(targetContext, &query->targetSid) == -1) {
+            result = -1;
+            break;
+        }
+        ++queryCount;
+    }
+    int savedErrno = errno;
+    decision_set_destroy(set);
+    errno = savedErrno;
+    return result;
+}
+
+static uint32_t hashCreateQuery(security_id_t sourceSid, security_id_t targetSid,
+                                security_class_t targetClass) {
+    uint64_t hash = mixHash(UINT64_C(0x9e3779b97f4a7c15), (uint64_t) (uintptr_t) sourceSid);
+    hash = mixHash(hash, (uint64_t) (uintptr_t) targetSid);
+    hash = mixHash(hash, targetClass);
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+// Must be called with avcMutex held. Returns the slot for the query, which has a NULL sourceSid if
+// the query isn't memoized.
+static struct CreateMemoEntry *findCreateMemoEntryLocked(security_id_t sourceSid,
+                                                         security_id_t targetSid,
+                                                         security_class_t targetClass) {
+    size_t mask = createMemoCapacity - 1;
+    size_t i = hashCreateQuery(sourceSid, targetSid, targetClass) & mask;
+    for (;; i = (i + 1) & mask) {
+        struct CreateMemoEntry *entry = &createMemo[i];
+        if (!entry->sourceSid || (entry->sourceSid == sourceSid && entry->targetSid == targetSid
+                && entry->targetClass == targetClass)) {
+            return entry;
+        }
+    }
+}
+
+// Must be called with avcMutex held. Makes room for one more entry, dropping everything if stale
+// or full.
+static bool prepareCreateMemoLocked(void) {
+    if (createMemoStale || createMemoCount >= CREATE_MEMO_MAX_COUNT) {
+        if (createMemo) {
+            memset(createMemo, 0, createMemoCapacity * sizeof(*createMemo));
+        }
+        createMemoCount = 0;
+        createMemoStale = false;
+    }
+    if ((createMemoCount + 1) * 4 <= createMemoCapacity * 3) {
+        return true;
+    }
+    size_t newCapacity = createMemoCapacity ? createMemoCapacity * 2 : 256;
+    struct CreateMemoEntry *newMemo = calloc(newCapacity, sizeof(*newMemo));
+    if (!newMemo) {
+        return false;
+    }
+    struct CreateMemoEntry *oldMemo = createMemo;
+    size_t oldCapacity = createMemoCapacity;
+    createMemo = newMemo;
+    createMemoCapacity = newCapacity;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        const struct CreateMemoEntry *entry = &oldMemo[i];
+        if (entry->sourceSid) {
+            *findCreateMemoEntryLocked(entry->sourceSid, entry->targetSid, entry->targetClass) =
+                    *entry;
+        }
+    }
+    free(oldMemo);
+    return true;
+}
+
+// Must be called with avcMutex held. Returns the memoized entry for the query, or NULL.
+static const struct CreateMemoEntry *lookupCreateMemoLocked(security_id_t sourceSid,
+                                                            security_id_t targetSid,
+                                                            security_class_t targetClass) {
+    if (createMemoStale || !createMemoCount) {
+        return NULL;
+    }
+    const struct CreateMemoEntry *entry = findCreateMemoEntryLocked(sourceSid, targetSid,
+                                                                    targetClass);
+    return entry->sourceSid ? entry : NULL;
+}
+
+// A query missing from the create memo, computed without avcMutex held.
+struct CreateMiss {
+    security_id_t sourceSid;
+    security_id_t targetSid;
+    security_class_t targetClass;
+    size_t index;
+    security_id_t newSid;
+};
+
+static int compareCreateMisses(const void *left, const void *right) {
+    const struct CreateMiss *leftMiss = left;
+    const struct CreateMiss *rightMiss = right;
+    if (leftMiss->sourceSid != rightMiss->sourceSid) {
+        return (uintptr_t) leftMiss->sourceSid < (uintptr_t) rightMiss->sourceSid ? -1 : 1;
+    }
+    if (leftMiss->targetSid != rightMiss->targetSid) {
+        return (uintptr_t) leftMiss->targetSid < (uintptr_t) rightMiss->targetSid ? -1 : 1;
+    }
+    if (leftMiss->targetClass != rightMiss->targetClass) {
+        return leftMiss->targetClass < rightMiss->targetClass ? -1 : 1;
+    }
+    return leftMiss->index < rightMiss->index ? -1 : leftMiss->index > rightMiss->index;
+}
+
+static bool isSameCreateQuery(const struct CreateMiss *miss1, const struct CreateMiss *miss2) {
+    return miss1->sourceSid == miss2->sourceSid && miss1->targetSid == miss2->targetSid
+            && miss1->targetClass == miss2->targetClass;
+}
+
+// Computes the misses, which must be sorted, once per distinct query.
+static int computeCreateMisses(struct CreateMiss *misses, size_t missCount) {
+    for (size_t i = 0; i < missCount; ++i) {
+        if (i && isSameCreateQuery(&misses[i - 1], &misses[i])) {
+            misses[i].newSid = misses[i - 1].newSid;
+            continue;
+        }
+        char *newContext;
+        if (security_compute_create_raw(misses[i].sourceSid->ctx, misses[i].targetSid->ctx,
+                                        misses[i].targetClass, &newContext)) {
+            return -1;
+        }
+        // The SID table has its own locking.
+        int result = avc_query_context_to_sid(newContext, &misses[i].newSid);
+        int savedErrno = errno;
+        free(newContext);
+        errno = savedErrno;
+        if (result) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Must be called with avcMutex held.
+static void memoizeCreateMissesLocked(const struct CreateMiss *misses, size_t missCount) {
+    for (size_t i = 0; i < missCount; ++i) {
+        const struct CreateMiss *miss = &misses[i];
+        if (i && isSameCreateQuery(&misses[i - 1], miss)) {
+            continue;
+        }
+        // Best effort, the answers are already known.
+        if (!prepareCreateMemoLocked()) {
+            return;
+        }
+        struct CreateMemoEntry *entry = findCreateMemoEntryLocked(miss->sourceSid,
+                                                                  miss->targetSid,
+                                                                  miss->targetClass);
+        // Another batch may have memoized the same query meanwhile.
+        if (!entry->sourceSid) {
+            entry->sourceSid = miss->sourceSid;
+            entry->targetSid = miss->targetSid;
+            entry->targetClass = miss->targetClass;
+            entry->newSid = miss->newSid;
+            ++createMemoCount;
+        }
+    }
+}
+
+// Must be called with avcMutex released. Locks avcMutex and brings it up to date, or returns -1
+// with errno set and avcMutex released if the AVC isn't open.
+static int lockAndSyncStatus(void) {
+    bool hasStatus;
+    uint32_t statusSequence = 0;
+    isStatusChanged(&hasStatus, &statusSequence);
+    pthread_mutex_lock(&avcMutex);
+    if (!avcOpen) {
+        pthread_mutex_unlock(&avcMutex);
+        errno = EBADF;
+        return -1;
+    }
+    // Marks the memo stale if a policy was loaded.
+    syncStatusLocked(hasStatus, statusSequence);
+    return 0;
+}
+
+int avc_query_compute_create_batch(const security_id_t *sourceSids,
+                                   const security_id_t *targetSids,
+                                   const security_class_t *targetClasses, size_t count,
+                                   security_id_t *newSids) {
+    for (size_t i = 0; i < count; ++i) {
+        if (!sourceSids[i] || !targetSids[i]) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    struct CreateMiss *misses = malloc((count ? count : 1) * sizeof(*misses));
+    if (!misses) {
+        errno = ENOMEM;
+        return -1;
+    }
+    // Hits are answered under avcMutex, but misses are computed without it so that round trips to
+    // selinuxfs don't hold up other queries. Answers computed across a policy load may be for
+    // the old policy, and are computed again.
+    int result = 0;
+    for (;;) {
+        if (lockAndSyncStatus()) {
+            result = -1;
+            break;
+        }
+        unsigned int generation = createMemoGeneration;
+        size_t missCount = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const struct CreateMemoEntry *entry = lookupCreateMemoLocked(
+                    sourceSids[i], targetSids[i], targetClasses[i]);
+            if (entry) {
+                newSids[i] = entry->newSid;
+                continue;
+            }
+            struct CreateMiss *miss = &misses[missCount];
+            miss->sourceSid = sourceSids[i];
+            miss->targetSid = targetSids[i];
+            miss->targetClass = targetClasses[i];
+            miss->index = i;
+            ++missCount;
+        }
+        pthread_mutex_unlock(&avcMutex);
+        if (!missCount) {
+            break;
+        }
+        qsort(misses, missCount, sizeof(*misses), compareCreateMisses);
+        if (computeCreateMisses(misses, missCount) || lockAndSyncStatus()) {
+            result = -1;
+            break;
+        }
+        if (createMemoGeneration != generation) {
+            pthread_mutex_unlock(&avcMutex);
+            continue;
+        }
+        memoizeCreateMissesLocked(misses, missCount);
+        pthread_mutex_unlock(&avcMutex);
+        for (size_t i = 0; i < missCount; ++i) {
+            newSids[misses[i].index] = misses[i].newSid;
+        }
+        break;
+    }
+    int savedErrno = errno;
+    free(misses);
+    errno = savedErrno;
+    return result;
+}
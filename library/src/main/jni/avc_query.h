@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_AVC_QUERY_H
+#define LIBSELINUX_JNI_AVC_QUERY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <selinux/avc.h>
+
+#include "sid_table.h"
+
+// The userspace AVC of libselinux isn't thread-safe unless it was given lock callbacks through the
+// deprecated avc_init(), so every call into it is serialized here instead. In front of it sits a
+// set-associative cache of its decisions with a seqlock per set, so that repeated queries are
+// answered without any lock, and only misses take the lock and go through the AVC. Sets are
+// reclaimed with CLOCK, so a full cache evicts one entry per miss instead of in bulk. Policy loads
+// and enforcing changes are noticed through the status page without leaving the lock-free path.
+
+struct avc_query_cache_stats {
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    // The number of ways compared in lookups of the front cache.
+    uint64_t probes;
+    size_t capacity;
+    // All zero until the first context is interned.
+    struct sid_table_stats sid_table;
+};
+
+// Opens the AVC if it isn't open yet. Returns 0 on success, or -1 with errno set.
+int avc_query_open(const struct selinux_opt *options, unsigned int optionCount);
+
+void avc_query_close(void);
+
+// Sets the number of decisions the front cache holds, rounded up to a power of 2 of at least 8.
+// This drops the cached decisions. Returns 0 on success, or -1 with errno set.
+int avc_query_set_cache_threshold(unsigned int threshold);
+
+// Counters are kept per CPU and summed up here, so they may be slightly behind concurrent queries.
+void avc_query_get_cache_stats(struct avc_query_cache_stats *stats);
+
+// Interns the raw context in our own SID table instead of avc_sidtab.c, so the SID stays valid for
+// the lifetime of the process, across closing and reopening the AVC.
+int avc_query_context_to_sid(const char *context, security_id_t *sid);
+
+// Checks count permission queries under a single lock, and sets bit i % 64 of decisions[i / 64] if
+// query i is allowed. Returns 0 on success, or -1 with errno set.
+int avc_query_has_perm_batch(const security_id_t *sourceSids, const security_id_t *targetSids,
+                             const security_class_t *targetClasses,
+                             const access_vector_t *requestedPermissions, size_t count,
+                             uint64_t *decisions);
+
+// Computes the contexts of new objects of each class created by each source in each target, like
+// security_compute_create_raw(), and returns them interned. Results are memoized by SID until the
+// next policy load, so a batch repeating a few queries takes only a few round trips to selinuxfs.
+// The AVC must be open. Returns 0 on success, or -1 with errno set.
+int avc_query_compute_create_batch(const security_id_t *sourceSids,
+                                   const security_id_t *targetSids,
+                                   const security_class_t *targetClasses, size_t count,
+                                   security_id_t *newSids);
+
+// Starts recording the (source, target, class) tuples of queries that miss, discarding any previous
+// recording, or stops and discards it. Returns 0 on success, or -1 with errno set.
+int avc_query_set_recording(bool enabled);
+
+// Saves what has been recorded so far. Returns 0 on success, or -1 with errno set, which is EINVAL
+// if not recording.
+int avc_query_save_recording(const char *path);
+
+// Computes the decisions for a saved recording into the open AVC and the front cache, a batch at a
+// time so that concurrent queries can still get through. Tuples whose contexts or class the policy
+// no longer knows are skipped. Returns the number of decisions cached, or -1 with errno set.
+ssize_t avc_query_prewarm(const char *path);
+
+#endif // LIBSELINUX_JNI_AVC_QUERY_H
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "class_map.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "selinuxfs.h"
+#include "string_pool.h"
+
+// Permissions are bits of an access_vector_t.
+#define MAX_PERMISSION_COUNT 32
+
+// Give up on a bucket after this many displacements, which only happens if two keys hash the same.
+#define MAX_DISPLACEMENT 65536
+
+struct ClassInfo {
+    // NULL if the class doesn't exist.
+    const char *name;
+    // Indexed by bit, NULL if the permission doesn't exist.
+    const char *permissionNames[MAX_PERMISSION_COUNT];
+};
+
+// A perfect hash by hash and displace: a key goes into a bucket by its hash, and all keys in a
+// bucket share a displacement chosen so that none of them collides with another key.
+struct PerfectHash {
+    uint32_t *displacements;
+    size_t bucketCount;
+    // Key IDs plus one, or 0 for an empty slot.
+    uint32_t *slots;
+    size_t slotMask;
+};
+
+struct class_map {
+    struct string_pool *names;
+    // Indexed by class value.
+    struct ClassInfo *classes;
+    size_t classCount;
+    // Key IDs are class values.
+    struct PerfectHash classHash;
+    // Key IDs are class values times MAX_PERMISSION_COUNT plus bits.
+    struct PerfectHash permissionHash;
+};
+
+static size_t getPerfectHashSlot(const struct PerfectHash *perfectHash, uint64_t hash) {
+    uint32_t displacement = perfectHash->displacements[(hash >> 32) % perfectHash->bucketCount];
+    return (size_t) mixHash(hash, (uint64_t) displacement + 1) & perfectHash->slotMask;
+}
+
+// Returns the key ID plus one that may match the hash, or 0.
+static uint32_t findInPerfectHash(const struct PerfectHash *perfectHash, uint64_t hash) {
+    if (!perfectHash->slots) {
+        return 0;
+    }
+    return perfectHash->slots[getPerfectHashSlot(perfectHash, hash)];
+}
+
+struct PerfectHashKey {
+    uint64_t hash;
+    uint32_t id;
+    uint32_t bucket;
+    uint32_t bucketSize;
+};
+
+static int compareKeysByBucketSize(const void *key1, const void *key2) {
+    const struct PerfectHashKey *perfectHashKey1 = key1;
+    const struct PerfectHashKey *perfectHashKey2 = key2;
+    if (perfectHashKey1->bucketSize != perfectHashKey2->bucketSize) {
+        return perfectHashKey1->bucketSize > perfectHashKey2->bucketSize ? -1 : 1;
+    }
+    if (perfectHashKey1->bucket != perfectHashKey2->bucket) {
+        return perfectHashKey1->bucket < perfectHashKey2->bucket ? -1 : 1;
+    }
+    return 0;
+}
+
+// Places the keys of one bucket with the first displacement that fits. Returns false if there is
+// none.
+static bool placeBucket(struct PerfectHash *perfectHash, const struct PerfectHashKey *keys,
+                        size_t keyCount) {
+    for (uint32_t displacement = 0; displacement < MAX_DISPLACEMENT; ++displacement) {
+        perfectHash->displacements[keys[0].bucket] = displacement;
+        size_t placedCount = 0;
+        for (; placedCount < keyCount; ++placedCount) {
+            size_t slot = getPerfectHashSlot(perfectHash, keys[placedCount].hash);
+            if (perfectHash->slots[slot]) {
+                break;
+            }
+            perfectHash->slots[slot] = keys[placedCount].id + 1;
+        }
+        if (placedCount == keyCount) {
+            return true;
+        }
+        while (placedCount) {
+            --placedCount;
+            perfectHash->slots[getPerfectHashSlot(perfectHash, keys[placedCount].hash)] = 0;
+        }
+    }
+    return false;
+}
+
+// Returns 0 on success, or -1 with errno set.
+static int buildPerfectHash(struct PerfectHash *perfectHash, struct PerfectHashKey *keys,
+                            size_t keyCount) {
+    size_t slotCount = 8;
+    while (slotCount < keyCount * 2) {
+        slotCount *= 2;
+    }
+    // About four keys per bucket keeps the search for displacements short.
+    perfectHash->bucketCount = keyCount / 4 + 1;
+    perfectHash->displacements = calloc(perfectHash->bucketCount,
+                                        sizeof(*perfectHash->displacements));
+    perfectHash->slots = calloc(slotCount, sizeof(*perfectHash->slots));
+    perfectHash->slotMask = slotCount - 1;
+    uint32_t *bucketSizes = calloc(perfectHash->bucketCount, sizeof(*bucketSizes));
+    if (!perfectHash->displacements || !perfectHash->slots || !bucketSizes) {
+        free(bucketSizes);
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys[i].bucket = (uint32_t) ((keys[i].hash >> 32) % perfectHash->bucketCount);
+        ++bucketSizes[keys[i].bucket];
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        keys[i].bucketSize = bucketSizes[keys[i].bucket];
+    }
+    free(bucketSizes);
+    // Larger buckets are harder to place, so place them while the table is still empty.
+    qsort(keys, keyCount, sizeof(*keys), compareKeysByBucketSize);
+    for (size_t start = 0; start < keyCount; start += keys[start].bucketSize) {
+        if (!placeBucket(perfectHash, &keys[start], keys[start].bucketSize)) {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void destroyPerfectHash(struct PerfectHash *perfectHash) {
+    free(perfectHash->displacements);
+    free(perfectHash->slots);
+}
+
+static uint64_t hashPermission(security_class_t securityClass, const char *name) {
+    return mixHash(hashBytes64(name, strlen(name)), securityClass);
+}
+
+// Returns 0 with the decimal number in the file, or -1 with errno set.
+static int readNumberAt(int directoryFd, const char *path, unsigned int *outNumber) {
+    int fd = TEMP_FAILURE_RETRY(openat(directoryFd, path, O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return -1;
+    }
+    char buffer[16];
+    ssize_t readResult = TEMP_FAILURE_RETRY(read(fd, buffer, sizeof(buffer) - 1));
+    int savedErrno = errno;
+    close(fd);
+    if (readResult == -1) {
+        errno = savedErrno;
+        return -1;
+    }
+    buffer[readResult] = '\0';
+    char *end;
+    errno = 0;
+    unsigned long number = strtoul(buffer, &end, 10);
+    if (errno || end == buffer || number > UINT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    *outNumber = (unsigned int) number;
+    return 0;
+}
+
+// Opens a directory relative to a directory file descriptor, which is closed when the DIR is.
+static DIR *openDirectoryAt(int directoryFd, const char *path) {
+    int fd = TEMP_FAILURE_RETRY(openat(directoryFd, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd == -1) {
+        return NULL;
+    }
+    DIR *directory = fdopendir(fd);
+    if (!directory) {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+    }
+    return directory;
+}
+
+static bool isDotOrDotDot(const char *name) {
+    return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+
+static const char *poolName(struct class_map *map, const char *name) {
+    ssize_t index = string_pool_add(map->names, name, strlen(name));
+    if (index == -1) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return string_pool_get(map->names, (size_t) index);
+}
+
+// Reads class/<name>/index and class/<name>/perms/* of selinuxfs. Returns 0 on success, or -1 with
+// errno set.
+static int loadClass(struct class_map *map, int classDirectoryFd, const char *className) {
+    char path[NAME_MAX + sizeof("/index")];
+    snprintf(path, sizeof(path), "%s/index", className);
+    unsigned int value;
+    if (readNumberAt(classDirectoryFd, path, &value) == -1) {
+        return -1;
+    }
+    if (!value || value > UINT16_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (value >= map->classCount) {
+        size_t newClassCount = value + 1;
+        struct ClassInfo *newClasses = realloc(map->classes,
+                                               newClassCount * sizeof(*newClasses));
+        if (!newClasses) {
+            errno = ENOMEM;
+            return -1;
+        }
+        memset(&newClasses[map->classCount], 0,
+               (newClassCount - map->classCount) * sizeof(*newClasses));
+        map->classes = newClasses;
+        map->classCount = newClassCount;
+    }
+    struct ClassInfo *classInfo = &map->classes[value];
+    classInfo->name = poolName(map, className);
+    if (!classInfo->name) {
+        return -1;
+    }
+    snprintf(path, sizeof(path), "%s/perms", className);
+    DIR *permissionDirectory = openDirectoryAt(classDirectoryFd, path);
+    if (!permissionDirectory) {
+        return -1;
+    }
+    int permissionDirectoryFd = dirfd(permissionDirectory);
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(permissionDirectory))) {
+        if (isDotOrDotDot(entry->d_name)) {
+            continue;
+        }
+        unsigned int permissionValue;
+        if (readNumberAt(permissionDirectoryFd, entry->d_name, &permissionValue) == -1) {
+            result = -1;
+            break;
+        }
+        if (!permissionValue || permissionValue > MAX_PERMISSION_COUNT) {
+            errno = EINVAL;
+            result = -1;
+            break;
+        }
+        const char **permissionName = &classInfo->permissionNames[permissionValue - 1];
+        *permissionName = poolName(map, entry->d_name);
+        if (!*permissionName) {
+            result = -1;
+            break;
+        }
+    }
+    int savedErrno = errno;
+    closedir(permissionDirectory);
+    errno = savedErrno;
+    return result;
+}
+
+static int buildHashes(struct class_map *map) {
+    size_t classKeyCount = 0;
+    size_t permissionKeyCount = 0;
+    for (size_t i = 0; i < map->classCount; ++i) {
+        const struct ClassInfo *classInfo = &map->classes[i];
+        if (!classInfo->name) {
+            continue;
+        }
+        ++classKeyCount;
+        for (size_t j = 0; j < MAX_PERMISSION_COUNT; ++j) {
+            if (classInfo->permissionNames[j]) {
+                ++permissionKeyCount;
+            }
+        }
+    }
+    struct PerfectHashKey *classKeys = malloc((classKeyCount ? classKeyCount : 1)
+            * sizeof(*classKeys));
+    struct PerfectHashKey *permissionKeys = malloc((permissionKeyCount ? permissionKeyCount : 1)
+            * sizeof(*permissionKeys));
+    if (!classKeys || !permissionKeys) {
+        free(permissionKeys);
+        free(classKeys);
+        errno = ENOMEM;
+        return -1;
+    }
+    classKeyCount = 0;
+    permissionKeyCount = 0;
+    for (size_t i = 0; i < map->classCount; ++i) {
+        const struct ClassInfo *classInfo = &map->classes[i];
+        if (!classInfo->name) {
+            continue;
+        }
+        struct PerfectHashKey *classKey = &classKeys[classKeyCount++];
+        classKey->hash = hashBytes64(classInfo->name, strlen(classInfo->name));
+        classKey->id = (uint32_t) i;
+        for (size_t j = 0; j < MAX_PERMISSION_COUNT; ++j) {
+            if (classInfo->permissionNames[j]) {
+                struct PerfectHashKey *permissionKey = &permissionKeys[permissionKeyCount++];
+                permissionKey->hash = hashPermission((security_class_t) i,
+                                                     classInfo->permissionNames[j]);
+                permissionKey->id = (uint32_t) (i * MAX_PERMISSION_COUNT + j);
+            }
+        }
+    }
+    int result = buildPerfectHash(&map->classHash, classKeys, classKeyCount);
+    if (!result) {
+        result = buildPerfectHash(&map->permissionHash, permissionKeys, permissionKeyCount);
+    }
+    int savedErrno = errno;
+    free(permissionKeys);
+    free(classKeys);
+    errno = savedErrno;
+    return result;
+}
+
+struct class_map *class_map_load(void) {
+    struct class_map *map = calloc(1, sizeof(*map));
+    if (!map) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    map->names = string_pool_create();
+    if (!map->names) {
+        free(map);
+        errno = ENOMEM;
+        return NULL;
+    }
+    int classDirectoryFd = selinuxfs_open("class", O_RDONLY | O_DIRECTORY);
+    DIR *classDirectory = classDirectoryFd != -1 ? fdopendir(classDirectoryFd) : NULL;
+    if (!classDirectory) {
+        int savedErrno = errno;
+        if (classDirectoryFd != -1) {
+            close(classDirectoryFd);
+        }
+        class_map_destroy(map);
+        errno = savedErrno;
+        return NULL;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(classDirectory))) {
+        if (isDotOrDotDot(entry->d_name)) {
+            continue;
+        }
+        if (loadClass(map, classDirectoryFd, entry->d_name) == -1) {
+            result = -1;
+            break;
+        }
+    }
+    int savedErrno = errno;
+    closedir(classDirectory);
+    if (!result) {
+        result = buildHashes(map);
+        savedErrno = errno;
+    }
+    if (result) {
+        class_map_destroy(map);
+        errno = savedErrno;
+        return NULL;
+    }
+    return map;
+}
+
+void class_map_destroy(struct class_map *map) {
+    destroyPerfectHash(&map->permissionHash);
+    destroyPerfectHash(&map->classHash);
+    free(map->classes);
+    string_pool_destroy(map->names);
+    free(map);
+}
+
+security_class_t class_map_string_to_class(const struct class_map *map, const char *name) {
+    uint32_t slot = findInPerfectHash(&map->classHash, hashBytes64(name, strlen(name)));
+    if (!slot || strcmp(map->classes[slot - 1].name, name)) {
+        return 0;
+    }
+    return (security_class_t) (slot - 1);
+}
+
+access_vector_t class_map_string_to_av_perm(const struct class_map *map,
+                                            security_class_t securityClass, const char *name) {
+    uint32_t slot = findInPerfectHash(&map->permissionHash, hashPermission(securityClass, name));
+    if (!slot) {
+        return 0;
+    }
+    uint32_t id = slot - 1;
+    size_t classValue = id / MAX_PERMISSION_COUNT;
+    size_t bit = id % MAX_PERMISSION_COUNT;
+    if (classValue != securityClass
+            || strcmp(map->classes[classValue].permissionNames[bit], name)) {
+        return 0;
+    }
+    return (access_vector_t) 1 << bit;
+}
+
+const char *class_map_class_to_string(const struct class_map *map,
+                                      security_class_t securityClass) {
+    return securityClass < map->classCount ? map->classes[securityClass].name : NULL;
+}
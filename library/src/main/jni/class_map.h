@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_CLASS_MAP_H
+#define LIBSELINUX_JNI_CLASS_MAP_H
+
+#include <selinux/selinux.h>
+
+// The security classes and permissions of the loaded policy, read from selinuxfs once instead of
+// discovered by stringrep.c and then searched by string comparison. Names are resolved with a
+// perfect hash, i.e. one hash and one comparison, and values by indexing an array. Values are those
+// of the kernel, which is also what stringrep.c returns since this library never sets a class
+// mapping. Immutable once loaded, so lookups may run concurrently, but it has to be loaded again
+// after a policy load that changes classes.
+struct class_map;
+
+// Returns the map, or NULL with errno set.
+struct class_map *class_map_load(void);
+
+void class_map_destroy(struct class_map *map);
+
+// Returns the class, or 0 if unknown.
+security_class_t class_map_string_to_class(const struct class_map *map, const char *name);
+
+// Returns the permission bit, or 0 if unknown.
+access_vector_t class_map_string_to_av_perm(const struct class_map *map,
+                                            security_class_t securityClass, const char *name);
+
+// Returns the name of the class, or NULL if unknown.
+const char *class_map_class_to_string(const struct class_map *map,
+                                      security_class_t securityClass);
+
+#endif // LIBSELINUX_JNI_CLASS_MAP_H
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "context_validate.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <selinux/selinux.h>
+
+#include "hash.h"
+#include "reader_epoch.h"
+#include "selinuxfs.h"
+#include "status_page.h"
+
+// See SELINUX_MAGIC_COMPILED_FCONTEXT in label_file.h.
+#define COMPILED_FILE_CONTEXTS_MAGIC 0xf97cff8a
+
+// Not yet known, or not known for sure, e.g. selinuxfs is unavailable.
+#define VALIDATION_ERROR_UNKNOWN (-1)
+
+struct ValidationEntry {
+    uint32_t hash;
+    // 0 if valid, EINVAL if invalid, or VALIDATION_ERROR_UNKNOWN.
+    int error;
+    char context[];
+};
+
+struct ValidationTable {
+    // Open addressing with linear probing, capacity is always a power of two.
+    struct ValidationEntry **entries;
+    size_t capacity;
+    size_t size;
+};
+
+// Guards writes to the cache. Readers take no lock: entries are published with release stores and
+// never change afterwards, and the table is copied rather than grown in place, so that a writer can
+// wait for readers before freeing a replaced table.
+static pthread_mutex_t cacheMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct ValidationTable *cache;
+static struct reader_epoch cacheReaderEpoch;
+// Advanced by each flush with cacheMutex held. Answers are computed without the lock, and only
+// remembered if no flush happened since, since they may be for the policy before it.
+static unsigned int cacheGeneration;
+// The policyload of the status page that the cache was last checked against.
+static uint32_t cachePolicyload;
+
+static union selinux_callback previousPolicyloadCallback;
+
+static struct ValidationEntry **findTableSlot(const struct ValidationTable *table,
+                                              const char *context, uint32_t hash) {
+    if (!table || !table->capacity) {
+        return NULL;
+    }
+    size_t mask = table->capacity - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        struct ValidationEntry **slot = &table->entries[i];
+        struct ValidationEntry *entry = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+        if (!entry || (entry->hash == hash && !strcmp(entry->context, context))) {
+            return slot;
+        }
+    }
+}
+
+static struct ValidationEntry *findTableEntry(const struct ValidationTable *table,
+                                              const char *context, uint32_t hash) {
+    struct ValidationEntry **slot = findTableSlot(table, context, hash);
+    return slot ? __atomic_load_n(slot, __ATOMIC_ACQUIRE) : NULL;
+}
+
+// Returns a new array of entries with the new capacity, or NULL if out of memory.
+static struct ValidationEntry **rehashTable(const struct ValidationTable *table,
+                                            size_t newCapacity) {
+    struct ValidationEntry **newEntries = calloc(newCapacity, sizeof(*newEntries));
+    if (!newEntries) {
+        return NULL;
+    }
+    size_t newMask = newCapacity - 1;
+    for (size_t i = 0; i < table->capacity; ++i) {
+        struct ValidationEntry *entry = table->entries[i];
+        if (!entry) {
+            continue;
+        }
+        size_t j = entry->hash & newMask;
+        while (newEntries[j]) {
+            j = (j + 1) & newMask;
+        }
+        newEntries[j] = entry;
+    }
+    return newEntries;
+}
+
+static bool isTableFull(const struct ValidationTable *table) {
+    return (table->size + 1) * 4 > table->capacity * 3;
+}
+
+static size_t getGrownCapacity(const struct ValidationTable *table) {
+    return table->capacity ? table->capacity * 2 : 64;
+}
+
+static bool growTable(struct ValidationTable *table) {
+    if (!isTableFull(table)) {
+        return true;
+    }
+    size_t newCapacity = getGrownCapacity(table);
+    struct ValidationEntry **newEntries = rehashTable(table, newCapacity);
+    if (!newEntries) {
+        return false;
+    }
+    free(table->entries);
+    table->entries = newEntries;
+    table->capacity = newCapacity;
+    return true;
+}
+
+static struct ValidationEntry *newEntry(const char *context, size_t length, uint32_t hash,
+                                        int error) {
+    struct ValidationEntry *entry = malloc(sizeof(*entry) + length + 1);
+    if (!entry) {
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->error = error;
+    memcpy(entry->context, context, length + 1);
+    return entry;
+}
+
+// Returns the existing or newly inserted entry, or NULL if out of memory.
+static struct ValidationEntry *putTableEntry(struct ValidationTable *table, const char *context,
+                                             size_t length, uint32_t hash, int error) {
+    struct ValidationEntry **slot = findTableSlot(table, context, hash);
+    if (slot && *slot) {
+        return *slot;
+    }
+    if (!growTable(table)) {
+        return NULL;
+    }
+    struct ValidationEntry *entry = newEntry(context, length, hash, error);
+    if (!entry) {
+        return NULL;
+    }
+    *findTableSlot(table, context, hash) = entry;
+    ++table->size;
+    return entry;
+}
+
+static void clearTable(struct ValidationTable *table) {
+    for (size_t i = 0; i < table->capacity; ++i) {
+        free(table->entries[i]);
+    }
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->size = 0;
+}
+
+static struct ValidationTable *acquireCache(unsigned int *outReaderIndex) {
+    *outReaderIndex = reader_epoch_enter(&cacheReaderEpoch);
+    return __atomic_load_n(&cache, __ATOMIC_SEQ_CST);
+}
+
+static void releaseCache(unsigned int readerIndex) {
+    reader_epoch_leave(&cacheReaderEpoch, readerIndex);
+}
+
+// Must be called with cacheMutex held. Publishes the new table and returns the old one once no
+// reader can see it anymore.
+static struct ValidationTable *replaceCacheLocked(struct ValidationTable *newTable) {
+    struct ValidationTable *oldTable = __atomic_exchange_n(&cache, newTable, __ATOMIC_SEQ_CST);
+    reader_epoch_synchronize(&cacheReaderEpoch);
+    return oldTable;
+}
+
+// Must be called with cacheMutex held, with the cache generation read before computing the answer.
+// Failing to remember an answer is harmless, so this simply gives up when out of memory.
+static void putCacheEntryLocked(unsigned int generation, const char *context, size_t length,
+                                uint32_t hash, int error) {
+    if (cacheGeneration != generation) {
+        return;
+    }
+    struct ValidationTable *table = cache;
+    if (findTableEntry(table, context, hash)) {
+        return;
+    }
+    if (!table || isTableFull(table)) {
+        struct ValidationTable *newTable = calloc(1, sizeof(*newTable));
+        if (!newTable) {
+            return;
+        }
+        if (table) {
+            newTable->capacity = getGrownCapacity(table);
+            newTable->size = table->size;
+            newTable->entries = rehashTable(table, newTable->capacity);
+        } else {
+            newTable->capacity = getGrownCapacity(newTable);
+            newTable->entries = calloc(newTable->capacity, sizeof(*newTable->entries));
+        }
+        if (!newTable->entries) {
+            free(newTable);
+            return;
+        }
+        // The entries now belong to the new table.
+        struct ValidationTable *oldTable = replaceCacheLocked(newTable);
+        if (oldTable) {
+            free(oldTable->entries);
+            free(oldTable);
+        }
+        table = newTable;
+    }
+    struct ValidationEntry *entry = newEntry(context, length, hash, error);
+    if (!entry) {
+        return;
+    }
+    __atomic_store_n(findTableSlot(table, context, hash), entry, __ATOMIC_RELEASE);
+    ++table->size;
+}
+
+// Returns the remembered answer, or VALIDATION_ERROR_UNKNOWN.
+static unsigned int getCacheGeneration(void) {
+    return __atomic_load_n(&cacheGeneration, __ATOMIC_ACQUIRE);
+}
+
+static int getCachedError(const struct ValidationTable *table, const char *context,
+                          uint32_t hash) {
+    const struct ValidationEntry *entry = findTableEntry(table, context, hash);
+    return entry ? entry->error : VALIDATION_ERROR_UNKNOWN;
+}
+
+static int policyloadCallback(int seqno) {
+    selinux_validate_cache_flush();
+    return previousPolicyloadCallback.func_policyload(seqno);
+}
+
+static void installPolicyloadCallback(void) {
+    previousPolicyloadCallback = selinux_get_callback(SELINUX_CB_POLICYLOAD);
+    union selinux_callback callback;
+    callback.func_policyload = policyloadCallback;
+    selinux_set_callback(SELINUX_CB_POLICYLOAD, callback);
+}
+
+// Answers must not outlive the policy they were given for, which the status page tells us about
+// without any system call, and an open AVC through our callback.
+static void syncWithPolicy(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, installPolicyloadCallback);
+    struct status_page_state state;
+    if (status_page_read(&state)) {
+        return;
+    }
+    uint32_t policyload = __atomic_load_n(&cachePolicyload, __ATOMIC_RELAXED);
+    if (state.policyload != policyload && __atomic_compare_exchange_n(
+            &cachePolicyload, &policyload, state.policyload, false, __ATOMIC_RELAXED,
+            __ATOMIC_RELAXED)) {
+        selinux_validate_cache_flush();
+    }
+}
+
+static int checkContext(const char *context) {
+    if (selinuxfs_transaction("context", context, strlen(context) + 1, NULL, 0) == -1) {
+        return errno == EINVAL ? EINVAL : VALIDATION_ERROR_UNKNOWN;
+    }
+    return 0;
+}
+
+int selinux_validate_cached(const char *context) {
+    syncWithPolicy();
+    size_t length = strlen(context);
+    uint32_t hash = hashBytes(context, length);
+    unsigned int readerIndex;
+    int error = getCachedError(acquireCache(&readerIndex), context, hash);
+    releaseCache(readerIndex);
+    if (error == VALIDATION_ERROR_UNKNOWN) {
+        // Don't hold the lock across the selinuxfs round trip.
+        unsigned int generation = getCacheGeneration();
+        error = checkContext(context);
+        if (error == VALIDATION_ERROR_UNKNOWN) {
+            // Keep the errno from selinuxfs.
+            return -1;
+        }
+        pthread_mutex_lock(&cacheMutex);
+        putCacheEntryLocked(generation, context, length, hash, error);
+        pthread_mutex_unlock(&cacheMutex);
+    }
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+static int validateCallback(char **context) {
+    return selinux_validate_cached(*context);
+}
+
+static void installValidateCallback(void) {
+    union selinux_callback callback;
+    callback.func_validate = validateCallback;
+    selinux_set_callback(SELINUX_CB_VALIDATE, callback);
+}
+
+void selinux_validate_cache_enable(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, installValidateCallback);
+}
+
+void selinux_validate_cache_flush(void) {
+    pthread_mutex_lock(&cacheMutex);
+    __atomic_store_n(&cacheGeneration, cacheGeneration + 1, __ATOMIC_RELEASE);
+    struct ValidationTable *oldTable = replaceCacheLocked(NULL);
+    pthread_mutex_unlock(&cacheMutex);
+    if (oldTable) {
+        clearTable(oldTable);
+        free(oldTable);
+    }
+}
+
+int selinux_validate_batch(const char *const *contexts, size_t count, uint64_t *results) {
+    syncWithPolicy();
+    memset(results, 0, (count + 63) / 64 * sizeof(*results));
+    // Unknown contexts are collected without duplicates, and checked after the lock-free pass.
+    struct ValidationTable unknownContexts = {};
+    struct ValidationEntry **unknownEntries = malloc((count ? count : 1)
+            * sizeof(*unknownEntries));
+    if (!unknownEntries) {
+        errno = ENOMEM;
+        return -1;
+    }
+    int result = 0;
+    unsigned int readerIndex;
+    const struct ValidationTable *table = acquireCache(&readerIndex);
+    for (size_t i = 0; i < count; ++i) {
+        size_t length = strlen(contexts[i]);
+        uint32_t hash = hashBytes(contexts[i], length);
+        int error = getCachedError(table, contexts[i], hash);
+        if (error == VALIDATION_ERROR_UNKNOWN) {
+            unknownEntries[i] = putTableEntry(&unknownContexts, contexts[i], length, hash,
+                                              VALIDATION_ERROR_UNKNOWN);
+            if (!unknownEntries[i]) {
+                errno = ENOMEM;
+                result = -1;
+                break;
+            }
+        } else {
+            unknownEntries[i] = NULL;
+            if (!error) {
+                results[i / 64] |= UINT64_C(1) << (i % 64);
+            }
+        }
+    }
+    releaseCache(readerIndex);
+    unsigned int generation = getCacheGeneration();
+    for (size_t i = 0; !result && i < unknownContexts.capacity; ++i) {
+        struct ValidationEntry *entry = unknownContexts.entries[i];
+        if (entry) {
+            entry->error = checkContext(entry->context);
+            if (entry->error == VALIDATION_ERROR_UNKNOWN) {
+                result = -1;
+            }
+        }
+    }
+    int savedErrno = errno;
+    if (unknownContexts.size) {
+        // Remember whatever was answered, even if something else failed.
+        pthread_mutex_lock(&cacheMutex);
+        for (size_t i = 0; i < unknownContexts.capacity; ++i) {
+            struct ValidationEntry *entry = unknownContexts.entries[i];
+            if (entry && entry->error != VALIDATION_ERROR_UNKNOWN) {
+                putCacheEntryLocked(generation, entry->context, strlen(entry->context),
+                                    entry->hash, entry->error);
+            }
+        }
+        pthread_mutex_unlock(&cacheMutex);
+    }
+    for (size_t i = 0; !result && i < count; ++i) {
+        if (unknownEntries[i] && !unknownEntries[i]->error) {
+            results[i / 64] |= UINT64_C(1) << (i % 64);
+        }
+    }
+    free(unknownEntries);
+    clearTable(&unknownContexts);
+    errno = savedErrno;
+    return result;
+}
+
+// The context is the last field on each line of file_contexts, property_contexts and
+// service_contexts.
+static int collectSpecFileContexts(const char *specFile, struct ValidationTable *contexts) {
+    FILE *file = fopen(specFile, "re");
+    if (!file) {
+        return -1;
+    }
+    uint32_t magic;
+    if (fread(&magic, sizeof(magic), 1, file) == 1 && magic == COMPILED_FILE_CONTEXTS_MAGIC) {
+        // Leave compiled file_contexts to selabel_open().
+        fclose(file);
+        return 0;
+    }
+    rewind(file);
+    int result = 0;
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    ssize_t lineLength;
+    while ((lineLength = getline(&line, &lineCapacity, file)) != -1) {
+        char *start = line;
+        while (*start && isspace((unsigned char) *start)) {
+            ++start;
+        }
+        if (!*start || *start == '#') {
+            continue;
+        }
+        char *end = line + lineLength;
+        while (end > start && isspace((unsigned char) end[-1])) {
+            --end;
+        }
+        char *context = end;
+        while (context > start && !isspace((unsigned char) context[-1])) {
+            --context;
+        }
+        if (context == start) {
+            continue;
+        }
+        *end = '\0';
+        if (!strcmp(context, "<<none>>")) {
+            continue;
+        }
+        size_t length = (size_t) (end - context);
+        if (!putTableEntry(contexts, context, length, hashBytes(context, length),
+                           VALIDATION_ERROR_UNKNOWN)) {
+            errno = ENOMEM;
+            result = -1;
+            break;
+        }
+    }
+    if (!result && ferror(file)) {
+        errno = EIO;
+        result = -1;
+    }
+    free(line);
+    fclose(file);
+    return result;
+}
+
+struct PrefetchWork {
+    struct ValidationEntry **entries;
+    size_t size;
+    size_t nextIndex;
+};
+
+static void *runPrefetchWork(void *argument) {
+    struct PrefetchWork *work = argument;
+    size_t i;
+    while ((i = __atomic_fetch_add(&work->nextIndex, 1, __ATOMIC_RELAXED)) < work->size) {
+        struct ValidationEntry *entry = work->entries[i];
+        entry->error = checkContext(entry->context);
+    }
+    return NULL;
+}
+
+int selinux_validate_prefetch(const char *const *specFiles, size_t specFileCount,
+                              unsigned int threadCount) {
+    syncWithPolicy();
+    struct ValidationTable contexts = {};
+    for (size_t i = 0; i < specFileCount; ++i) {
+        if (collectSpecFileContexts(specFiles[i], &contexts) == -1) {
+            int savedErrno = errno;
+            clearTable(&contexts);
+            errno = savedErrno;
+            return -1;
+        }
+    }
+    struct PrefetchWork work = {};
+    work.entries = malloc(contexts.size * sizeof(*work.entries));
+    if (contexts.size && !work.entries) {
+        clearTable(&contexts);
+        errno = ENOMEM;
+        return -1;
+    }
+    unsigned int readerIndex;
+    const struct ValidationTable *table = acquireCache(&readerIndex);
+    for (size_t i = 0; i < contexts.capacity; ++i) {
+        struct ValidationEntry *entry = contexts.entries[i];
+        if (entry && !findTableEntry(table, entry->context, entry->hash)) {
+            work.entries[work.size++] = entry;
+        }
+    }
+    releaseCache(readerIndex);
+
+    unsigned int generation = getCacheGeneration();
+    if (threadCount > work.size) {
+        threadCount = (unsigned int) work.size;
+    }
+    pthread_t *threads = NULL;
+    unsigned int startedThreadCount = 0;
+    if (threadCount > 1) {
+        // The calling thread works as well.
+        threads = malloc((threadCount - 1) * sizeof(*threads));
+        while (threads && startedThreadCount < threadCount - 1 && !pthread_create(
+                &threads[startedThreadCount], NULL, runPrefetchWork, &work)) {
+            ++startedThreadCount;
+        }
+    }
+    runPrefetchWork(&work);
+    for (unsigned int i = 0; i < startedThreadCount; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    pthread_mutex_lock(&cacheMutex);
+    for (size_t i = 0; i < work.size; ++i) {
+        struct ValidationEntry *entry = work.entries[i];
+        if (entry->error != VALIDATION_ERROR_UNKNOWN) {
+            size_t length = strlen(entry->context);
+            putCacheEntryLocked(generation, entry->context, length, entry->hash,
+                                entry->error);
+        }
+    }
+    pthread_mutex_unlock(&cacheMutex);
+    free(work.entries);
+    clearTable(&contexts);
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_CONTEXT_VALIDATE_H
+#define LIBSELINUX_JNI_CONTEXT_VALIDATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Remembered answers are looked up without any lock, and forgotten when the status page or an open
+// AVC shows a policy load.
+
+// Checks whether a context is valid like security_check_context(), but remembers the answer so
+// that each unique context only reaches selinuxfs once. Returns 0 if valid, or -1 with errno set.
+int selinux_validate_cached(const char *context);
+
+// Installs selinux_validate_cached() as the SELINUX_CB_VALIDATE callback, so that label handles
+// opened with SELABEL_OPT_VALIDATE validate each unique context only once.
+void selinux_validate_cache_enable(void);
+
+// Forgets all remembered answers, e.g. after a policy reload.
+void selinux_validate_cache_flush(void);
+
+// Checks count contexts, and sets bit i % 64 of results[i / 64] if context i is valid. Each unique
+// context not yet remembered reaches selinuxfs once. Returns 0 on success, or -1 with errno set.
+int selinux_validate_batch(const char *const *contexts, size_t count, uint64_t *results);
+
+// Collects the unique contexts in the text spec files and validates the ones not yet remembered
+// with up to threadCount threads, so that a subsequent selabel_open() with SELABEL_OPT_VALIDATE
+// only hits the cache. Returns 0 on success, or -1 with errno set.
+int selinux_validate_prefetch(const char *const *specFiles, size_t specFileCount,
+                              unsigned int threadCount);
+
+#endif // LIBSELINUX_JNI_CONTEXT_VALIDATE_H
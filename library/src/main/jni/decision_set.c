@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "decision_set.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "atomic_file.h"
+#include "hash.h"
+#include "string_pool.h"
+
+#define DECISION_SET_MAGIC 0x54455344 // "DSET"
+#define DECISION_SET_VERSION 1
+
+// Followed by tupleCount tuples, and then stringCount NUL-terminated strings.
+struct SetHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t stringCount;
+    uint32_t tupleCount;
+};
+
+// Indices into the string pool.
+struct DecisionTuple {
+    uint32_t sourceIndex;
+    uint32_t targetIndex;
+    uint32_t classIndex;
+};
+
+struct decision_set {
+    struct string_pool *strings;
+    struct DecisionTuple *tuples;
+    size_t tupleCount;
+    size_t tupleCapacity;
+    // Indices into tuples plus one, or 0 for an empty slot.
+    uint32_t *slots;
+    size_t slotCapacity;
+};
+
+struct decision_set *decision_set_create(void) {
+    struct decision_set *set = calloc(1, sizeof(*set));
+    if (!set) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    set->strings = string_pool_create();
+    if (!set->strings) {
+        free(set);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return set;
+}
+
+void decision_set_destroy(struct decision_set *set) {
+    string_pool_destroy(set->strings);
+    free(set->tuples);
+    free(set->slots);
+    free(set);
+}
+
+static uint32_t hashTuple(const struct DecisionTuple *tuple) {
+    uint64_t hash = mixHash(UINT64_C(0x9e3779b97f4a7c15), tuple->sourceIndex);
+    hash = mixHash(hash, tuple->targetIndex);
+    hash = mixHash(hash, tuple->classIndex);
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+static bool tuplesEqual(const struct DecisionTuple *tuple1, const struct DecisionTuple *tuple2) {
+    return tuple1->sourceIndex == tuple2->sourceIndex
+            && tuple1->targetIndex == tuple2->targetIndex
+            && tuple1->classIndex == tuple2->classIndex;
+}
+
+static bool growSlots(struct decision_set *set) {
+    size_t newSlotCapacity = set->slotCapacity ? set->slotCapacity * 2 : 256;
+    uint32_t *newSlots = calloc(newSlotCapacity, sizeof(*newSlots));
+    if (!newSlots) {
+        return false;
+    }
+    size_t mask = newSlotCapacity - 1;
+    for (size_t i = 0; i < set->tupleCount; ++i) {
+        size_t slotIndex = hashTuple(&set->tuples[i]) & mask;
+        while (newSlots[slotIndex]) {
+            slotIndex = (slotIndex + 1) & mask;
+        }
+        newSlots[slotIndex] = (uint32_t) (i + 1);
+    }
+    free(set->slots);
+    set->slots = newSlots;
+    set->slotCapacity = newSlotCapacity;
+    return true;
+}
+
+static int addTuple(struct decision_set *set, const struct DecisionTuple *tuple) {
+    if ((set->tupleCount + 1) * 4 > set->slotCapacity * 3 && !growSlots(set)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    size_t mask = set->slotCapacity - 1;
+    size_t slotIndex = hashTuple(tuple) & mask;
+    for (; set->slots[slotIndex]; slotIndex = (slotIndex + 1) & mask) {
+        if (tuplesEqual(&set->tuples[set->slots[slotIndex] - 1], tuple)) {
+            return 0;
+        }
+    }
+    if (set->tupleCount == set->tupleCapacity) {
+        size_t newTupleCapacity = set->tupleCapacity ? set->tupleCapacity * 2 : 256;
+        struct DecisionTuple *newTuples = realloc(set->tuples,
+                                                  newTupleCapacity * sizeof(*newTuples));
+        if (!newTuples) {
+            errno = ENOMEM;
+            return -1;
+        }
+        set->tuples = newTuples;
+        set->tupleCapacity = newTupleCapacity;
+    }
+    set->tuples[set->tupleCount++] = *tuple;
+    set->slots[slotIndex] = (uint32_t) set->tupleCount;
+    return 0;
+}
+
+static ssize_t addString(struct decision_set *set, const char *string) {
+    ssize_t index = string_pool_add(set->strings, string, strlen(string));
+    if (index == -1 || index > UINT32_MAX) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return index;
+}
+
+int decision_set_add(struct decision_set *set, const char *sourceContext,
+                     const char *targetContext, const char *className) {
+    ssize_t sourceIndex = addString(set, sourceContext);
+    ssize_t targetIndex = sourceIndex != -1 ? addString(set, targetContext) : -1;
+    ssize_t classIndex = targetIndex != -1 ? addString(set, className) : -1;
+    if (classIndex == -1) {
+        return -1;
+    }
+    struct DecisionTuple tuple = {
+            .sourceIndex = (uint32_t) sourceIndex,
+            .targetIndex = (uint32_t) targetIndex,
+            .classIndex = (uint32_t) classIndex
+    };
+    return addTuple(set, &tuple);
+}
+
+size_t decision_set_get_count(const struct decision_set *set) {
+    return set->tupleCount;
+}
+
+void decision_set_get(const struct decision_set *set, size_t index, const char **sourceContext,
+                      const char **targetContext, const char **className) {
+    const struct DecisionTuple *tuple = &set->tuples[index];
+    *sourceContext = string_pool_get(set->strings, tuple->sourceIndex);
+    *targetContext = string_pool_get(set->strings, tuple->targetIndex);
+    *className = string_pool_get(set->strings, tuple->classIndex);
+}
+
+int decision_set_save(const struct decision_set *set, const char *path) {
+    size_t stringCount = string_pool_get_count(set->strings);
+    size_t tuplesSize = set->tupleCount * sizeof(*set->tuples);
+    size_t size = sizeof(struct SetHeader) + tuplesSize;
+    for (size_t i = 0; i < stringCount; ++i) {
+        size += string_pool_get_length(set->strings, i) + 1;
+    }
+    if (stringCount > UINT32_MAX || set->tupleCount > UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+    char *data = malloc(size);
+    if (!data) {
+        errno = ENOMEM;
+        return -1;
+    }
+    struct SetHeader *header = (struct SetHeader *) data;
+    header->magic = DECISION_SET_MAGIC;
+    header->version = DECISION_SET_VERSION;
+    header->stringCount = (uint32_t) stringCount;
+    header->tupleCount = (uint32_t) set->tupleCount;
+    char *dataChar = data + sizeof(*header);
+    if (tuplesSize) {
+        memcpy(dataChar, set->tuples, tuplesSize);
+        dataChar += tuplesSize;
+    }
+    for (size_t i = 0; i < stringCount; ++i) {
+        size_t length = string_pool_get_length(set->strings, i);
+        memcpy(dataChar, string_pool_get(set->strings, i), length + 1);
+        dataChar += length + 1;
+    }
+    int result = atomic_file_write(path, data, size);
+    int savedErrno = errno;
+    free(data);
+    errno = savedErrno;
+    return result;
+}
+
+// Returns the offsets of the stringCount strings in data, or NULL if they don't fill it exactly.
+static uint32_t *findStrings(const char *data, size_t size, size_t offset, size_t stringCount) {
+    uint32_t *offsets = malloc((stringCount ? stringCount : 1) * sizeof(*offsets));
+    if (!offsets) {
+        return NULL;
+    }
+    for (size_t i = 0; i < stringCount; ++i) {
+        const char *end = offset < size ? memchr(data + offset, '\0', size - offset) : NULL;
+        if (!end) {
+            free(offsets);
+            return NULL;
+        }
+        offsets[i] = (uint32_t) offset;
+        offset = (size_t) (end - data) + 1;
+    }
+    if (offset != size) {
+        free(offsets);
+        return NULL;
+    }
+    return offsets;
+}
+
+struct decision_set *decision_set_load(const char *path) {
+    size_t size;
+    char *data = atomic_file_read(path, &size);
+    if (!data) {
+        return NULL;
+    }
+    struct decision_set *set = NULL;
+    uint32_t *stringOffsets = NULL;
+    int savedErrno = EINVAL;
+    struct SetHeader header;
+    if (size < sizeof(header) || size > UINT32_MAX) {
+        goto finish;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t tuplesSize = (size_t) header.tupleCount * sizeof(struct DecisionTuple);
+    if (header.magic != DECISION_SET_MAGIC || header.version != DECISION_SET_VERSION
+            || size - sizeof(header) < tuplesSize) {
+        goto finish;
+    }
+    stringOffsets = findStrings(data, size, sizeof(header) + tuplesSize, header.stringCount);
+    if (!stringOffsets) {
+        goto finish;
+    }
+    savedErrno = ENOMEM;
+    set = decision_set_create();
+    if (!set) {
+        goto finish;
+    }
+    for (uint32_t i = 0; i < header.tupleCount; ++i) {
+        struct DecisionTuple tuple;
+        memcpy(&tuple, data + sizeof(header) + i * sizeof(tuple), sizeof(tuple));
+        if (tuple.sourceIndex >= header.stringCount || tuple.targetIndex >= header.stringCount
+                || tuple.classIndex >= header.stringCount) {
+            savedErrno = EINVAL;
+            goto error;
+        }
+        if (decision_set_add(set, data + stringOffsets[tuple.sourceIndex],
+                             data + stringOffsets[tuple.targetIndex],
+                             data + stringOffsets[tuple.classIndex]) == -1) {
+            savedErrno = errno;
+            goto error;
+        }
+    }
+    goto finish;
+error:
+    decision_set_destroy(set);
+    set = NULL;
+finish:
+    free(stringOffsets);
+    free(data);
+    if (!set) {
+        errno = savedErrno;
+    }
+    return set;
+}
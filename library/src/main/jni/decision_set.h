@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_DECISION_SET_H
+#define LIBSELINUX_JNI_DECISION_SET_H
+
+#include <stddef.h>
+
+// A set of unique (source context, target context, class name) tuples, for recording the
+// permission checks of a workload and replaying them into a fresh AVC. Classes are kept by name
+// because their values depend on the class mapping of the process. It is saved as a pool of
+// strings followed by triples of indices into it, so each context is stored once no matter how
+// many tuples it appears in. Not thread-safe.
+struct decision_set;
+
+struct decision_set *decision_set_create(void);
+
+void decision_set_destroy(struct decision_set *set);
+
+// Adds the tuple if absent. Returns 0 on success, or -1 with errno set.
+int decision_set_add(struct decision_set *set, const char *sourceContext,
+                     const char *targetContext, const char *className);
+
+size_t decision_set_get_count(const struct decision_set *set);
+
+void decision_set_get(const struct decision_set *set, size_t index, const char **sourceContext,
+                      const char **targetContext, const char **className);
+
+int decision_set_save(const struct decision_set *set, const char *path);
+
+struct decision_set *decision_set_load(const char *path);
+
+#endif // LIBSELINUX_JNI_DECISION_SET_H
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "file_label_batch.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+#include <selinux/selinux.h>
+
+// The same as XATTR_NAME_SELINUX in selinux_internal.h.
+#define XATTR_NAME_SELINUX "security.selinux"
+
+// Enough for any context in practice, and grown if not.
+#define INITIAL_CONTEXT_BUFFER_SIZE 256
+
+struct CreateItem {
+    const char *context;
+    size_t index;
+};
+
+// Orders by context, and then by index so that paths keep their order within a context.
+static int compareCreateItems(const void *item1, const void *item2) {
+    const struct CreateItem *createItem1 = item1;
+    const struct CreateItem *createItem2 = item2;
+    int result = strcmp(createItem1->context, createItem2->context);
+    if (result) {
+        return result;
+    }
+    return createItem1->index < createItem2->index ? -1
+            : createItem1->index > createItem2->index ? 1 : 0;
+}
+
+static int createPath(const char *path, mode_t mode) {
+    if (S_ISDIR(mode)) {
+        return TEMP_FAILURE_RETRY(mkdir(path, mode & 07777)) ? errno : 0;
+    }
+    int fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                                     mode & 07777));
+    if (fd == -1) {
+        return errno;
+    }
+    close(fd);
+    return 0;
+}
+
+int file_label_create_batch(const char *const *paths, const char *const *contexts,
+                            const mode_t *modes, size_t count, int *errors) {
+    struct CreateItem *items = malloc((count ? count : 1) * sizeof(*items));
+    if (!items) {
+        errno = ENOMEM;
+        return -1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        items[i].context = contexts[i];
+        items[i].index = i;
+        errors[i] = 0;
+    }
+    qsort(items, count, sizeof(*items), compareCreateItems);
+    char *previousContext = NULL;
+    if (getfscreatecon_raw(&previousContext)) {
+        int savedErrno = errno;
+        free(items);
+        errno = savedErrno;
+        return -1;
+    }
+    // Each pass only keeps the items that failed with ENOENT, which may succeed once their parent
+    // from another context has been created. Stops once a pass creates nothing.
+    size_t pendingCount = count;
+    bool created = true;
+    while (pendingCount && created) {
+        created = false;
+        size_t deferredCount = 0;
+        const char *currentContext = NULL;
+        int contextError = 0;
+        for (size_t i = 0; i < pendingCount; ++i) {
+            const struct CreateItem *item = &items[i];
+            if (!currentContext || strcmp(item->context, currentContext)) {
+                currentContext = item->context;
+                // E.g. EINVAL for an invalid context, which fails only the paths with it.
+                contextError = setfscreatecon_raw(currentContext) ? errno : 0;
+            }
+            if (contextError) {
+                errors[item->index] = contextError;
+                continue;
+            }
+            int error = createPath(paths[item->index], modes[item->index]);
+            errors[item->index] = error;
+            if (error == ENOENT) {
+                items[deferredCount] = *item;
+                ++deferredCount;
+            } else if (!error) {
+                created = true;
+            }
+        }
+        pendingCount = deferredCount;
+    }
+    // Otherwise later files created by this thread would silently get the last context.
+    int result = setfscreatecon_raw(previousContext);
+    int savedErrno = errno;
+    freecon(previousContext);
+    free(items);
+    errno = savedErrno;
+    return result;
+}
+
+// Returns whether the path already carries the context, or -1 with errno set. The buffer is grown
+// as needed.
+static int hasContext(const char *path, const char *context, size_t contextLength, char **buffer,
+                      size_t *bufferSize) {
+    ssize_t length;
+    while (true) {
+        length = TEMP_FAILURE_RETRY(lgetxattr(path, XATTR_NAME_SELINUX, *buffer, *bufferSize));
+        if (length != -1 || errno != ERANGE) {
+            break;
+        }
+        ssize_t newSize = TEMP_FAILURE_RETRY(lgetxattr(path, XATTR_NAME_SELINUX, NULL, 0));
+        if (newSize == -1) {
+            return -1;
+        }
+        char *newBuffer = realloc(*buffer, (size_t) newSize);
+        if (!newBuffer) {
+            errno = ENOMEM;
+            return -1;
+        }
+        *buffer = newBuffer;
+        *bufferSize = (size_t) newSize;
+    }
+    if (length == -1) {
+        // Unlabeled files have no attribute, and simply need the write.
+        return errno == ENODATA ? 0 : -1;
+    }
+    // The attribute normally includes the terminating NUL, but may not if set by other tools.
+    size_t currentLength = (size_t) length;
+    if (currentLength && !(*buffer)[currentLength - 1]) {
+        --currentLength;
+    }
+    return currentLength == contextLength && !memcmp(*buffer, context, contextLength);
+}
+
+int file_label_set_batch(const char *const *paths, const char *const *contexts, size_t count,
+                         int *errors, size_t *skippedCount) {
+    size_t bufferSize = INITIAL_CONTEXT_BUFFER_SIZE;
+    char *buffer = malloc(bufferSize);
+    if (!buffer) {
+        errno = ENOMEM;
+        return -1;
+    }
+    *skippedCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const char *context = contexts[i];
+        size_t contextLength = strlen(context);
+        int result = hasContext(paths[i], context, contextLength, &buffer, &bufferSize);
+        if (result == -1) {
+            errors[i] = errno;
+            continue;
+        }
+        if (result) {
+            errors[i] = 0;
+            ++*skippedCount;
+            continue;
+        }
+        // Written with the terminating NUL, like lsetfilecon_raw().
+        errors[i] = TEMP_FAILURE_RETRY(lsetxattr(paths[i], XATTR_NAME_SELINUX, context,
+                                                 contextLength + 1, 0)) ? errno : 0;
+    }
+    free(buffer);
+    return 0;
+}
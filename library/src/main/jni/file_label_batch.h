@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_FILE_LABEL_BATCH_H
+#define LIBSELINUX_JNI_FILE_LABEL_BATCH_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Creates each path with its raw context already applied, as a directory if S_ISDIR(modes[i]) or
+// otherwise as an empty regular file, which must not exist yet. Paths are grouped by context, and
+// setfscreatecon() is called once per distinct context, so that each file takes a single metadata
+// write instead of a create and a setfilecon(). Parents may come in any order, since paths failing
+// with ENOENT are retried after the others. The fscreate context of the calling thread, which is
+// per thread, is restored afterwards. Sets errors[i] to 0 or the errno for path i, which is that
+// of setfscreatecon() for an invalid context. Returns 0 on success, or -1 with errno set if the
+// batch couldn't be attempted, or if the previous fscreate context couldn't be restored, in which
+// case errors are still set.
+int file_label_create_batch(const char *const *paths, const char *const *contexts,
+                            const mode_t *modes, size_t count, int *errors);
+
+// Sets the raw context of each path like lsetfilecon(), but first reads the current one into a
+// buffer reused across the batch, and only writes if it differs, so that paths already carrying
+// their context don't dirty any inode metadata. Sets errors[i] to 0 or the errno for path i, and
+// skippedCount to the number of writes skipped. Returns 0 on success, or -1 with errno set if the
+// batch couldn't be attempted.
+int file_label_set_batch(const char *const *paths, const char *const *contexts, size_t count,
+                         int *errors, size_t *skippedCount);
+
+#endif // LIBSELINUX_JNI_FILE_LABEL_BATCH_H
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_HASH_H
+#define LIBSELINUX_JNI_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+static inline uint64_t mixHash(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * UINT64_C(0xbf58476d1ce4e5b9);
+    return hash ^ (hash >> 31);
+}
+
+// Hashes a word at a time instead of a byte at a time like FNV-1a, which makes the hash of a
+// typical context string several times cheaper, while still mixing well enough for power of 2
+// tables.
+static inline uint64_t hashBytes64(const void *bytes, size_t length) {
+    const unsigned char *bytesChars = bytes;
+    uint64_t hash = UINT64_C(0x9e3779b97f4a7c15) ^ length;
+    while (length >= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytesChars, sizeof(word));
+        hash = mixHash(hash, word);
+        bytesChars += sizeof(word);
+        length -= sizeof(word);
+    }
+    if (length) {
+        uint64_t word = 0;
+        memcpy(&word, bytesChars, length);
+        hash = mixHash(hash, word);
+    }
+    return mixHash(hash, hash >> 29);
+}
+
+static inline uint32_t hashBytes(const void *bytes, size_t length) {
+    uint64_t hash = hashBytes64(bytes, length);
+    return (uint32_t) (hash ^ (hash >> 32));
+}
+
+#endif // LIBSELINUX_JNI_HASH_H
@@ -0,0 +1,17 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "init_lazy.h"
+
+#include <pthread.h>
+
+// init_lib() of init.c, which init.c.patch renames and takes the constructor attribute off. The
+// destructor is kept, and is harmless if this never ran.
+void selinux_init_lib(void);
+
+void selinux_lazy_init(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, selinux_init_lib);
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_INIT_LAZY_H
+#define LIBSELINUX_JNI_INIT_LAZY_H
+
+// The constructor of init.c finds selinuxfs by scanning /proc, which would otherwise be paid by
+// System.loadLibrary(). It runs here instead, once and on first use. selinuxfs.c calls this itself,
+// so only callers that reach selinux_mnt or selinux_page_size in libselinux another way need to.
+void selinux_lazy_init(void);
+
+#endif // LIBSELINUX_JNI_INIT_LAZY_H
@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "label_file_concurrent.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "label_file.h"
+
+struct selabel_concurrent {
+    struct selabel_handle *handle;
+    // NULL if we can't walk the specs ourselves.
+    struct saved_data *data;
+    // Compiled on first use, published once and immutable afterwards.
+    pcre2_code **codes;
+    // NULL if not instrumented.
+    struct SpecStats *specStats;
+};
+
+struct SpecStats {
+    uint64_t candidates;
+    uint64_t matches;
+    uint64_t matchNanos;
+};
+
+static pthread_once_t matchDataKeyOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t matchDataKey;
+
+static void freeMatchData(void *matchData) {
+    pcre2_match_data_free(matchData);
+}
+
+static void createMatchDataKey(void) {
+    pthread_key_create(&matchDataKey, freeMatchData);
+}
+
+static pcre2_match_data *getMatchData(void) {
+    pthread_once(&matchDataKeyOnce, createMatchDataKey);
+    pcre2_match_data *matchData = pthread_getspecific(matchDataKey);
+    if (!matchData) {
+        // We only need to know whether it matched.
+        matchData = pcre2_match_data_create(1, NULL);
+        if (!matchData) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        pthread_setspecific(matchDataKey, matchData);
+    }
+    return matchData;
+}
+
+struct selabel_concurrent *selabel_concurrent_create(struct selabel_handle *handle,
+                                                     bool instrumented) {
+    struct selabel_concurrent *concurrent = calloc(1, sizeof(*concurrent));
+    if (!concurrent) {
+        return NULL;
+    }
+    concurrent->handle = handle;
+    struct saved_data *data = handle->backend == SELABEL_CTX_FILE ? handle->data : NULL;
+    // Leave substitutions to label_file.c.
+    if (data && !data->subs && !data->dist_subs) {
+        concurrent->codes = calloc(data->nspec ? data->nspec : 1, sizeof(*concurrent->codes));
+        if (!concurrent->codes) {
+            free(concurrent);
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (instrumented) {
+            concurrent->specStats = calloc(data->nspec ? data->nspec : 1,
+                                           sizeof(*concurrent->specStats));
+            if (!concurrent->specStats) {
+                free(concurrent->codes);
+                free(concurrent);
+                errno = ENOMEM;
+                return NULL;
+            }
+        }
+        concurrent->data = data;
+    }
+    return concurrent;
+}
+
+void selabel_concurrent_destroy(struct selabel_concurrent *concurrent) {
+    if (concurrent->data) {
+        for (unsigned int i = 0; i < concurrent->data->nspec; ++i) {
+            pcre2_code_free(concurrent->codes[i]);
+        }
+        free(concurrent->codes);
+        free(concurrent->specStats);
+    }
+    selabel_close_pooled(concurrent->handle);
+    free(concurrent);
+}
+
+// Same as compile_regex() in label_file.h, but without touching the spec.
+static pcre2_code *compileSpec(struct selabel_concurrent *concurrent, unsigned int index) {
+    pcre2_code *code = __atomic_load_n(&concurrent->codes[index], __ATOMIC_ACQUIRE);
+    if (code) {
+        return code;
+    }
+    struct saved_data *data = concurrent->data;
+    struct spec *spec = &data->spec_arr[index];
+    const char *regex = spec->regex_str;
+    if (spec->stem_id >= 0) {
+        regex += data->stem_arr[spec->stem_id].len;
+    }
+    size_t regexLength = strlen(regex);
+    char *anchoredRegex = malloc(regexLength + 3);
+    if (!anchoredRegex) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    anchoredRegex[0] = '^';
+    memcpy(anchoredRegex + 1, regex, regexLength);
+    anchoredRegex[regexLength + 1] = '$';
+    anchoredRegex[regexLength + 2] = '\0';
+    int errorCode;
+    PCRE2_SIZE errorOffset;
+    code = pcre2_compile((PCRE2_SPTR) anchoredRegex, PCRE2_ZERO_TERMINATED, PCRE2_DOTALL,
+                         &errorCode, &errorOffset, NULL);
+    free(anchoredRegex);
+    if (!code) {
+        errno = EINVAL;
+        return NULL;
+    }
+    pcre2_code *publishedCode = NULL;
+    if (!__atomic_compare_exchange_n(&concurrent->codes[index], &publishedCode, code, false,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        // Another thread won the race.
+        pcre2_code_free(code);
+        code = publishedCode;
+    }
+    return code;
+}
+
+// Same as find_stem_from_file() in label_file.h.
+static int findStem(const struct saved_data *data, const char *key, size_t *outStemLength) {
+    const char *stemEnd = strchr(key + 1, '/');
+    if (!stemEnd) {
+        return -1;
+    }
+    size_t stemLength = (size_t) (stemEnd - key);
+    for (int i = 0; i < data->num_stems; ++i) {
+        if ((size_t) data->stem_arr[i].len == stemLength
+                && !strncmp(key, data->stem_arr[i].buf, stemLength)) {
+            *outStemLength = stemLength;
+            return i;
+        }
+    }
+    return -1;
+}
+
+static char *removeDuplicateSlashes(const char *key) {
+    char *cleanKey = malloc(strlen(key) + 1);
+    if (!cleanKey) {
+        return NULL;
+    }
+    char *cleanKeyEnd = cleanKey;
+    char previousChar = '\0';
+    for (const char *keyChar = key; *keyChar; ++keyChar) {
+        if (!(*keyChar == '/' && previousChar == '/')) {
+            *cleanKeyEnd++ = *keyChar;
+        }
+        previousChar = *keyChar;
+    }
+    *cleanKeyEnd = '\0';
+    return cleanKey;
+}
+
+static uint64_t getMonotonicNanos(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
+
+// Returns the matching spec, or NULL with errno set. Always inlined with a constant instrumented,
+// so that the uninstrumented loop doesn't contain any of the instrumentation.
+static inline __attribute__((always_inline)) struct spec *lookupSpec(
+        struct selabel_concurrent *concurrent, const char *key, int type, bool instrumented) {
+    struct saved_data *data = concurrent->data;
+    pcre2_match_data *matchData = getMatchData();
+    if (!matchData) {
+        return NULL;
+    }
+    mode_t mode = (mode_t) type & S_IFMT;
+    size_t stemLength = 0;
+    int stemId = findStem(data, key, &stemLength);
+    for (unsigned int i = data->nspec; i-- > 0; ) {
+        struct spec *spec = &data->spec_arr[i];
+        if ((spec->stem_id != -1 && spec->stem_id != stemId)
+                || (mode && spec->mode && mode != spec->mode)) {
+            continue;
+        }
+        pcre2_code *code = compileSpec(concurrent, i);
+        if (!code) {
+            return NULL;
+        }
+        const char *subject = spec->stem_id == -1 ? key : key + stemLength;
+        uint64_t startNanos = instrumented ? getMonotonicNanos() : 0;
+        int result = pcre2_match(code, (PCRE2_SPTR) subject, PCRE2_ZERO_TERMINATED, 0, 0,
+                                 matchData, NULL);
+        if (instrumented) {
+            struct SpecStats *specStats = &concurrent->specStats[i];
+            __atomic_fetch_add(&specStats->candidates, 1, __ATOMIC_RELAXED);
+            if (result >= 0) {
+                __atomic_fetch_add(&specStats->matches, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_fetch_add(&specStats->matchNanos, getMonotonicNanos() - startNanos,
+                               __ATOMIC_RELAXED);
+        }
+        if (result >= 0) {
+            return spec;
+        }
+        if (result != PCRE2_ERROR_NOMATCH) {
+            break;
+        }
+    }
+    errno = ENOENT;
+    return NULL;
+}
+
+int selabel_concurrent_lookup(struct selabel_concurrent *concurrent, char **context,
+                              const char *key, int type) {
+    // Like lookup_common(), and findStem() needs at least one character.
+    if (!*key) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (!concurrent->data) {
+        return selabel_lookup(concurrent->handle, context, key, type);
+    }
+    char *cleanKey = NULL;
+    if (strstr(key, "//")) {
+        cleanKey = removeDuplicateSlashes(key);
+        if (!cleanKey) {
+            errno = ENOMEM;
+            return -1;
+        }
+    }
+    const char *lookupKey = cleanKey ? cleanKey : key;
+    struct spec *spec = concurrent->specStats
+            ? lookupSpec(concurrent, lookupKey, type, true)
+            : lookupSpec(concurrent, lookupKey, type, false);
+    free(cleanKey);
+    if (!spec) {
+        return -1;
+    }
+    if (!strcmp(spec->lr.ctx_raw, "<<none>>")) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (concurrent->handle->validating
+            && !__atomic_load_n(&spec->lr.validated, __ATOMIC_ACQUIRE)) {
+        // Let label.c validate the context, which only happens once.
+        return selabel_lookup(concurrent->handle, context, key, type);
+    }
+    *context = strdup(spec->lr.ctx_raw);
+    if (!*context) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+size_t selabel_concurrent_get_spec_stats(struct selabel_concurrent *concurrent, uint64_t *stats) {
+    if (!concurrent->specStats) {
+        return 0;
+    }
+    struct saved_data *data = concurrent->data;
+    if (stats) {
+        for (unsigned int i = 0; i < data->nspec; ++i) {
+            struct SpecStats *specStats = &concurrent->specStats[i];
+            uint64_t *specStatsValues = &stats[i * SELABEL_SPEC_STATS_SIZE];
+            specStatsValues[SELABEL_SPEC_STATS_LINE_NUMBER] = data->spec_arr[i].lr.lineno;
+            specStatsValues[SELABEL_SPEC_STATS_CANDIDATES] = __atomic_load_n(
+                    &specStats->candidates, __ATOMIC_RELAXED);
+            specStatsValues[SELABEL_SPEC_STATS_MATCHES] = __atomic_load_n(
+                    &specStats->matches, __ATOMIC_RELAXED);
+            specStatsValues[SELABEL_SPEC_STATS_MATCH_NANOS] = __atomic_load_n(
+                    &specStats->matchNanos, __ATOMIC_RELAXED);
+        }
+    }
+    return data->nspec;
+}
+
+int selabel_concurrent_get_footprint(struct selabel_concurrent *concurrent,
+                                     struct selabel_footprint *footprint) {
+    if (selabel_get_footprint(concurrent->handle, footprint) == -1) {
+        return -1;
+    }
+    footprint->specs += sizeof(*concurrent);
+    if (concurrent->data) {
+        struct saved_data *data = concurrent->data;
+        footprint->specs += data->nspec * sizeof(*concurrent->codes);
+        if (concurrent->specStats) {
+            footprint->specs += data->nspec * sizeof(*concurrent->specStats);
+        }
+        for (unsigned int i = 0; i < data->nspec; ++i) {
+            selabel_footprint_add_regex(footprint, __atomic_load_n(&concurrent->codes[i],
+                                                                   __ATOMIC_ACQUIRE));
+        }
+    }
+    return 0;
+}
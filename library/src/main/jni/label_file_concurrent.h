@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_LABEL_FILE_CONCURRENT_H
+#define LIBSELINUX_JNI_LABEL_FILE_CONCURRENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <selinux/label.h>
+
+#include "label_file_memory.h"
+
+// A label handle for lookups from many threads at once. For file_contexts, lookups walk the specs
+// of the handle themselves without taking any lock: each regex is compiled on first use and
+// published once with compare-and-swap, the specs are never modified afterwards, and match data is
+// kept per thread. Other backends simply go through selabel_lookup().
+struct selabel_concurrent;
+
+// The values per spec in selabel_concurrent_get_spec_stats().
+#define SELABEL_SPEC_STATS_LINE_NUMBER 0
+#define SELABEL_SPEC_STATS_CANDIDATES 1
+#define SELABEL_SPEC_STATS_MATCHES 2
+#define SELABEL_SPEC_STATS_MATCH_NANOS 3
+#define SELABEL_SPEC_STATS_SIZE 4
+
+// Takes ownership of the handle, which must be from selabel_open_pooled(). If instrumented is true,
+// lookups count per spec how often it was a candidate for matching, how often it matched and how
+// long matching it took; otherwise lookups don't do any of the work.
+struct selabel_concurrent *selabel_concurrent_create(struct selabel_handle *handle,
+                                                     bool instrumented);
+
+void selabel_concurrent_destroy(struct selabel_concurrent *concurrent);
+
+int selabel_concurrent_lookup(struct selabel_concurrent *concurrent, char **context,
+                              const char *key, int type);
+
+// Returns the number of specs with stats, and fills in SELABEL_SPEC_STATS_SIZE values for each of
+// them if stats isn't NULL. Specs are in file order, and there are no stats if the handle isn't
+// instrumented or isn't for file_contexts.
+size_t selabel_concurrent_get_spec_stats(struct selabel_concurrent *concurrent, uint64_t *stats);
+
+// Same as selabel_get_footprint(), plus what the concurrent handle itself uses.
+int selabel_concurrent_get_footprint(struct selabel_concurrent *concurrent,
+                                     struct selabel_footprint *footprint);
+
+#endif // LIBSELINUX_JNI_LABEL_FILE_CONCURRENT_H
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "label_file_memory.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "label_file.h"
+#include "string_pool.h"
+
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+// Destroyed when the last file_contexts handle from selabel_open_pooled() is closed, since strings
+// are never removed from it.
+static struct string_pool *pool;
+static size_t pooledHandleCount;
+
+// Returns the pooled copy of a heap string after freeing it, or the string itself if it can't be
+// pooled.
+static char *poolStringLocked(char *string) {
+    if (!string || string_pool_contains(pool, string)) {
+        return string;
+    }
+    ssize_t index = string_pool_add(pool, string, strlen(string));
+    if (index == -1) {
+        return string;
+    }
+    free(string);
+    return (char *) string_pool_get(pool, (size_t) index);
+}
+
+static void poolStrings(struct saved_data *data) {
+    pthread_mutex_lock(&poolMutex);
+    // Counted even if the pool can't be created, since closing can't tell.
+    ++pooledHandleCount;
+    if (!pool) {
+        pool = string_pool_create();
+        if (!pool) {
+            pthread_mutex_unlock(&poolMutex);
+            return;
+        }
+    }
+    for (unsigned int i = 0; i < data->nspec; ++i) {
+        struct spec *spec = &data->spec_arr[i];
+        struct selabel_lookup_rec *lookupRec = &spec->lr;
+        bool transIsRaw = lookupRec->ctx_trans == lookupRec->ctx_raw;
+        // Contexts are always on the heap, even for compiled file_contexts.
+        lookupRec->ctx_raw = poolStringLocked(lookupRec->ctx_raw);
+        lookupRec->ctx_trans = transIsRaw ? lookupRec->ctx_raw
+                : poolStringLocked(lookupRec->ctx_trans);
+        if (!spec->from_mmap) {
+            spec->type_str = poolStringLocked(spec->type_str);
+        }
+    }
+    for (int i = 0; i < data->num_stems; ++i) {
+        struct stem *stem = &data->stem_arr[i];
+        if (!stem->from_mmap) {
+            stem->buf = poolStringLocked(stem->buf);
+        }
+    }
+    pthread_mutex_unlock(&poolMutex);
+}
+
+struct selabel_handle *selabel_open_pooled(unsigned int backend, const struct selinux_opt *options,
+                                           unsigned int optionCount) {
+    struct selabel_handle *handle = selabel_open(backend, options, optionCount);
+    if (handle && handle->backend == SELABEL_CTX_FILE) {
+        poolStrings(handle->data);
+    }
+    return handle;
+}
+
+void selabel_close_pooled(struct selabel_handle *handle) {
+    if (handle->backend == SELABEL_CTX_FILE) {
+        struct saved_data *data = handle->data;
+        pthread_mutex_lock(&poolMutex);
+        if (pool) {
+            // Keep label_file.c from freeing pooled strings.
+            for (unsigned int i = 0; i < data->nspec; ++i) {
+                struct spec *spec = &data->spec_arr[i];
+                if (string_pool_contains(pool, spec->lr.ctx_raw)) {
+                    if (spec->lr.ctx_trans == spec->lr.ctx_raw) {
+                        spec->lr.ctx_trans = NULL;
+                    }
+                    spec->lr.ctx_raw = NULL;
+                }
+                if (string_pool_contains(pool, spec->lr.ctx_trans)) {
+                    spec->lr.ctx_trans = NULL;
+                }
+                if (string_pool_contains(pool, spec->type_str)) {
+                    spec->type_str = NULL;
+                }
+            }
+            for (int i = 0; i < data->num_stems; ++i) {
+                struct stem *stem = &data->stem_arr[i];
+                if (string_pool_contains(pool, stem->buf)) {
+                    stem->buf = NULL;
+                }
+            }
+        }
+        // Nothing points into the pool once the last handle has let go of its strings.
+        if (!--pooledHandleCount && pool) {
+            string_pool_destroy(pool);
+            pool = NULL;
+        }
+        pthread_mutex_unlock(&poolMutex);
+    }
+    selabel_close(handle);
+}
+
+static size_t getOwnedStringSize(const char *string) {
+    if (!string || (pool && string_pool_contains(pool, string))) {
+        return 0;
+    }
+    return malloc_usable_size((void *) string);
+}
+
+// regex.c has no getter for the compiled pcre2_code in its private struct regex_data, so this
+// relies on it being the first member, which libselinux_layout_check.c makes the build check.
+static const pcre2_code *getRegexCode(const struct regex_data *regex) {
+    return *(pcre2_code *const *) regex;
+}
+
+void selabel_footprint_add_regex(struct selabel_footprint *footprint, const void *code) {
+    if (!code) {
+        return;
+    }
+    size_t size = 0;
+    if (!pcre2_pattern_info(code, PCRE2_INFO_SIZE, &size)) {
+        footprint->regexes += size;
+    }
+    size_t jitSize = 0;
+    if (!pcre2_pattern_info(code, PCRE2_INFO_JITSIZE, &jitSize)) {
+        footprint->jit += jitSize;
+    }
+}
+
+int selabel_get_footprint(struct selabel_handle *handle, struct selabel_footprint *footprint) {
+    if (handle->backend != SELABEL_CTX_FILE) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+    memset(footprint, 0, sizeof(*footprint));
+    struct saved_data *data = handle->data;
+    footprint->specs = sizeof(*data) + data->alloc_specs * sizeof(*data->spec_arr)
+            + (size_t) data->alloc_stems * sizeof(*data->stem_arr);
+    pthread_mutex_lock(&poolMutex);
+    for (unsigned int i = 0; i < data->nspec; ++i) {
+        struct spec *spec = &data->spec_arr[i];
+        footprint->strings += getOwnedStringSize(spec->lr.ctx_raw);
+        if (spec->lr.ctx_trans != spec->lr.ctx_raw) {
+            footprint->strings += getOwnedStringSize(spec->lr.ctx_trans);
+        }
+        if (!spec->from_mmap) {
+            footprint->strings += getOwnedStringSize(spec->regex_str);
+            footprint->strings += getOwnedStringSize(spec->type_str);
+        }
+        if (__atomic_load_n(&spec->regex_compiled, __ATOMIC_ACQUIRE) && spec->regex) {
+            footprint->regexes += malloc_usable_size(spec->regex);
+            selabel_footprint_add_regex(footprint, getRegexCode(spec->regex));
+        }
+    }
+    for (int i = 0; i < data->num_stems; ++i) {
+        struct stem *stem = &data->stem_arr[i];
+        if (!stem->from_mmap) {
+            footprint->strings += getOwnedStringSize(stem->buf);
+        }
+    }
+    footprint->pooled_strings = pool ? string_pool_get_footprint(pool) : 0;
+    pthread_mutex_unlock(&poolMutex);
+    for (struct mmap_area *area = data->mmap_areas; area; area = area->next) {
+        footprint->mapped += area->len;
+    }
+    return 0;
+}
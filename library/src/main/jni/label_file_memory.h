@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_LABEL_FILE_MEMORY_H
+#define LIBSELINUX_JNI_LABEL_FILE_MEMORY_H
+
+#include <stddef.h>
+
+#include <selinux/label.h>
+
+// Bytes used by a label handle.
+struct selabel_footprint {
+    // Spec and stem arrays.
+    size_t specs;
+    // Strings owned by the handle.
+    size_t strings;
+    // The string pool shared by all handles in the process.
+    size_t pooled_strings;
+    // Compiled regexes.
+    size_t regexes;
+    // JIT compiled code of regexes.
+    size_t jit;
+    // Mapped compiled file_contexts, which is backed by the file.
+    size_t mapped;
+};
+
+// Same as selabel_open(), but for file_contexts also moves the context, type and stem strings into
+// a string pool shared by all handles in the process, because the same few hundred contexts are
+// repeated across thousands of specs.
+struct selabel_handle *selabel_open_pooled(unsigned int backend, const struct selinux_opt *options,
+                                           unsigned int optionCount);
+
+// Must be used instead of selabel_close() for handles from selabel_open_pooled().
+void selabel_close_pooled(struct selabel_handle *handle);
+
+// Only supported for file_contexts. Returns 0 on success, or -1 with errno set.
+int selabel_get_footprint(struct selabel_handle *handle, struct selabel_footprint *footprint);
+
+// Adds a compiled pcre2_code to the footprint.
+void selabel_footprint_add_regex(struct selabel_footprint *footprint, const void *code);
+
+#endif // LIBSELINUX_JNI_LABEL_FILE_MEMORY_H
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "label_reload.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "label_file_memory.h"
+#include "reader_epoch.h"
+
+struct SpecFileStat {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+};
+
+struct selabel_reloadable {
+    unsigned int backend;
+    struct selinux_opt *options;
+    unsigned int optionCount;
+
+    struct selabel_handle *handle;
+    // Lookups use handle without a lock, and a reload waits for them before closing the old one.
+    struct reader_epoch readerEpoch;
+
+    // Serializes reloads, and guards the fields below.
+    pthread_mutex_t reloadMutex;
+    unsigned char *digest;
+    size_t digestSize;
+    struct SpecFileStat *specFileStats;
+    size_t specFileStatCount;
+
+    pthread_mutex_t asyncMutex;
+    bool asyncRunning;
+    bool asyncThreadStarted;
+    pthread_t asyncThread;
+    bool asyncForce;
+};
+
+static void freeOptions(struct selinux_opt *options, unsigned int optionCount) {
+    for (unsigned int i = 0; i < optionCount; ++i) {
+        free((char *) options[i].value);
+    }
+    free(options);
+}
+
+// Copies the options, adding SELABEL_OPT_DIGEST so that we can compare digests across reloads.
+static struct selinux_opt *copyOptions(const struct selinux_opt *options,
+                                       unsigned int optionCount, unsigned int *outOptionCount) {
+    struct selinux_opt *newOptions = calloc(optionCount + 1, sizeof(*newOptions));
+    if (!newOptions) {
+        return NULL;
+    }
+    unsigned int newOptionCount = 0;
+    bool hasDigest = false;
+    for (unsigned int i = 0; i < optionCount; ++i) {
+        struct selinux_opt *newOption = &newOptions[newOptionCount++];
+        newOption->type = options[i].type;
+        if (options[i].value) {
+            newOption->value = strdup(options[i].value);
+            if (!newOption->value) {
+                freeOptions(newOptions, newOptionCount);
+                return NULL;
+            }
+            if (newOption->type == SELABEL_OPT_DIGEST) {
+                hasDigest = true;
+            }
+        }
+    }
+    if (!hasDigest) {
+        struct selinux_opt *newOption = &newOptions[newOptionCount++];
+        newOption->type = SELABEL_OPT_DIGEST;
+        newOption->value = strdup("1");
+        if (!newOption->value) {
+            freeOptions(newOptions, newOptionCount);
+            return NULL;
+        }
+    }
+    *outOptionCount = newOptionCount;
+    return newOptions;
+}
+
+static bool statSpecFiles(char **specFiles, size_t specFileCount,
+                          struct SpecFileStat **outSpecFileStats) {
+    struct SpecFileStat *specFileStats = calloc(specFileCount ? specFileCount : 1,
+                                                sizeof(*specFileStats));
+    if (!specFileStats) {
+        return false;
+    }
+    for (size_t i = 0; i < specFileCount; ++i) {
+        struct stat specFileStat;
+        // A missing file simply compares unequal once it appears.
+        if (!stat(specFiles[i], &specFileStat)) {
+            specFileStats[i].dev = specFileStat.st_dev;
+            specFileStats[i].ino = specFileStat.st_ino;
+            specFileStats[i].size = specFileStat.st_size;
+            specFileStats[i].mtime = specFileStat.st_mtim;
+        }
+    }
+    *outSpecFileStats = specFileStats;
+    return true;
+}
+
+static bool specFileStatsEqual(const struct SpecFileStat *stats1,
+                               const struct SpecFileStat *stats2, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (stats1[i].dev != stats2[i].dev || stats1[i].ino != stats2[i].ino
+                || stats1[i].size != stats2[i].size
+                || stats1[i].mtime.tv_sec != stats2[i].mtime.tv_sec
+                || stats1[i].mtime.tv_nsec != stats2[i].mtime.tv_nsec) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Returns whether the spec files of the current handle changed on disk since it was opened.
+static bool specFilesChangedLocked(struct selabel_reloadable *reloadable) {
+    if (!reloadable->specFileStats) {
+        return true;
+    }
+    unsigned char *digest;
+    size_t digestSize;
+    char **specFiles;
+    size_t specFileCount;
+    if (selabel_digest(reloadable->handle, &digest, &digestSize, &specFiles, &specFileCount)
+            || specFileCount != reloadable->specFileStatCount) {
+        return true;
+    }
+    struct SpecFileStat *specFileStats;
+    if (!statSpecFiles(specFiles, specFileCount, &specFileStats)) {
+        return true;
+    }
+    bool changed = !specFileStatsEqual(specFileStats, reloadable->specFileStats, specFileCount);
+    free(specFileStats);
+    return changed;
+}
+
+// Remembers the digest and the stats of the spec files of a handle, and returns whether the
+// digest differs from the previous one.
+static bool updateDigestLocked(struct selabel_reloadable *reloadable,
+                               struct selabel_handle *handle) {
+    unsigned char *digest;
+    size_t digestSize;
+    char **specFiles;
+    size_t specFileCount;
+    if (selabel_digest(handle, &digest, &digestSize, &specFiles, &specFileCount)) {
+        // Without a digest, every reload counts as a change.
+        free(reloadable->digest);
+        reloadable->digest = NULL;
+        reloadable->digestSize = 0;
+        free(reloadable->specFileStats);
+        reloadable->specFileStats = NULL;
+        reloadable->specFileStatCount = 0;
+        return true;
+    }
+    bool changed = !reloadable->digest || digestSize != reloadable->digestSize
+            || memcmp(digest, reloadable->digest, digestSize);
+    if (changed) {
+        unsigned char *newDigest = malloc(digestSize ? digestSize : 1);
+        if (newDigest) {
+            memcpy(newDigest, digest, digestSize);
+        }
+        free(reloadable->digest);
+        reloadable->digest = newDigest;
+        reloadable->digestSize = newDigest ? digestSize : 0;
+    }
+    struct SpecFileStat *specFileStats;
+    if (!statSpecFiles(specFiles, specFileCount, &specFileStats)) {
+        specFileStats = NULL;
+        specFileCount = 0;
+    }
+    free(reloadable->specFileStats);
+    reloadable->specFileStats = specFileStats;
+    reloadable->specFileStatCount = specFileCount;
+    return changed;
+}
+
+struct selabel_reloadable *selabel_reloadable_open(unsigned int backend,
+                                                   const struct selinux_opt *options,
+                                                   unsigned int optionCount) {
+    struct selabel_reloadable *reloadable = calloc(1, sizeof(*reloadable));
+    if (!reloadable) {
+        return NULL;
+    }
+    reloadable->backend = backend;
+    reloadable->options = copyOptions(options, optionCount, &reloadable->optionCount);
+    if (!reloadable->options) {
+        free(reloadable);
+        errno = ENOMEM;
+        return NULL;
+    }
+    reloadable->handle = selabel_open_pooled(backend, reloadable->options,
+                                             reloadable->optionCount);
+    if (!reloadable->handle) {
+        int savedErrno = errno;
+        freeOptions(reloadable->options, reloadable->optionCount);
+        free(reloadable);
+        errno = savedErrno;
+        return NULL;
+    }
+    pthread_mutex_init(&reloadable->reloadMutex, NULL);
+    pthread_mutex_init(&reloadable->asyncMutex, NULL);
+    updateDigestLocked(reloadable, reloadable->handle);
+    return reloadable;
+}
+
+void selabel_reloadable_close(struct selabel_reloadable *reloadable) {
+    if (reloadable->asyncThreadStarted) {
+        pthread_join(reloadable->asyncThread, NULL);
+    }
+    selabel_close_pooled(reloadable->handle);
+    free(reloadable->digest);
+    free(reloadable->specFileStats);
+    pthread_mutex_destroy(&reloadable->asyncMutex);
+    pthread_mutex_destroy(&reloadable->reloadMutex);
+    freeOptions(reloadable->options, reloadable->optionCount);
+    free(reloadable);
+}
+
+int selabel_reloadable_lookup(struct selabel_reloadable *reloadable, char **context,
+                              const char *key, int type) {
+    unsigned int readerIndex = reader_epoch_enter(&reloadable->readerEpoch);
+    struct selabel_handle *handle = __atomic_load_n(&reloadable->handle, __ATOMIC_SEQ_CST);
+    int result = selabel_lookup(handle, context, key, type);
+    reader_epoch_leave(&reloadable->readerEpoch, readerIndex);
+    return result;
+}
+
+static int reloadLocked(struct selabel_reloadable *reloadable, bool force) {
+    if (!force && !specFilesChangedLocked(reloadable)) {
+        return 0;
+    }
+    struct selabel_handle *newHandle = selabel_open_pooled(reloadable->backend,
+                                                           reloadable->options,
+                                                           reloadable->optionCount);
+    if (!newHandle) {
+        return -1;
+    }
+    if (!updateDigestLocked(reloadable, newHandle) && !force) {
+        // Touched but not changed.
+        selabel_close_pooled(newHandle);
+        return 0;
+    }
+    struct selabel_handle *oldHandle = __atomic_exchange_n(&reloadable->handle, newHandle,
+                                                           __ATOMIC_SEQ_CST);
+    reader_epoch_synchronize(&reloadable->readerEpoch);
+    selabel_close_pooled(oldHandle);
+    return 1;
+}
+
+int selabel_reloadable_reload(struct selabel_reloadable *reloadable, bool force) {
+    pthread_mutex_lock(&reloadable->reloadMutex);
+    int result = reloadLocked(reloadable, force);
+    pthread_mutex_unlock(&reloadable->reloadMutex);
+    return result;
+}
+
+static void *runAsyncReload(void *argument) {
+    struct selabel_reloadable *reloadable = argument;
+    selabel_reloadable_reload(reloadable, reloadable->asyncForce);
+    pthread_mutex_lock(&reloadable->asyncMutex);
+    reloadable->asyncRunning = false;
+    pthread_mutex_unlock(&reloadable->asyncMutex);
+    return NULL;
+}
+
+int selabel_reloadable_reload_async(struct selabel_reloadable *reloadable, bool force) {
+    pthread_mutex_lock(&reloadable->asyncMutex);
+    if (reloadable->asyncRunning) {
+        pthread_mutex_unlock(&reloadable->asyncMutex);
+        return 0;
+    }
+    if (reloadable->asyncThreadStarted) {
+        // It has finished reloading and is only about to return.
+        pthread_join(reloadable->asyncThread, NULL);
+        reloadable->asyncThreadStarted = false;
+    }
+    reloadable->asyncForce = force;
+    int error = pthread_create(&reloadable->asyncThread, NULL, runAsyncReload, reloadable);
+    if (!error) {
+        reloadable->asyncRunning = true;
+        reloadable->asyncThreadStarted = true;
+    }
+    pthread_mutex_unlock(&reloadable->asyncMutex);
+    if (error) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_LABEL_RELOAD_H
+#define LIBSELINUX_JNI_LABEL_RELOAD_H
+
+#include <stdbool.h>
+
+#include <selinux/label.h>
+
+// A label handle that can be reloaded while other threads are looking up labels with it. Lookups
+// never take a lock; a reload builds a new handle on the reloading thread, swaps it in atomically
+// and closes the old one once no lookup is using it anymore.
+struct selabel_reloadable;
+
+struct selabel_reloadable *selabel_reloadable_open(unsigned int backend,
+                                                   const struct selinux_opt *options,
+                                                   unsigned int optionCount);
+
+// Must not be called concurrently with any other function on the same handle.
+void selabel_reloadable_close(struct selabel_reloadable *reloadable);
+
+int selabel_reloadable_lookup(struct selabel_reloadable *reloadable, char **context,
+                              const char *key, int type);
+
+// Reloads the handle if its spec files changed on disk and their digest differs, or
+// unconditionally if force is true. Returns 1 if a new handle was swapped in, 0 if not, or -1 with
+// errno set.
+int selabel_reloadable_reload(struct selabel_reloadable *reloadable, bool force);
+
+// Like selabel_reloadable_reload(), but on a background thread. Does nothing if a reload is
+// already in progress. Returns 0 on success, or -1 with errno set.
+int selabel_reloadable_reload_async(struct selabel_reloadable *reloadable, bool force);
+
+#endif // LIBSELINUX_JNI_LABEL_RELOAD_H
@@ -5,6 +5,7 @@
 
 #include <errno.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -12,8 +13,25 @@
 
 #include <android/log.h>
 
+#include <selinux/label.h>
 #include <selinux/selinux.h>
 
+#include "avc_query.h"
+#include "class_map.h"
+#include "context_validate.h"
+#include "file_label_batch.h"
+#include "init_lazy.h"
+#include "label_file_concurrent.h"
+#include "label_file_memory.h"
+#include "label_reload.h"
+#include "mls_levels.h"
+#include "peer_contexts.h"
+#include "proc_scan.h"
+#include "property_trie.h"
+#include "seapp_contexts.h"
+#include "service_table.h"
+#include "status_page.h"
+
 #define ALOGV(...) __android_log_print(ANDROID_LOG_VERBOSE, LOG_TAG, __VA_ARGS__)
 #define ALOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
 #define ALOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -64,6 +82,14 @@ static jmethodID findMethod(JNIEnv *env, jclass clazz, const char *name, const c
     return method;
 }
 
+static jclass getByteArrayClass(JNIEnv *env) {
+    static jclass byteArrayClass = NULL;
+    if (!byteArrayClass) {
+        byteArrayClass = findClass(env, "[B");
+    }
+    return byteArrayClass;
+}
+
 static jclass getErrnoExceptionClass(JNIEnv *env) {
     static jclass errnoExceptionClass = NULL;
     if (!errnoExceptionClass) {
@@ -89,6 +115,30 @@ static jfieldID getFileDescriptorDescriptorField(JNIEnv *env) {
     return fileDescriptorDescriptorField;
 }
 
+static jclass getSelinuxOptClass(JNIEnv *env) {
+    static jclass selinuxOptClass = NULL;
+    if (!selinuxOptClass) {
+        selinuxOptClass = findClass(env, "me/zhanghai/android/libselinux/SelinuxOpt");
+    }
+    return selinuxOptClass;
+}
+
+static jfieldID getSelinuxOptTypeField(JNIEnv *env) {
+    static jfieldID selinuxOptTypeField = NULL;
+    if (!selinuxOptTypeField) {
+        selinuxOptTypeField = findField(env, getSelinuxOptClass(env), "type", "I");
+    }
+    return selinuxOptTypeField;
+}
+
+static jfieldID getSelinuxOptValueField(JNIEnv *env) {
+    static jfieldID selinuxOptValueField = NULL;
+    if (!selinuxOptValueField) {
+        selinuxOptValueField = findField(env, getSelinuxOptClass(env), "value", "[B");
+    }
+    return selinuxOptValueField;
+}
+
 static void throwException(JNIEnv *env, jclass exceptionClass, jmethodID constructor3,
                            jmethodID constructor2, const char *functionName, int error) {
     jthrowable cause = NULL;
@@ -140,6 +190,125 @@ static char *mallocStringFromBytes(JNIEnv *env, jbyteArray javaBytes) {
     return string;
 }
 
+// Reads the bytes into a buffer that is reused across calls and grown as needed, for batch calls.
+static char *getStringFromBytes(JNIEnv *env, jbyteArray javaBytes, char **buffer,
+                                size_t *bufferCapacity) {
+    jsize javaLength = (*env)->GetArrayLength(env, javaBytes);
+    size_t length = (size_t) javaLength;
+    if (*bufferCapacity < length + 1) {
+        size_t newBufferCapacity = *bufferCapacity ? *bufferCapacity : 256;
+        while (newBufferCapacity < length + 1) {
+            newBufferCapacity *= 2;
+        }
+        char *newBuffer = realloc(*buffer, newBufferCapacity);
+        if (!newBuffer) {
+            return NULL;
+        }
+        *buffer = newBuffer;
+        *bufferCapacity = newBufferCapacity;
+    }
+    jbyte *stringBytes = (jbyte *) *buffer;
+    (*env)->GetByteArrayRegion(env, javaBytes, 0, javaLength, stringBytes);
+    (*buffer)[length] = '\0';
+    return *buffer;
+}
+
+// Returns the string at the index of a nullable array of nullable byte[], read into a reused
+// buffer.
+static bool getOptionalStringFromBytesArray(JNIEnv *env, jobjectArray javaBytesArray, jsize index,
+                                            char **buffer, size_t *bufferCapacity,
+                                            const char **outString) {
+    *outString = NULL;
+    if (!javaBytesArray) {
+        return true;
+    }
+    jbyteArray javaBytes = (*env)->GetObjectArrayElement(env, javaBytesArray, index);
+    if (!javaBytes) {
+        return true;
+    }
+    *outString = getStringFromBytes(env, javaBytes, buffer, bufferCapacity);
+    (*env)->DeleteLocalRef(env, javaBytes);
+    return *outString != NULL;
+}
+
+static char **mallocStringsFromBytesArray(JNIEnv *env, jobjectArray javaBytesArray,
+                                          size_t *outLength) {
+    jsize javaLength = (*env)->GetArrayLength(env, javaBytesArray);
+    size_t length = (size_t) javaLength;
+    char **strings = malloc((length ? length : 1) * sizeof(*strings));
+    for (jsize i = 0; i < javaLength; ++i) {
+        jbyteArray javaBytes = (*env)->GetObjectArrayElement(env, javaBytesArray, i);
+        strings[i] = mallocStringFromBytes(env, javaBytes);
+        (*env)->DeleteLocalRef(env, javaBytes);
+    }
+    *outLength = length;
+    return strings;
+}
+
+static void freeStrings(char **strings, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        free(strings[i]);
+    }
+    free(strings);
+}
+
+static struct selinux_opt *mallocSelinuxOpts(JNIEnv *env, jobjectArray javaOptions,
+                                             unsigned int *outOptionCount) {
+    jsize javaOptionCount = javaOptions ? (*env)->GetArrayLength(env, javaOptions) : 0;
+    unsigned int optionCount = (unsigned int) javaOptionCount;
+    struct selinux_opt *options = calloc(optionCount ? optionCount : 1, sizeof(*options));
+    for (jsize i = 0; i < javaOptionCount; ++i) {
+        jobject javaOption = (*env)->GetObjectArrayElement(env, javaOptions, i);
+        options[i].type = (*env)->GetIntField(env, javaOption, getSelinuxOptTypeField(env));
+        jbyteArray javaValue = (*env)->GetObjectField(env, javaOption,
+                                                      getSelinuxOptValueField(env));
+        options[i].value = javaValue ? mallocStringFromBytes(env, javaValue) : NULL;
+        (*env)->DeleteLocalRef(env, javaValue);
+        (*env)->DeleteLocalRef(env, javaOption);
+    }
+    *outOptionCount = optionCount;
+    return options;
+}
+
+// Label handles that validate their contexts go through the validation cache.
+static struct selinux_opt *mallocSelabelOpts(JNIEnv *env, jobjectArray javaOptions,
+                                             unsigned int *outOptionCount) {
+    struct selinux_opt *options = mallocSelinuxOpts(env, javaOptions, outOptionCount);
+    for (unsigned int i = 0; i < *outOptionCount; ++i) {
+        if (options[i].type == SELABEL_OPT_VALIDATE && options[i].value) {
+            selinux_validate_cache_enable();
+            break;
+        }
+    }
+    return options;
+}
+
+static void freeSelinuxOpts(struct selinux_opt *options, unsigned int optionCount) {
+    for (unsigned int i = 0; i < optionCount; ++i) {
+        free((char *) options[i].value);
+    }
+    free(options);
+}
+
+static jlongArray newLongsFromSelabelFootprint(JNIEnv *env,
+                                               const struct selabel_footprint *footprint) {
+    jlong footprintLongs[] = {
+            (jlong) footprint->specs,
+            (jlong) footprint->strings,
+            (jlong) footprint->pooled_strings,
+            (jlong) footprint->regexes,
+            (jlong) footprint->jit,
+            (jlong) footprint->mapped
+    };
+    jsize javaLength = sizeof(footprintLongs) / sizeof(*footprintLongs);
+    jlongArray javaFootprint = (*env)->NewLongArray(env, javaLength);
+    if (!javaFootprint) {
+        return NULL;
+    }
+    (*env)->SetLongArrayRegion(env, javaFootprint, 0, javaLength, footprintLongs);
+    return javaFootprint;
+}
+
 static jbyteArray newBytesFromString(JNIEnv *env, const char *string) {
     size_t length = strlen(string);
     jsize javaLength = (jsize) length;
@@ -152,6 +321,373 @@ static jbyteArray newBytesFromString(JNIEnv *env, const char *string) {
     return javaBytes;
 }
 
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1cache_1stats(JNIEnv *env, jclass clazz) {
+    struct avc_query_cache_stats stats;
+    avc_query_get_cache_stats(&stats);
+    jlong statsLongs[] = {
+            (jlong) stats.lookups,
+            (jlong) stats.hits,
+            (jlong) stats.misses,
+            (jlong) stats.evictions,
+            (jlong) stats.probes,
+            (jlong) stats.capacity,
+            (jlong) stats.sid_table.count,
+            (jlong) stats.sid_table.capacity,
+            (jlong) stats.sid_table.probe_histogram[0],
+            (jlong) stats.sid_table.probe_histogram[1],
+            (jlong) stats.sid_table.probe_histogram[2],
+            (jlong) stats.sid_table.probe_histogram[3],
+            (jlong) stats.sid_table.probe_histogram[4],
+            (jlong) stats.sid_table.probe_histogram[5],
+            (jlong) stats.sid_table.probe_histogram[6],
+            (jlong) stats.sid_table.probe_histogram[7]
+    };
+    jsize javaLength = sizeof(statsLongs) / sizeof(*statsLongs);
+    jlongArray javaStats = (*env)->NewLongArray(env, javaLength);
+    if (!javaStats) {
+        return NULL;
+    }
+    (*env)->SetLongArrayRegion(env, javaStats, 0, javaLength, statsLongs);
+    return javaStats;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1compute_1create_1batch(
+        JNIEnv *env, jclass clazz, jlongArray javaSourceSids, jlongArray javaTargetSids,
+        jintArray javaTargetClasses) {
+    jsize javaCount = (*env)->GetArrayLength(env, javaSourceSids);
+    if ((*env)->GetArrayLength(env, javaTargetSids) != javaCount
+            || (*env)->GetArrayLength(env, javaTargetClasses) != javaCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "security_compute_create");
+        return NULL;
+    }
+    size_t count = (size_t) javaCount;
+    security_id_t *sourceSids = malloc((count ? count : 1) * sizeof(*sourceSids));
+    security_id_t *targetSids = malloc((count ? count : 1) * sizeof(*targetSids));
+    security_class_t *targetClasses = malloc((count ? count : 1) * sizeof(*targetClasses));
+    security_id_t *newSids = malloc((count ? count : 1) * sizeof(*newSids));
+    jlong *newSidLongs = malloc((count ? count : 1) * sizeof(*newSidLongs));
+    jlongArray javaNewSids = NULL;
+    if (!sourceSids || !targetSids || !targetClasses || !newSids || !newSidLongs) {
+        errno = ENOMEM;
+        throwErrnoException(env, "security_compute_create");
+        goto finish;
+    }
+    jlong *javaSourceSidsElements = (*env)->GetLongArrayElements(env, javaSourceSids, NULL);
+    jlong *javaTargetSidsElements = (*env)->GetLongArrayElements(env, javaTargetSids, NULL);
+    jint *javaTargetClassesElements = (*env)->GetIntArrayElements(env, javaTargetClasses, NULL);
+    for (size_t i = 0; i < count; ++i) {
+        sourceSids[i] = (security_id_t) (intptr_t) javaSourceSidsElements[i];
+        targetSids[i] = (security_id_t) (intptr_t) javaTargetSidsElements[i];
+        targetClasses[i] = (security_class_t) javaTargetClassesElements[i];
+    }
+    (*env)->ReleaseIntArrayElements(env, javaTargetClasses, javaTargetClassesElements, JNI_ABORT);
+    (*env)->ReleaseLongArrayElements(env, javaTargetSids, javaTargetSidsElements, JNI_ABORT);
+    (*env)->ReleaseLongArrayElements(env, javaSourceSids, javaSourceSidsElements, JNI_ABORT);
+    if (avc_query_compute_create_batch(sourceSids, targetSids, targetClasses, count, newSids)) {
+        throwErrnoException(env, "security_compute_create");
+        goto finish;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        newSidLongs[i] = (jlong) (intptr_t) newSids[i];
+    }
+    javaNewSids = (*env)->NewLongArray(env, javaCount);
+    if (javaNewSids) {
+        (*env)->SetLongArrayRegion(env, javaNewSids, 0, javaCount, newSidLongs);
+    }
+finish:
+    free(newSidLongs);
+    free(newSids);
+    free(targetClasses);
+    free(targetSids);
+    free(sourceSids);
+    return javaNewSids;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1context_1to_1sid(
+        JNIEnv *env, jclass clazz, jbyteArray javaContext) {
+    char *context = mallocStringFromBytes(env, javaContext);
+    security_id_t sid;
+    int result = avc_query_context_to_sid(context, &sid);
+    int savedErrno = errno;
+    free(context);
+    if (result) {
+        errno = savedErrno;
+        throwErrnoException(env, "avc_context_to_sid");
+        return 0;
+    }
+    return (jlong) (intptr_t) sid;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1destroy(JNIEnv *env, jclass clazz) {
+    avc_query_close();
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1has_1perm_1batch(
+        JNIEnv *env, jclass clazz, jlongArray javaSourceSids, jlongArray javaTargetSids,
+        jintArray javaTargetClasses, jintArray javaRequestedPermissions) {
+    jsize javaCount = (*env)->GetArrayLength(env, javaSourceSids);
+    if ((*env)->GetArrayLength(env, javaTargetSids) != javaCount
+            || (*env)->GetArrayLength(env, javaTargetClasses) != javaCount
+            || (*env)->GetArrayLength(env, javaRequestedPermissions) != javaCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "avc_has_perm");
+        return NULL;
+    }
+    size_t count = (size_t) javaCount;
+    size_t decisionCount = (count + 63) / 64;
+    security_id_t *sourceSids = malloc((count ? count : 1) * sizeof(*sourceSids));
+    security_id_t *targetSids = malloc((count ? count : 1) * sizeof(*targetSids));
+    security_class_t *targetClasses = malloc((count ? count : 1) * sizeof(*targetClasses));
+    access_vector_t *requestedPermissions = malloc((count ? count : 1)
+            * sizeof(*requestedPermissions));
+    uint64_t *decisions = malloc((decisionCount ? decisionCount : 1) * sizeof(*decisions));
+    jlongArray javaDecisions = NULL;
+    if (!sourceSids || !targetSids || !targetClasses || !requestedPermissions || !decisions) {
+        errno = ENOMEM;
+        throwErrnoException(env, "avc_has_perm");
+        goto finish;
+    }
+    jlong *javaSourceSidsElements = (*env)->GetLongArrayElements(env, javaSourceSids, NULL);
+    jlong *javaTargetSidsElements = (*env)->GetLongArrayElements(env, javaTargetSids, NULL);
+    jint *javaTargetClassesElements = (*env)->GetIntArrayElements(env, javaTargetClasses, NULL);
+    jint *javaRequestedPermissionsElements = (*env)->GetIntArrayElements(
+            env, javaRequestedPermissions, NULL);
+    bool hasNullSid = false;
+    for (size_t i = 0; i < count; ++i) {
+        sourceSids[i] = (security_id_t) (intptr_t) javaSourceSidsElements[i];
+        targetSids[i] = (security_id_t) (intptr_t) javaTargetSidsElements[i];
+        targetClasses[i] = (security_class_t) javaTargetClassesElements[i];
+        requestedPermissions[i] = (access_vector_t) javaRequestedPermissionsElements[i];
+        if (!sourceSids[i] || !targetSids[i]) {
+            hasNullSid = true;
+        }
+    }
+    (*env)->ReleaseIntArrayElements(env, javaRequestedPermissions,
+                                    javaRequestedPermissionsElements, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, javaTargetClasses, javaTargetClassesElements, JNI_ABORT);
+    (*env)->ReleaseLongArrayElements(env, javaTargetSids, javaTargetSidsElements, JNI_ABORT);
+    (*env)->ReleaseLongArrayElements(env, javaSourceSids, javaSourceSidsElements, JNI_ABORT);
+    if (hasNullSid) {
+        errno = EINVAL;
+        throwErrnoException(env, "avc_has_perm");
+        goto finish;
+    }
+    if (avc_query_has_perm_batch(sourceSids, targetSids, targetClasses, requestedPermissions,
+                                 count, decisions)) {
+        throwErrnoException(env, "avc_has_perm");
+        goto finish;
+    }
+    javaDecisions = (*env)->NewLongArray(env, (jsize) decisionCount);
+    if (javaDecisions) {
+        (*env)->SetLongArrayRegion(env, javaDecisions, 0, (jsize) decisionCount,
+                                   (const jlong *) decisions);
+    }
+finish:
+    free(decisions);
+    free(requestedPermissions);
+    free(targetClasses);
+    free(targetSids);
+    free(sourceSids);
+    return javaDecisions;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1open(
+        JNIEnv *env, jclass clazz, jobjectArray javaOptions) {
+    selinux_lazy_init();
+    unsigned int optionCount;
+    struct selinux_opt *options = mallocSelinuxOpts(env, javaOptions, &optionCount);
+    int result = avc_query_open(options, optionCount);
+    int savedErrno = errno;
+    freeSelinuxOpts(options, optionCount);
+    if (result) {
+        errno = savedErrno;
+        throwErrnoException(env, "avc_open");
+    }
+}
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1prewarm(
+        JNIEnv *env, jclass clazz, jbyteArray javaPath) {
+    selinux_lazy_init();
+    char *path = mallocStringFromBytes(env, javaPath);
+    ssize_t result = avc_query_prewarm(path);
+    int savedErrno = errno;
+    free(path);
+    if (result == -1) {
+        errno = savedErrno;
+        throwErrnoException(env, "avc_prewarm");
+        return 0;
+    }
+    return (jint) result;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1save_1recording(
+        JNIEnv *env, jclass clazz, jbyteArray javaPath) {
+    char *path = mallocStringFromBytes(env, javaPath);
+    int result = avc_query_save_recording(path);
+    int savedErrno = errno;
+    free(path);
+    if (result == -1) {
+        errno = savedErrno;
+        throwErrnoException(env, "avc_save_recording");
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1set_1cache_1threshold(
+        JNIEnv *env, jclass clazz, jint javaThreshold) {
+    if (javaThreshold <= 0) {
+        errno = EINVAL;
+        throwErrnoException(env, "avc_set_cache_threshold");
+        return;
+    }
+    if (avc_query_set_cache_threshold((unsigned int) javaThreshold)) {
+        throwErrnoException(env, "avc_set_cache_threshold");
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1set_1recording(
+        JNIEnv *env, jclass clazz, jboolean javaEnabled) {
+    if (avc_query_set_recording(javaEnabled)) {
+        throwErrnoException(env, "avc_set_recording");
+    }
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_avc_1sid_1to_1context(
+        JNIEnv *env, jclass clazz, jlong javaSid) {
+    security_id_t sid = (security_id_t) (intptr_t) javaSid;
+    if (!sid) {
+        errno = EINVAL;
+        throwErrnoException(env, "avc_sid_to_context");
+        return NULL;
+    }
+    return newBytesFromString(env, sid->ctx);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_class_1map_1class_1to_1string(
+        JNIEnv *env, jclass clazz, jlong javaMap, jint javaClass) {
+    struct class_map *map = (struct class_map *) (intptr_t) javaMap;
+    if (javaClass <= 0 || javaClass > UINT16_MAX) {
+        return NULL;
+    }
+    const char *name = class_map_class_to_string(map, (security_class_t) javaClass);
+    return name ? newBytesFromString(env, name) : NULL;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_class_1map_1close(
+        JNIEnv *env, jclass clazz, jlong javaMap) {
+    struct class_map *map = (struct class_map *) (intptr_t) javaMap;
+    class_map_destroy(map);
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_class_1map_1load(JNIEnv *env, jclass clazz) {
+    struct class_map *map = class_map_load();
+    if (!map) {
+        throwErrnoException(env, "class_map_load");
+        return 0;
+    }
+    return (jlong) (intptr_t) map;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_class_1map_1string_1to_1av_1perm_1batch(
+        JNIEnv *env, jclass clazz, jlong javaMap, jintArray javaClasses, jobjectArray javaNames) {
+    struct class_map *map = (struct class_map *) (intptr_t) javaMap;
+    jsize javaNameCount = (*env)->GetArrayLength(env, javaNames);
+    if ((*env)->GetArrayLength(env, javaClasses) != javaNameCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "string_to_av_perm");
+        return NULL;
+    }
+    size_t nameCount = (size_t) javaNameCount;
+    jint *permissions = malloc((nameCount ? nameCount : 1) * sizeof(*permissions));
+    if (!permissions) {
+        errno = ENOMEM;
+        throwErrnoException(env, "string_to_av_perm");
+        return NULL;
+    }
+    jint *javaClassesElements = (*env)->GetIntArrayElements(env, javaClasses, NULL);
+    char *nameBuffer = NULL;
+    size_t nameBufferCapacity = 0;
+    for (jsize i = 0; i < javaNameCount; ++i) {
+        jbyteArray javaName = (*env)->GetObjectArrayElement(env, javaNames, i);
+        char *name = getStringFromBytes(env, javaName, &nameBuffer, &nameBufferCapacity);
+        (*env)->DeleteLocalRef(env, javaName);
+        if (!name) {
+            (*env)->ReleaseIntArrayElements(env, javaClasses, javaClassesElements, JNI_ABORT);
+            free(nameBuffer);
+            free(permissions);
+            errno = ENOMEM;
+            throwErrnoException(env, "string_to_av_perm");
+            return NULL;
+        }
+        jint javaClass = javaClassesElements[i];
+        if (javaClass > 0 && javaClass <= UINT16_MAX) {
+            permissions[i] = (jint) class_map_string_to_av_perm(map, (security_class_t) javaClass,
+                                                                name);
+        } else {
+            permissions[i] = 0;
+        }
+    }
+    (*env)->ReleaseIntArrayElements(env, javaClasses, javaClassesElements, JNI_ABORT);
+    free(nameBuffer);
+    jintArray javaPermissions = (*env)->NewIntArray(env, javaNameCount);
+    if (javaPermissions) {
+        (*env)->SetIntArrayRegion(env, javaPermissions, 0, javaNameCount, permissions);
+    }
+    free(permissions);
+    return javaPermissions;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_class_1map_1string_1to_1class_1batch(
+        JNIEnv *env, jclass clazz, jlong javaMap, jobjectArray javaNames) {
+    struct class_map *map = (struct class_map *) (intptr_t) javaMap;
+    jsize javaNameCount = (*env)->GetArrayLength(env, javaNames);
+    size_t nameCount = (size_t) javaNameCount;
+    jint *classes = malloc((nameCount ? nameCount : 1) * sizeof(*classes));
+    if (!classes) {
+        errno = ENOMEM;
+        throwErrnoException(env, "string_to_security_class");
+        return NULL;
+    }
+    char *nameBuffer = NULL;
+    size_t nameBufferCapacity = 0;
+    for (jsize i = 0; i < javaNameCount; ++i) {
+        jbyteArray javaName = (*env)->GetObjectArrayElement(env, javaNames, i);
+        char *name = getStringFromBytes(env, javaName, &nameBuffer, &nameBufferCapacity);
+        (*env)->DeleteLocalRef(env, javaName);
+        if (!name) {
+            free(nameBuffer);
+            free(classes);
+            errno = ENOMEM;
+            throwErrnoException(env, "string_to_security_class");
+            return NULL;
+        }
+        classes[i] = class_map_string_to_class(map, name);
+    }
+    free(nameBuffer);
+    jintArray javaClasses = (*env)->NewIntArray(env, javaNameCount);
+    if (javaClasses) {
+        (*env)->SetIntArrayRegion(env, javaClasses, 0, javaNameCount, classes);
+    }
+    free(classes);
+    return javaClasses;
+}
+
 JNIEXPORT jbyteArray JNICALL
 Java_me_zhanghai_android_libselinux_SeLinux_fgetfilecon(
         JNIEnv *env, jclass clazz, jobject javaFd) {
@@ -167,6 +703,89 @@ Java_me_zhanghai_android_libselinux_SeLinux_fgetfilecon(
     return javaContext;
 }
 
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_file_1label_1create_1batch(
+        JNIEnv *env, jclass clazz, jobjectArray javaPaths, jobjectArray javaContexts,
+        jintArray javaModes) {
+    // getfscreatecon_raw() sizes its buffer with selinux_page_size.
+    selinux_lazy_init();
+    jsize javaPathCount = (*env)->GetArrayLength(env, javaPaths);
+    if ((*env)->GetArrayLength(env, javaContexts) != javaPathCount
+            || (*env)->GetArrayLength(env, javaModes) != javaPathCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "file_label_create_batch");
+        return NULL;
+    }
+    size_t count;
+    char **paths = mallocStringsFromBytesArray(env, javaPaths, &count);
+    size_t contextCount;
+    char **contexts = mallocStringsFromBytesArray(env, javaContexts, &contextCount);
+    mode_t *modes = malloc((count ? count : 1) * sizeof(*modes));
+    jint *errors = malloc((count ? count : 1) * sizeof(*errors));
+    jintArray javaErrors = NULL;
+    if (!modes || !errors) {
+        errno = ENOMEM;
+        throwErrnoException(env, "file_label_create_batch");
+        goto finish;
+    }
+    jint *javaModesElements = (*env)->GetIntArrayElements(env, javaModes, NULL);
+    for (size_t i = 0; i < count; ++i) {
+        modes[i] = (mode_t) javaModesElements[i];
+    }
+    (*env)->ReleaseIntArrayElements(env, javaModes, javaModesElements, JNI_ABORT);
+    if (file_label_create_batch((const char *const *) paths, (const char *const *) contexts,
+                                modes, count, errors)) {
+        throwErrnoException(env, "file_label_create_batch");
+        goto finish;
+    }
+    jsize javaCount = (jsize) count;
+    javaErrors = (*env)->NewIntArray(env, javaCount);
+    if (javaErrors) {
+        (*env)->SetIntArrayRegion(env, javaErrors, 0, javaCount, errors);
+    }
+finish:
+    free(errors);
+    free(modes);
+    freeStrings(contexts, contextCount);
+    freeStrings(paths, count);
+    return javaErrors;
+}
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_file_1label_1set_1batch(
+        JNIEnv *env, jclass clazz, jobjectArray javaPaths, jobjectArray javaContexts,
+        jintArray javaErrors) {
+    jsize javaPathCount = (*env)->GetArrayLength(env, javaPaths);
+    if ((*env)->GetArrayLength(env, javaContexts) != javaPathCount
+            || (*env)->GetArrayLength(env, javaErrors) != javaPathCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "file_label_set_batch");
+        return 0;
+    }
+    size_t count;
+    char **paths = mallocStringsFromBytesArray(env, javaPaths, &count);
+    size_t contextCount;
+    char **contexts = mallocStringsFromBytesArray(env, javaContexts, &contextCount);
+    jint *errors = malloc((count ? count : 1) * sizeof(*errors));
+    size_t skippedCount = 0;
+    if (!errors) {
+        errno = ENOMEM;
+        throwErrnoException(env, "file_label_set_batch");
+        goto finish;
+    }
+    if (file_label_set_batch((const char *const *) paths, (const char *const *) contexts, count,
+                             errors, &skippedCount)) {
+        throwErrnoException(env, "file_label_set_batch");
+        goto finish;
+    }
+    (*env)->SetIntArrayRegion(env, javaErrors, 0, (jsize) count, errors);
+finish:
+    free(errors);
+    freeStrings(contexts, contextCount);
+    freeStrings(paths, count);
+    return (jint) skippedCount;
+}
+
 JNIEXPORT void JNICALL
 Java_me_zhanghai_android_libselinux_SeLinux_fsetfilecon(
         JNIEnv *env, jclass clazz, jobject javaFd, jbyteArray javaContext) {
@@ -199,9 +818,25 @@ Java_me_zhanghai_android_libselinux_SeLinux_getfilecon(
     return doGetfilecon(env, javaPath, false);
 }
 
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_getpeercon(
+        JNIEnv *env, jclass clazz, jint javaFd) {
+    int fd = javaFd;
+    security_context_t context = NULL;
+    TEMP_FAILURE_RETRY(getpeercon(fd, &context));
+    if (errno) {
+        throwErrnoException(env, "getpeercon");
+        return NULL;
+    }
+    jbyteArray javaContext = newBytesFromString(env, context);
+    freecon(context);
+    return javaContext;
+}
+
 JNIEXPORT jboolean JNICALL
 Java_me_zhanghai_android_libselinux_SeLinux_is_1selinux_1enabled(
         JNIEnv *env, jclass clazz) {
+    selinux_lazy_init();
     int enabled = is_selinux_enabled();
     jboolean javaEnabled = (jboolean) (enabled ? JNI_TRUE : JNI_FALSE);
     return javaEnabled;
@@ -231,9 +866,479 @@ Java_me_zhanghai_android_libselinux_SeLinux_lsetfilecon(
     doSetfilecon(env, javaPath, javaContext, true);
 }
 
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_mls_1levels_1add_1batch(
+        JNIEnv *env, jclass clazz, jlong javaLevels, jobjectArray javaStrings,
+        jboolean javaAreContexts) {
+    struct mls_levels *levels = (struct mls_levels *) (intptr_t) javaLevels;
+    bool areContexts = javaAreContexts;
+    jsize javaStringCount = (*env)->GetArrayLength(env, javaStrings);
+    size_t stringCount = (size_t) javaStringCount;
+    jint *indices = malloc((stringCount ? stringCount : 1) * sizeof(*indices));
+    if (!indices) {
+        errno = ENOMEM;
+        throwErrnoException(env, "mls_levels_add");
+        return NULL;
+    }
+    char *stringBuffer = NULL;
+    size_t stringBufferCapacity = 0;
+    for (jsize i = 0; i < javaStringCount; ++i) {
+        jbyteArray javaString = (*env)->GetObjectArrayElement(env, javaStrings, i);
+        char *string = getStringFromBytes(env, javaString, &stringBuffer, &stringBufferCapacity);
+        (*env)->DeleteLocalRef(env, javaString);
+        if (!string) {
+            free(stringBuffer);
+            free(indices);
+            errno = ENOMEM;
+            throwErrnoException(env, "mls_levels_add");
+            return NULL;
+        }
+        const char *range = areContexts ? mls_levels_get_context_range(string) : string;
+        ssize_t index = range ? mls_levels_add(levels, range, strlen(range)) : -1;
+        if (index == -1 && range && errno != EINVAL) {
+            free(stringBuffer);
+            free(indices);
+            throwErrnoException(env, "mls_levels_add");
+            return NULL;
+        }
+        indices[i] = (jint) index;
+    }
+    free(stringBuffer);
+    jintArray javaIndices = (*env)->NewIntArray(env, javaStringCount);
+    if (javaIndices) {
+        (*env)->SetIntArrayRegion(env, javaIndices, 0, javaStringCount, indices);
+    }
+    free(indices);
+    return javaIndices;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_mls_1levels_1close(
+        JNIEnv *env, jclass clazz, jlong javaLevels) {
+    struct mls_levels *levels = (struct mls_levels *) (intptr_t) javaLevels;
+    mls_levels_destroy(levels);
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_mls_1levels_1compare_1batch(
+        JNIEnv *env, jclass clazz, jlong javaLevels, jint javaOp, jintArray javaIndices1,
+        jintArray javaIndices2) {
+    struct mls_levels *levels = (struct mls_levels *) (intptr_t) javaLevels;
+    jsize javaCount = (*env)->GetArrayLength(env, javaIndices1);
+    if ((*env)->GetArrayLength(env, javaIndices2) != javaCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "mls_levels_compare");
+        return NULL;
+    }
+    size_t count = (size_t) javaCount;
+    size_t resultCount = (count + 63) / 64;
+    uint64_t *results = malloc((resultCount ? resultCount : 1) * sizeof(*results));
+    if (!results) {
+        errno = ENOMEM;
+        throwErrnoException(env, "mls_levels_compare");
+        return NULL;
+    }
+    jint *javaIndices1Elements = (*env)->GetIntArrayElements(env, javaIndices1, NULL);
+    jint *javaIndices2Elements = (*env)->GetIntArrayElements(env, javaIndices2, NULL);
+    // Negative indices become too large and are rejected.
+    int result = mls_levels_compare_batch(levels, (enum mls_levels_op) javaOp,
+                                          (const uint32_t *) javaIndices1Elements,
+                                          (const uint32_t *) javaIndices2Elements, count,
+                                          results);
+    int savedErrno = errno;
+    (*env)->ReleaseIntArrayElements(env, javaIndices2, javaIndices2Elements, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, javaIndices1, javaIndices1Elements, JNI_ABORT);
+    jlongArray javaResults = NULL;
+    if (result == -1) {
+        errno = savedErrno;
+        throwErrnoException(env, "mls_levels_compare");
+    } else {
+        javaResults = (*env)->NewLongArray(env, (jsize) resultCount);
+        if (javaResults) {
+            (*env)->SetLongArrayRegion(env, javaResults, 0, (jsize) resultCount,
+                                       (const jlong *) results);
+        }
+    }
+    free(results);
+    return javaResults;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_mls_1levels_1create(JNIEnv *env, jclass clazz) {
+    struct mls_levels *levels = mls_levels_create();
+    if (!levels) {
+        throwErrnoException(env, "mls_levels_create");
+        return 0;
+    }
+    return (jlong) (intptr_t) levels;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_peer_1contexts_1close(
+        JNIEnv *env, jclass clazz, jlong javaContexts) {
+    struct peer_contexts *contexts = (struct peer_contexts *) (intptr_t) javaContexts;
+    peer_contexts_destroy(contexts);
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_peer_1contexts_1create(JNIEnv *env, jclass clazz) {
+    struct peer_contexts *contexts = peer_contexts_create();
+    if (!contexts) {
+        throwErrnoException(env, "peer_contexts_create");
+        return 0;
+    }
+    return (jlong) (intptr_t) contexts;
+}
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_peer_1contexts_1get(
+        JNIEnv *env, jclass clazz, jlong javaContexts, jint javaFd) {
+    struct peer_contexts *contexts = (struct peer_contexts *) (intptr_t) javaContexts;
+    int fd = javaFd;
+    ssize_t index = peer_contexts_get(contexts, fd);
+    if (index == -1) {
+        throwErrnoException(env, "getpeercon");
+        return -1;
+    }
+    return (jint) index;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_peer_1contexts_1get_1context(
+        JNIEnv *env, jclass clazz, jlong javaContexts, jint javaIndex) {
+    struct peer_contexts *contexts = (struct peer_contexts *) (intptr_t) javaContexts;
+    if (javaIndex < 0) {
+        return NULL;
+    }
+    const char *context = peer_contexts_get_context(contexts, (uint32_t) javaIndex);
+    return context ? newBytesFromString(env, context) : NULL;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_proc_1scan_1close(
+        JNIEnv *env, jclass clazz, jlong javaScan) {
+    struct proc_scan *scan = (struct proc_scan *) (intptr_t) javaScan;
+    proc_scan_destroy(scan);
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_proc_1scan_1create(JNIEnv *env, jclass clazz) {
+    struct proc_scan *scan = proc_scan_create();
+    if (!scan) {
+        throwErrnoException(env, "proc_scan_create");
+        return 0;
+    }
+    return (jlong) (intptr_t) scan;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_proc_1scan_1get_1context(
+        JNIEnv *env, jclass clazz, jlong javaScan, jint javaContext) {
+    struct proc_scan *scan = (struct proc_scan *) (intptr_t) javaScan;
+    if (javaContext < 0) {
+        return NULL;
+    }
+    const char *context = proc_scan_get_context(scan, (uint32_t) javaContext);
+    return context ? newBytesFromString(env, context) : NULL;
+}
+
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_proc_1scan_1run(
+        JNIEnv *env, jclass clazz, jlong javaScan, jboolean javaIncludeThreads) {
+    struct proc_scan *scan = (struct proc_scan *) (intptr_t) javaScan;
+    bool includeThreads = javaIncludeThreads;
+    const struct proc_scan_entry *entries;
+    ssize_t count = proc_scan_run(scan, includeThreads, &entries);
+    if (count == -1) {
+        throwErrnoException(env, "proc_scan_run");
+        return NULL;
+    }
+    // Packed as (pid, tid, context) so that a single array crosses JNI.
+    jint *elements = malloc((count ? (size_t) count : 1) * 3 * sizeof(*elements));
+    if (!elements) {
+        errno = ENOMEM;
+        throwErrnoException(env, "proc_scan_run");
+        return NULL;
+    }
+    for (ssize_t i = 0; i < count; ++i) {
+        elements[3 * i] = entries[i].pid;
+        elements[3 * i + 1] = entries[i].tid;
+        elements[3 * i + 2] = (jint) entries[i].context;
+    }
+    jsize javaElementCount = (jsize) (3 * count);
+    jintArray javaEntries = (*env)->NewIntArray(env, javaElementCount);
+    if (javaEntries) {
+        (*env)->SetIntArrayRegion(env, javaEntries, 0, javaElementCount, elements);
+    }
+    free(elements);
+    return javaEntries;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1build(
+        JNIEnv *env, jclass clazz, jobjectArray javaSpecFiles) {
+    size_t specFileCount;
+    char **specFiles = mallocStringsFromBytesArray(env, javaSpecFiles, &specFileCount);
+    errno = 0;
+    struct property_trie *trie = property_trie_build((const char *const *) specFiles,
+                                                     specFileCount);
+    int savedErrno = errno;
+    freeStrings(specFiles, specFileCount);
+    if (!trie) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "property_trie_build");
+        return 0;
+    }
+    return (jlong) (intptr_t) trie;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1close(
+        JNIEnv *env, jclass clazz, jlong javaTrie) {
+    struct property_trie *trie = (struct property_trie *) (intptr_t) javaTrie;
+    property_trie_destroy(trie);
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1get_1contexts(
+        JNIEnv *env, jclass clazz, jlong javaTrie) {
+    struct property_trie *trie = (struct property_trie *) (intptr_t) javaTrie;
+    uint32_t contextCount = property_trie_get_context_count(trie);
+    jobjectArray javaContexts = (*env)->NewObjectArray(env, (jsize) contextCount,
+                                                       getByteArrayClass(env), NULL);
+    if (!javaContexts) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < contextCount; ++i) {
+        jbyteArray javaContext = newBytesFromString(env, property_trie_get_context(trie, i));
+        if (!javaContext) {
+            return NULL;
+        }
+        (*env)->SetObjectArrayElement(env, javaContexts, (jsize) i, javaContext);
+        (*env)->DeleteLocalRef(env, javaContext);
+    }
+    return javaContexts;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1load(
+        JNIEnv *env, jclass clazz, jbyteArray javaPath) {
+    char *path = mallocStringFromBytes(env, javaPath);
+    struct property_trie *trie = property_trie_load(path);
+    int savedErrno = errno;
+    free(path);
+    if (!trie) {
+        errno = savedErrno;
+        throwErrnoException(env, "property_trie_load");
+        return 0;
+    }
+    return (jlong) (intptr_t) trie;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaTrie, jbyteArray javaName) {
+    struct property_trie *trie = (struct property_trie *) (intptr_t) javaTrie;
+    char *name = mallocStringFromBytes(env, javaName);
+    uint32_t contextIndex = property_trie_lookup(trie, name);
+    free(name);
+    if (contextIndex == PROPERTY_TRIE_NO_CONTEXT) {
+        throwErrnoException(env, "selabel_lookup");
+        return NULL;
+    }
+    return newBytesFromString(env, property_trie_get_context(trie, contextIndex));
+}
+
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1lookup_1batch(
+        JNIEnv *env, jclass clazz, jlong javaTrie, jobjectArray javaNames) {
+    struct property_trie *trie = (struct property_trie *) (intptr_t) javaTrie;
+    jsize javaNameCount = (*env)->GetArrayLength(env, javaNames);
+    size_t nameCount = (size_t) javaNameCount;
+    jint *contextIndices = malloc((nameCount ? nameCount : 1) * sizeof(*contextIndices));
+    if (!contextIndices) {
+        errno = ENOMEM;
+        throwErrnoException(env, "property_trie_lookup");
+        return NULL;
+    }
+    char *nameBuffer = NULL;
+    size_t nameBufferCapacity = 0;
+    for (jsize i = 0; i < javaNameCount; ++i) {
+        jbyteArray javaName = (*env)->GetObjectArrayElement(env, javaNames, i);
+        char *name = getStringFromBytes(env, javaName, &nameBuffer, &nameBufferCapacity);
+        (*env)->DeleteLocalRef(env, javaName);
+        if (!name) {
+            free(nameBuffer);
+            free(contextIndices);
+            errno = ENOMEM;
+            throwErrnoException(env, "property_trie_lookup");
+            return NULL;
+        }
+        uint32_t contextIndex = property_trie_lookup(trie, name);
+        contextIndices[i] = contextIndex == PROPERTY_TRIE_NO_CONTEXT ? -1 : (jint) contextIndex;
+    }
+    free(nameBuffer);
+    jintArray javaContextIndices = (*env)->NewIntArray(env, javaNameCount);
+    if (javaContextIndices) {
+        (*env)->SetIntArrayRegion(env, javaContextIndices, 0, javaNameCount, contextIndices);
+    }
+    free(contextIndices);
+    return javaContextIndices;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_property_1trie_1save(
+        JNIEnv *env, jclass clazz, jlong javaTrie, jbyteArray javaPath) {
+    struct property_trie *trie = (struct property_trie *) (intptr_t) javaTrie;
+    char *path = mallocStringFromBytes(env, javaPath);
+    int result = property_trie_save(trie, path);
+    int savedErrno = errno;
+    free(path);
+    if (result == -1) {
+        errno = savedErrno;
+        throwErrnoException(env, "property_trie_save");
+    }
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_seapp_1contexts_1build(
+        JNIEnv *env, jclass clazz, jobjectArray javaSpecFiles) {
+    size_t specFileCount;
+    char **specFiles = mallocStringsFromBytesArray(env, javaSpecFiles, &specFileCount);
+    errno = 0;
+    struct seapp_contexts *contexts = seapp_contexts_build((const char *const *) specFiles,
+                                                           specFileCount);
+    int savedErrno = errno;
+    freeStrings(specFiles, specFileCount);
+    if (!contexts) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "seapp_contexts_build");
+        return 0;
+    }
+    return (jlong) (intptr_t) contexts;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_seapp_1contexts_1close(
+        JNIEnv *env, jclass clazz, jlong javaContexts) {
+    struct seapp_contexts *contexts = (struct seapp_contexts *) (intptr_t) javaContexts;
+    seapp_contexts_destroy(contexts);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_seapp_1contexts_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaContexts, jint javaKind, jbyteArray javaUser,
+        jbyteArray javaSeinfo, jbyteArray javaName, jint javaFlags, jint javaTargetSdkVersion,
+        jint javaUid) {
+    if (javaKind != SEAPP_KIND_DOMAIN && javaKind != SEAPP_KIND_TYPE) {
+        errno = EINVAL;
+        throwErrnoException(env, "seapp_contexts_lookup");
+        return NULL;
+    }
+    struct seapp_contexts *contexts = (struct seapp_contexts *) (intptr_t) javaContexts;
+    enum seapp_kind kind = (enum seapp_kind) javaKind;
+    char *user = javaUser ? mallocStringFromBytes(env, javaUser) : NULL;
+    char *seinfo = javaSeinfo ? mallocStringFromBytes(env, javaSeinfo) : NULL;
+    char *name = javaName ? mallocStringFromBytes(env, javaName) : NULL;
+    struct seapp_query query = {
+            .user = user,
+            .seinfo = seinfo,
+            .name = name,
+            .flags = (unsigned int) javaFlags,
+            .targetSdkVersion = javaTargetSdkVersion,
+            .uid = (uid_t) javaUid,
+    };
+    char *context = seapp_contexts_lookup(contexts, kind, &query);
+    int savedErrno = errno;
+    free(name);
+    free(seinfo);
+    free(user);
+    if (!context) {
+        errno = savedErrno;
+        throwErrnoException(env, "seapp_contexts_lookup");
+        return NULL;
+    }
+    jbyteArray javaContext = newBytesFromString(env, context);
+    free(context);
+    return javaContext;
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_seapp_1contexts_1lookup_1batch(
+        JNIEnv *env, jclass clazz, jlong javaContexts, jint javaKind, jobjectArray javaUsers,
+        jobjectArray javaSeinfos, jobjectArray javaNames, jintArray javaFlags,
+        jintArray javaTargetSdkVersions, jintArray javaUids) {
+    jsize javaQueryCount = (*env)->GetArrayLength(env, javaUids);
+    if ((javaKind != SEAPP_KIND_DOMAIN && javaKind != SEAPP_KIND_TYPE)
+            || (javaUsers && (*env)->GetArrayLength(env, javaUsers) != javaQueryCount)
+            || (javaSeinfos && (*env)->GetArrayLength(env, javaSeinfos) != javaQueryCount)
+            || (javaNames && (*env)->GetArrayLength(env, javaNames) != javaQueryCount)
+            || (*env)->GetArrayLength(env, javaFlags) != javaQueryCount
+            || (*env)->GetArrayLength(env, javaTargetSdkVersions) != javaQueryCount) {
+        errno = EINVAL;
+        throwErrnoException(env, "seapp_contexts_lookup");
+        return NULL;
+    }
+    struct seapp_contexts *contexts = (struct seapp_contexts *) (intptr_t) javaContexts;
+    enum seapp_kind kind = (enum seapp_kind) javaKind;
+    jobjectArray javaResults = (*env)->NewObjectArray(env, javaQueryCount,
+                                                      getByteArrayClass(env), NULL);
+    if (!javaResults) {
+        return NULL;
+    }
+    jint *flags = (*env)->GetIntArrayElements(env, javaFlags, NULL);
+    jint *targetSdkVersions = (*env)->GetIntArrayElements(env, javaTargetSdkVersions, NULL);
+    jint *uids = (*env)->GetIntArrayElements(env, javaUids, NULL);
+    char *buffers[3] = {};
+    size_t bufferCapacities[3] = {};
+    for (jsize i = 0; i < javaQueryCount; ++i) {
+        struct seapp_query query = {
+                .flags = (unsigned int) flags[i],
+                .targetSdkVersion = targetSdkVersions[i],
+                .uid = (uid_t) uids[i],
+        };
+        if (!getOptionalStringFromBytesArray(env, javaUsers, i, &buffers[0],
+                                             &bufferCapacities[0], &query.user)
+                || !getOptionalStringFromBytesArray(env, javaSeinfos, i, &buffers[1],
+                                                    &bufferCapacities[1], &query.seinfo)
+                || !getOptionalStringFromBytesArray(env, javaNames, i, &buffers[2],
+                                                    &bufferCapacities[2], &query.name)) {
+            errno = ENOMEM;
+            throwErrnoException(env, "seapp_contexts_lookup");
+            javaResults = NULL;
+            break;
+        }
+        char *context = seapp_contexts_lookup(contexts, kind, &query);
+        if (!context) {
+            if (errno == ENOENT) {
+                continue;
+            }
+            throwErrnoException(env, "seapp_contexts_lookup");
+            javaResults = NULL;
+            break;
+        }
+        jbyteArray javaContext = newBytesFromString(env, context);
+        free(context);
+        if (!javaContext) {
+            javaResults = NULL;
+            break;
+        }
+        (*env)->SetObjectArrayElement(env, javaResults, i, javaContext);
+        (*env)->DeleteLocalRef(env, javaContext);
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        free(buffers[i]);
+    }
+    (*env)->ReleaseIntArrayElements(env, javaUids, uids, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, javaTargetSdkVersions, targetSdkVersions, JNI_ABORT);
+    (*env)->ReleaseIntArrayElements(env, javaFlags, flags, JNI_ABORT);
+    return javaResults;
+}
+
 JNIEXPORT jboolean JNICALL
 Java_me_zhanghai_android_libselinux_SeLinux_security_1getenforce(
         JNIEnv *env, jclass clazz) {
+    selinux_lazy_init();
     int enforce = TEMP_FAILURE_RETRY(security_getenforce());
     if (enforce == -1 && !errno) {
         // The only case is sscanf() returning EOF in security_getenforce(), which we can treat as
@@ -247,8 +1352,432 @@ Java_me_zhanghai_android_libselinux_SeLinux_security_1getenforce(
     return javaEnforce;
 }
 
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1close(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_handle *handle = (struct selabel_handle *) (intptr_t) javaHandle;
+    selabel_close_pooled(handle);
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1concurrent_1close(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_concurrent *handle = (struct selabel_concurrent *) (intptr_t) javaHandle;
+    selabel_concurrent_destroy(handle);
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1concurrent_1get_1footprint(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_concurrent *handle = (struct selabel_concurrent *) (intptr_t) javaHandle;
+    struct selabel_footprint footprint;
+    if (selabel_concurrent_get_footprint(handle, &footprint) == -1) {
+        throwErrnoException(env, "selabel_get_footprint");
+        return NULL;
+    }
+    return newLongsFromSelabelFootprint(env, &footprint);
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1concurrent_1get_1spec_1stats(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_concurrent *handle = (struct selabel_concurrent *) (intptr_t) javaHandle;
+    size_t specCount = selabel_concurrent_get_spec_stats(handle, NULL);
+    size_t statsLength = specCount * SELABEL_SPEC_STATS_SIZE;
+    uint64_t *stats = malloc((statsLength ? statsLength : 1) * sizeof(*stats));
+    selabel_concurrent_get_spec_stats(handle, stats);
+    jsize javaStatsLength = (jsize) statsLength;
+    jlongArray javaStats = (*env)->NewLongArray(env, javaStatsLength);
+    if (javaStats) {
+        const jlong *statsLongs = (const jlong *) stats;
+        (*env)->SetLongArrayRegion(env, javaStats, 0, javaStatsLength, statsLongs);
+    }
+    free(stats);
+    return javaStats;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1concurrent_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaHandle, jbyteArray javaKey, jint javaType) {
+    selinux_lazy_init();
+    struct selabel_concurrent *handle = (struct selabel_concurrent *) (intptr_t) javaHandle;
+    char *key = mallocStringFromBytes(env, javaKey);
+    int type = javaType;
+    security_context_t context = NULL;
+    int result = selabel_concurrent_lookup(handle, &context, key, type);
+    free(key);
+    if (result == -1) {
+        throwErrnoException(env, "selabel_lookup");
+        return NULL;
+    }
+    jbyteArray javaContext = newBytesFromString(env, context);
+    freecon(context);
+    return javaContext;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1concurrent_1open(
+        JNIEnv *env, jclass clazz, jint javaBackend, jobjectArray javaOptions,
+        jboolean javaInstrumented) {
+    selinux_lazy_init();
+    unsigned int backend = (unsigned int) javaBackend;
+    unsigned int optionCount;
+    struct selinux_opt *options = mallocSelabelOpts(env, javaOptions, &optionCount);
+    errno = 0;
+    struct selabel_handle *handle = selabel_open_pooled(backend, options, optionCount);
+    int savedErrno = errno;
+    freeSelinuxOpts(options, optionCount);
+    if (!handle) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "selabel_open");
+        return 0;
+    }
+    bool instrumented = javaInstrumented;
+    struct selabel_concurrent *concurrent = selabel_concurrent_create(handle, instrumented);
+    if (!concurrent) {
+        selabel_close_pooled(handle);
+        errno = ENOMEM;
+        throwErrnoException(env, "selabel_concurrent_create");
+        return 0;
+    }
+    return (jlong) (intptr_t) concurrent;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1get_1footprint(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_handle *handle = (struct selabel_handle *) (intptr_t) javaHandle;
+    struct selabel_footprint footprint;
+    if (selabel_get_footprint(handle, &footprint) == -1) {
+        throwErrnoException(env, "selabel_get_footprint");
+        return NULL;
+    }
+    return newLongsFromSelabelFootprint(env, &footprint);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaHandle, jbyteArray javaKey, jint javaType) {
+    selinux_lazy_init();
+    struct selabel_handle *handle = (struct selabel_handle *) (intptr_t) javaHandle;
+    char *key = mallocStringFromBytes(env, javaKey);
+    int type = javaType;
+    security_context_t context = NULL;
+    int result = selabel_lookup(handle, &context, key, type);
+    free(key);
+    if (result == -1) {
+        throwErrnoException(env, "selabel_lookup");
+        return NULL;
+    }
+    jbyteArray javaContext = newBytesFromString(env, context);
+    freecon(context);
+    return javaContext;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1open(
+        JNIEnv *env, jclass clazz, jint javaBackend, jobjectArray javaOptions) {
+    selinux_lazy_init();
+    unsigned int backend = (unsigned int) javaBackend;
+    unsigned int optionCount;
+    struct selinux_opt *options = mallocSelabelOpts(env, javaOptions, &optionCount);
+    errno = 0;
+    struct selabel_handle *handle = selabel_open_pooled(backend, options, optionCount);
+    int savedErrno = errno;
+    freeSelinuxOpts(options, optionCount);
+    if (!handle) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "selabel_open");
+        return 0;
+    }
+    return (jlong) (intptr_t) handle;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1reloadable_1close(
+        JNIEnv *env, jclass clazz, jlong javaHandle) {
+    struct selabel_reloadable *handle = (struct selabel_reloadable *) (intptr_t) javaHandle;
+    selabel_reloadable_close(handle);
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1reloadable_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaHandle, jbyteArray javaKey, jint javaType) {
+    selinux_lazy_init();
+    struct selabel_reloadable *handle = (struct selabel_reloadable *) (intptr_t) javaHandle;
+    char *key = mallocStringFromBytes(env, javaKey);
+    int type = javaType;
+    security_context_t context = NULL;
+    int result = selabel_reloadable_lookup(handle, &context, key, type);
+    free(key);
+    if (result == -1) {
+        throwErrnoException(env, "selabel_lookup");
+        return NULL;
+    }
+    jbyteArray javaContext = newBytesFromString(env, context);
+    freecon(context);
+    return javaContext;
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1reloadable_1open(
+        JNIEnv *env, jclass clazz, jint javaBackend, jobjectArray javaOptions) {
+    selinux_lazy_init();
+    unsigned int backend = (unsigned int) javaBackend;
+    unsigned int optionCount;
+    struct selinux_opt *options = mallocSelabelOpts(env, javaOptions, &optionCount);
+    errno = 0;
+    struct selabel_reloadable *handle = selabel_reloadable_open(backend, options, optionCount);
+    int savedErrno = errno;
+    freeSelinuxOpts(options, optionCount);
+    if (!handle) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "selabel_open");
+        return 0;
+    }
+    return (jlong) (intptr_t) handle;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1reloadable_1reload(
+        JNIEnv *env, jclass clazz, jlong javaHandle, jboolean javaForce) {
+    selinux_lazy_init();
+    struct selabel_reloadable *handle = (struct selabel_reloadable *) (intptr_t) javaHandle;
+    bool force = javaForce;
+    errno = 0;
+    int result = selabel_reloadable_reload(handle, force);
+    if (result == -1) {
+        if (!errno) {
+            errno = EINVAL;
+        }
+        throwErrnoException(env, "selabel_open");
+        return JNI_FALSE;
+    }
+    jboolean javaReloaded = (jboolean) (result ? JNI_TRUE : JNI_FALSE);
+    return javaReloaded;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selabel_1reloadable_1reload_1async(
+        JNIEnv *env, jclass clazz, jlong javaHandle, jboolean javaForce) {
+    selinux_lazy_init();
+    struct selabel_reloadable *handle = (struct selabel_reloadable *) (intptr_t) javaHandle;
+    bool force = javaForce;
+    if (selabel_reloadable_reload_async(handle, force) == -1) {
+        throwErrnoException(env, "pthread_create");
+    }
+}
+
+JNIEXPORT jboolean JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selinux_1status_1getenforce(
+        JNIEnv *env, jclass clazz) {
+    struct status_page_state state;
+    if (status_page_read(&state)) {
+        throwErrnoException(env, "status_page_read");
+        return JNI_FALSE;
+    }
+    jboolean javaEnforce = (jboolean) (state.enforcing ? JNI_TRUE : JNI_FALSE);
+    return javaEnforce;
+}
+
+JNIEXPORT jboolean JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selinux_1status_1policy_1changed(
+        JNIEnv *env, jclass clazz, jint javaPolicyload) {
+    uint32_t policyload = (uint32_t) javaPolicyload;
+    bool changed = status_page_policy_changed(&policyload);
+    jboolean javaChanged = (jboolean) (changed ? JNI_TRUE : JNI_FALSE);
+    return javaChanged;
+}
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selinux_1status_1policyload(
+        JNIEnv *env, jclass clazz) {
+    struct status_page_state state;
+    if (status_page_read(&state)) {
+        throwErrnoException(env, "status_page_read");
+        return 0;
+    }
+    jint javaPolicyload = (jint) state.policyload;
+    return javaPolicyload;
+}
+
+JNIEXPORT jlongArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selinux_1validate_1batch(
+        JNIEnv *env, jclass clazz, jobjectArray javaContexts) {
+    size_t contextCount;
+    char **contexts = mallocStringsFromBytesArray(env, javaContexts, &contextCount);
+    size_t resultCount = (contextCount + 63) / 64;
+    uint64_t *results = malloc((resultCount ? resultCount : 1) * sizeof(*results));
+    jlongArray javaResults = NULL;
+    if (!results) {
+        errno = ENOMEM;
+        throwErrnoException(env, "security_check_context");
+        goto finish;
+    }
+    if (selinux_validate_batch((const char *const *) contexts, contextCount, results) == -1) {
+        throwErrnoException(env, "security_check_context");
+        goto finish;
+    }
+    javaResults = (*env)->NewLongArray(env, (jsize) resultCount);
+    if (javaResults) {
+        (*env)->SetLongArrayRegion(env, javaResults, 0, (jsize) resultCount,
+                                   (const jlong *) results);
+    }
+finish:
+    free(results);
+    freeStrings(contexts, contextCount);
+    return javaResults;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_selinux_1validate_1prefetch(
+        JNIEnv *env, jclass clazz, jobjectArray javaSpecFiles, jint javaThreadCount) {
+    selinux_lazy_init();
+    size_t specFileCount;
+    char **specFiles = mallocStringsFromBytesArray(env, javaSpecFiles, &specFileCount);
+    unsigned int threadCount = javaThreadCount > 0 ? (unsigned int) javaThreadCount : 1;
+    int result = selinux_validate_prefetch((const char *const *) specFiles, specFileCount,
+                                           threadCount);
+    int savedErrno = errno;
+    freeStrings(specFiles, specFileCount);
+    if (result == -1) {
+        errno = savedErrno;
+        throwErrnoException(env, "selinux_validate_prefetch");
+    }
+}
+
+JNIEXPORT jlong JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_service_1table_1build(
+        JNIEnv *env, jclass clazz, jobjectArray javaSpecFiles) {
+    size_t specFileCount;
+    char **specFiles = mallocStringsFromBytesArray(env, javaSpecFiles, &specFileCount);
+    errno = 0;
+    struct service_table *table = service_table_build((const char *const *) specFiles,
+                                                      specFileCount);
+    int savedErrno = errno;
+    freeStrings(specFiles, specFileCount);
+    if (!table) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "service_table_build");
+        return 0;
+    }
+    return (jlong) (intptr_t) table;
+}
+
+JNIEXPORT void JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_service_1table_1close(
+        JNIEnv *env, jclass clazz, jlong javaTable) {
+    struct service_table *table = (struct service_table *) (intptr_t) javaTable;
+    service_table_destroy(table);
+}
+
+JNIEXPORT jobjectArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_service_1table_1get_1contexts(
+        JNIEnv *env, jclass clazz, jlong javaTable) {
+    struct service_table *table = (struct service_table *) (intptr_t) javaTable;
+    uint32_t contextCount = service_table_get_context_count(table);
+    jobjectArray javaContexts = (*env)->NewObjectArray(env, (jsize) contextCount,
+                                                       getByteArrayClass(env), NULL);
+    if (!javaContexts) {
+        return NULL;
+    }
+    for (uint32_t i = 0; i < contextCount; ++i) {
+        jbyteArray javaContext = newBytesFromString(env, service_table_get_context(table, i));
+        if (!javaContext) {
+            return NULL;
+        }
+        (*env)->SetObjectArrayElement(env, javaContexts, (jsize) i, javaContext);
+        (*env)->DeleteLocalRef(env, javaContext);
+    }
+    return javaContexts;
+}
+
+JNIEXPORT jbyteArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_service_1table_1lookup(
+        JNIEnv *env, jclass clazz, jlong javaTable, jbyteArray javaName) {
+    struct service_table *table = (struct service_table *) (intptr_t) javaTable;
+    char *name = mallocStringFromBytes(env, javaName);
+    uint32_t contextIndex = service_table_lookup(table, name);
+    free(name);
+    if (contextIndex == SERVICE_TABLE_NO_CONTEXT) {
+        throwErrnoException(env, "selabel_lookup");
+        return NULL;
+    }
+    return newBytesFromString(env, service_table_get_context(table, contextIndex));
+}
+
+JNIEXPORT jintArray JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_service_1table_1lookup_1batch(
+        JNIEnv *env, jclass clazz, jlong javaTable, jobjectArray javaNames) {
+    struct service_table *table = (struct service_table *) (intptr_t) javaTable;
+    jsize javaNameCount = (*env)->GetArrayLength(env, javaNames);
+    size_t nameCount = (size_t) javaNameCount;
+    jint *contextIndices = malloc((nameCount ? nameCount : 1) * sizeof(*contextIndices));
+    if (!contextIndices) {
+        errno = ENOMEM;
+        throwErrnoException(env, "service_table_lookup");
+        return NULL;
+    }
+    char *nameBuffer = NULL;
+    size_t nameBufferCapacity = 0;
+    for (jsize i = 0; i < javaNameCount; ++i) {
+        jbyteArray javaName = (*env)->GetObjectArrayElement(env, javaNames, i);
+        char *name = getStringFromBytes(env, javaName, &nameBuffer, &nameBufferCapacity);
+        (*env)->DeleteLocalRef(env, javaName);
+        if (!name) {
+            free(nameBuffer);
+            free(contextIndices);
+            errno = ENOMEM;
+            throwErrnoException(env, "service_table_lookup");
+            return NULL;
+        }
+        uint32_t contextIndex = service_table_lookup(table, name);
+        contextIndices[i] = contextIndex == SERVICE_TABLE_NO_CONTEXT ? -1 : (jint) contextIndex;
+    }
+    free(nameBuffer);
+    jintArray javaContextIndices = (*env)->NewIntArray(env, javaNameCount);
+    if (javaContextIndices) {
+        (*env)->SetIntArrayRegion(env, javaContextIndices, 0, javaNameCount, contextIndices);
+    }
+    free(contextIndices);
+    return javaContextIndices;
+}
+
 JNIEXPORT void JNICALL
 Java_me_zhanghai_android_libselinux_SeLinux_setfilecon(
         JNIEnv *env, jclass clazz, jbyteArray javaPath, jbyteArray javaContext) {
     doSetfilecon(env, javaPath, javaContext, false);
 }
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_string_1to_1av_1perm(
+        JNIEnv *env, jclass clazz, jint javaTargetClass, jbyteArray javaName) {
+    selinux_lazy_init();
+    security_class_t targetClass = (security_class_t) javaTargetClass;
+    char *name = mallocStringFromBytes(env, javaName);
+    errno = 0;
+    access_vector_t permission = string_to_av_perm(targetClass, name);
+    int savedErrno = errno;
+    free(name);
+    if (!permission) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "string_to_av_perm");
+    }
+    return (jint) permission;
+}
+
+JNIEXPORT jint JNICALL
+Java_me_zhanghai_android_libselinux_SeLinux_string_1to_1security_1class(
+        JNIEnv *env, jclass clazz, jbyteArray javaName) {
+    selinux_lazy_init();
+    char *name = mallocStringFromBytes(env, javaName);
+    errno = 0;
+    security_class_t targetClass = string_to_security_class(name);
+    int savedErrno = errno;
+    free(name);
+    if (!targetClass) {
+        errno = savedErrno ? savedErrno : EINVAL;
+        throwErrnoException(env, "string_to_security_class");
+    }
+    return (jint) targetClass;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Compiled but never linked, so that the build fails when the libselinux submodule changes a
+// private layout that our sources rely on, instead of them reading the wrong memory.
+
+#include "regex.c"
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "label_file.h"
+
+// label_file_memory.c reads the compiled pattern from the start of a struct regex_data.
+_Static_assert(offsetof(struct regex_data, regex) == 0,
+               "struct regex_data no longer starts with its compiled pattern");
+_Static_assert(__builtin_types_compatible_p(__typeof__(((struct regex_data *) NULL)->regex),
+                                            pcre2_code *),
+               "struct regex_data no longer holds a pcre2_code");
+
+// label_file_concurrent.c walks the specs and stems of file_contexts itself, like lookup_common()
+// in label_file.c. That the two agree is checked by label_file_concurrent_bench in src/test/jni.
+_Static_assert((__typeof__(((struct spec *) NULL)->stem_id)) -1 < 0,
+               "struct spec no longer uses -1 for no stem");
+_Static_assert(__builtin_types_compatible_p(__typeof__(((struct spec *) NULL)->mode), mode_t),
+               "struct spec no longer holds the file type as a mode_t");
+_Static_assert(__builtin_types_compatible_p(__typeof__(((struct spec *) NULL)->regex_str),
+                                            char *),
+               "struct spec no longer holds the regex as a string");
+_Static_assert(__builtin_types_compatible_p(__typeof__(((struct stem *) NULL)->buf), char *),
+               "struct stem no longer holds its prefix as a string");
@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "mls_levels.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "string_pool.h"
+
+// A GCC vector extension type, which becomes one NEON or SSE register, so that the loops over a
+// category bitset below are a handful of vector instructions. Only 8-byte aligned, which is all
+// that malloc() guarantees on 32-bit Android.
+typedef uint64_t CategoryVector __attribute__((vector_size(16), aligned(8)));
+
+#define CATEGORY_VECTOR_COUNT (MLS_CATEGORY_COUNT / (8 * sizeof(CategoryVector)))
+
+struct MlsLevel {
+    CategoryVector categories[CATEGORY_VECTOR_COUNT];
+    uint32_t sensitivity;
+};
+
+struct MlsRange {
+    struct MlsLevel low;
+    struct MlsLevel high;
+};
+
+struct mls_levels {
+    // Indices into the pool are indices into ranges.
+    struct string_pool *strings;
+    struct MlsRange *ranges;
+    size_t rangeCapacity;
+};
+
+struct mls_levels *mls_levels_create(void) {
+    struct mls_levels *levels = calloc(1, sizeof(*levels));
+    if (!levels) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    levels->strings = string_pool_create();
+    if (!levels->strings) {
+        free(levels);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return levels;
+}
+
+void mls_levels_destroy(struct mls_levels *levels) {
+    string_pool_destroy(levels->strings);
+    free(levels->ranges);
+    free(levels);
+}
+
+// Parses a decimal number after the prefix character, and advances the string past it.
+static bool parseNumber(const char **string, const char *end, char prefix, uint32_t *outNumber) {
+    const char *stringChar = *string;
+    if (stringChar == end || *stringChar != prefix) {
+        return false;
+    }
+    ++stringChar;
+    if (stringChar == end || *stringChar < '0' || *stringChar > '9') {
+        return false;
+    }
+    uint32_t number = 0;
+    for (; stringChar != end && *stringChar >= '0' && *stringChar <= '9'; ++stringChar) {
+        number = number * 10 + (uint32_t) (*stringChar - '0');
+        if (number >= UINT32_MAX / 10) {
+            return false;
+        }
+    }
+    *string = stringChar;
+    *outNumber = number;
+    return true;
+}
+
+static void setCategories(struct MlsLevel *level, uint32_t first, uint32_t last) {
+    uint64_t *words = (uint64_t *) level->categories;
+    for (uint32_t category = first; category <= last; ++category) {
+        words[category / 64] |= UINT64_C(1) << (category % 64);
+    }
+}
+
+// Parses a level like "s0:c1,c5.c9" that ends at the end of the string or at a '-', and advances
+// the string past it.
+static bool parseLevel(const char **string, const char *end, struct MlsLevel *level) {
+    memset(level, 0, sizeof(*level));
+    if (!parseNumber(string, end, 's', &level->sensitivity)) {
+        return false;
+    }
+    if (*string == end || **string != ':') {
+        return true;
+    }
+    ++*string;
+    for (;;) {
+        uint32_t first;
+        if (!parseNumber(string, end, 'c', &first)) {
+            return false;
+        }
+        uint32_t last = first;
+        if (*string != end && **string == '.') {
+            ++*string;
+            if (!parseNumber(string, end, 'c', &last) || last < first) {
+                return false;
+            }
+        }
+        if (last >= MLS_CATEGORY_COUNT) {
+            return false;
+        }
+        setCategories(level, first, last);
+        if (*string == end || **string != ',') {
+            return true;
+        }
+        ++*string;
+    }
+}
+
+static bool isZero(CategoryVector vector) {
+    return !(vector[0] | vector[1]);
+}
+
+// Whether level1 dominates level2, i.e. has at least its sensitivity and all its categories.
+static bool dominates(const struct MlsLevel *level1, const struct MlsLevel *level2) {
+    if (level1->sensitivity < level2->sensitivity) {
+        return false;
+    }
+    CategoryVector missing = {};
+    for (size_t i = 0; i < CATEGORY_VECTOR_COUNT; ++i) {
+        missing |= level2->categories[i] & ~level1->categories[i];
+    }
+    return isZero(missing);
+}
+
+static bool levelsEqual(const struct MlsLevel *level1, const struct MlsLevel *level2) {
+    if (level1->sensitivity != level2->sensitivity) {
+        return false;
+    }
+    CategoryVector different = {};
+    for (size_t i = 0; i < CATEGORY_VECTOR_COUNT; ++i) {
+        different |= level1->categories[i] ^ level2->categories[i];
+    }
+    return isZero(different);
+}
+
+static bool intersects(const struct MlsLevel *level1, const struct MlsLevel *level2) {
+    CategoryVector common = {};
+    for (size_t i = 0; i < CATEGORY_VECTOR_COUNT; ++i) {
+        common |= level1->categories[i] & level2->categories[i];
+    }
+    return !isZero(common);
+}
+
+static bool parseRange(const char *string, size_t length, struct MlsRange *range) {
+    const char *end = string + length;
+    if (!parseLevel(&string, end, &range->low)) {
+        return false;
+    }
+    if (string == end) {
+        range->high = range->low;
+        return true;
+    }
+    if (*string != '-') {
+        return false;
+    }
+    ++string;
+    // Like mls_range_isvalid() in libsepol, the high level must dominate the low one.
+    return parseLevel(&string, end, &range->high) && string == end
+            && dominates(&range->high, &range->low);
+}
+
+ssize_t mls_levels_add(struct mls_levels *levels, const char *range, size_t length) {
+    ssize_t index = string_pool_find(levels->strings, range, length);
+    if (index != -1) {
+        return index;
+    }
+    struct MlsRange parsedRange;
+    if (!parseRange(range, length, &parsedRange)) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t rangeCount = string_pool_get_count(levels->strings);
+    if (rangeCount == levels->rangeCapacity) {
+        size_t newRangeCapacity = levels->rangeCapacity ? levels->rangeCapacity * 2 : 64;
+        struct MlsRange *newRanges = realloc(levels->ranges,
+                                             newRangeCapacity * sizeof(*newRanges));
+        if (!newRanges) {
+            errno = ENOMEM;
+            return -1;
+        }
+        levels->ranges = newRanges;
+        levels->rangeCapacity = newRangeCapacity;
+    }
+    index = string_pool_add(levels->strings, range, length);
+    if (index == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    levels->ranges[index] = parsedRange;
+    return index;
+}
+
+const char *mls_levels_get_context_range(const char *context) {
+    const char *range = context;
+    for (int i = 0; i < 3; ++i) {
+        range = strchr(range, ':');
+        if (!range) {
+            return NULL;
+        }
+        ++range;
+    }
+    return range;
+}
+
+static bool compareRanges(const struct MlsRange *range1, const struct MlsRange *range2,
+                          enum mls_levels_op op) {
+    switch (op) {
+        case MLS_LEVELS_OP_DOMINATES:
+            return dominates(&range1->low, &range2->low);
+        case MLS_LEVELS_OP_EQUALS:
+            return levelsEqual(&range1->low, &range2->low)
+                    && levelsEqual(&range1->high, &range2->high);
+        case MLS_LEVELS_OP_INTERSECTS:
+            return intersects(&range1->low, &range2->low);
+        case MLS_LEVELS_OP_CONTAINS:
+            return dominates(&range2->low, &range1->low)
+                    && dominates(&range1->high, &range2->high);
+    }
+    return false;
+}
+
+int mls_levels_compare_batch(const struct mls_levels *levels, enum mls_levels_op op,
+                             const uint32_t *indices1, const uint32_t *indices2, size_t count,
+                             uint64_t *results) {
+    if ((unsigned int) op > MLS_LEVELS_OP_CONTAINS) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t rangeCount = string_pool_get_count(levels->strings);
+    memset(results, 0, (count + 63) / 64 * sizeof(*results));
+    for (size_t i = 0; i < count; ++i) {
+        if (indices1[i] >= rangeCount || indices2[i] >= rangeCount) {
+            errno = EINVAL;
+            return -1;
+        }
+        if (compareRanges(&levels->ranges[indices1[i]], &levels->ranges[indices2[i]], op)) {
+            results[i / 64] |= UINT64_C(1) << (i % 64);
+        }
+    }
+    return 0;
+}
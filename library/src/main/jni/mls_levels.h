@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_MLS_LEVELS_H
+#define LIBSELINUX_JNI_MLS_LEVELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Categories c0 to c1023, which is what Android policies define.
+#define MLS_CATEGORY_COUNT 1024
+
+// A pool of MLS ranges like "s0-s0:c0.c1023", or levels like "s0:c512,c768" which are ranges with
+// equal low and high levels. Each unique string is parsed once into category bitsets, so that
+// comparisons take a few vector instructions instead of parsing strings like context.c.
+// Sensitivities are ordered by their number, which matches the dominance order of Android
+// policies. Not thread-safe while adding, but comparisons may run concurrently.
+struct mls_levels;
+
+enum mls_levels_op {
+    // The low level of the first dominates that of the second.
+    MLS_LEVELS_OP_DOMINATES = 0,
+    // Both ranges are equal.
+    MLS_LEVELS_OP_EQUALS = 1,
+    // The low levels of both share at least one category.
+    MLS_LEVELS_OP_INTERSECTS = 2,
+    // The first range contains the second one.
+    MLS_LEVELS_OP_CONTAINS = 3,
+};
+
+struct mls_levels *mls_levels_create(void);
+
+void mls_levels_destroy(struct mls_levels *levels);
+
+// Returns the index of the range, parsing it if it isn't in the pool yet, or -1 with errno set,
+// which is EINVAL if it isn't a valid range.
+ssize_t mls_levels_add(struct mls_levels *levels, const char *range, size_t length);
+
+// Returns the range part of a context, i.e. what follows its third colon, or NULL if it has none.
+const char *mls_levels_get_context_range(const char *context);
+
+// Sets bit i % 64 of results[i / 64] if op holds for ranges indices1[i] and indices2[i], which must
+// have been returned by mls_levels_add(). Returns 0 on success, or -1 with errno set.
+int mls_levels_compare_batch(const struct mls_levels *levels, enum mls_levels_op op,
+                             const uint32_t *indices1, const uint32_t *indices2, size_t count,
+                             uint64_t *results);
+
+#endif // LIBSELINUX_JNI_MLS_LEVELS_H
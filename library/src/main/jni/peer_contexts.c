@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "peer_contexts.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+
+#include "string_pool.h"
+
+// Enough for any context in practice, the same as INITCONTEXTLEN + 1 in selinux_internal.h. Longer
+// ones fall back to the heap.
+#define CONTEXT_BUFFER_SIZE 256
+
+struct peer_contexts {
+    // Guards contexts, which is only held for the lookup and never across the system call.
+    pthread_mutex_t mutex;
+    struct string_pool *contexts;
+};
+
+struct peer_contexts *peer_contexts_create(void) {
+    struct peer_contexts *contexts = malloc(sizeof(*contexts));
+    if (!contexts) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    contexts->contexts = string_pool_create();
+    if (!contexts->contexts) {
+        free(contexts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    pthread_mutex_init(&contexts->mutex, NULL);
+    return contexts;
+}
+
+void peer_contexts_destroy(struct peer_contexts *contexts) {
+    pthread_mutex_destroy(&contexts->mutex);
+    string_pool_destroy(contexts->contexts);
+    free(contexts);
+}
+
+static ssize_t internContext(struct peer_contexts *contexts, const char *context, size_t length) {
+    // The kernel includes the terminating NUL.
+    while (length && !context[length - 1]) {
+        --length;
+    }
+    if (!length) {
+        errno = ENOPROTOOPT;
+        return -1;
+    }
+    pthread_mutex_lock(&contexts->mutex);
+    ssize_t index = string_pool_find(contexts->contexts, context, length);
+    if (index == -1) {
+        index = string_pool_add(contexts->contexts, context, length);
+    }
+    pthread_mutex_unlock(&contexts->mutex);
+    if (index == -1) {
+        errno = ENOMEM;
+    }
+    return index;
+}
+
+ssize_t peer_contexts_get(struct peer_contexts *contexts, int fd) {
+    char buffer[CONTEXT_BUFFER_SIZE];
+    socklen_t length = sizeof(buffer);
+    if (!getsockopt(fd, SOL_SOCKET, SO_PEERSEC, buffer, &length)) {
+        return internContext(contexts, buffer, length);
+    }
+    if (errno != ERANGE) {
+        return -1;
+    }
+    // The kernel has set length to what it needs.
+    char *heapBuffer = malloc(length);
+    if (!heapBuffer) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t index;
+    if (!getsockopt(fd, SOL_SOCKET, SO_PEERSEC, heapBuffer, &length)) {
+        index = internContext(contexts, heapBuffer, length);
+    } else {
+        index = -1;
+    }
+    int savedErrno = errno;
+    free(heapBuffer);
+    errno = savedErrno;
+    return index;
+}
+
+const char *peer_contexts_get_context(struct peer_contexts *contexts, uint32_t index) {
+    pthread_mutex_lock(&contexts->mutex);
+    const char *context = index < string_pool_get_count(contexts->contexts)
+            ? string_pool_get(contexts->contexts, index) : NULL;
+    pthread_mutex_unlock(&contexts->mutex);
+    return context;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_PEER_CONTEXTS_H
+#define LIBSELINUX_JNI_PEER_CONTEXTS_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// A pool of the contexts of socket peers, like getpeercon() but interned, so that a server labeling
+// every connection gets a small stable index for each distinct peer context instead of a new
+// string. The context still comes from SO_PEERSEC on every call, because a pid may be reused or
+// change its context on exec. Thread-safe.
+struct peer_contexts;
+
+// Returns a new pool, or NULL with errno set.
+struct peer_contexts *peer_contexts_create(void);
+
+void peer_contexts_destroy(struct peer_contexts *contexts);
+
+// Returns the index of the context of the peer of the socket, or -1 with errno set.
+ssize_t peer_contexts_get(struct peer_contexts *contexts, int fd);
+
+// Returns the context of an index returned by peer_contexts_get(), or NULL if it isn't one. The
+// context stays valid until the pool is destroyed.
+const char *peer_contexts_get_context(struct peer_contexts *contexts, uint32_t index);
+
+#endif // LIBSELINUX_JNI_PEER_CONTEXTS_H
@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "proc_scan.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "string_pool.h"
+
+// Large enough for the entries of a few hundred processes per getdents64().
+#define DIRENT_BUFFER_SIZE 32768
+
+// Contexts are much shorter in practice, and the buffer grows if one isn't.
+#define INITIAL_CONTEXT_BUFFER_SIZE 256
+
+// The layout the kernel fills in for getdents64(), which bionic doesn't declare on older APIs.
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+struct proc_scan {
+    int procFd;
+    struct string_pool *contexts;
+    char *direntBuffer;
+    char *contextBuffer;
+    size_t contextBufferSize;
+    pid_t *pids;
+    size_t pidCapacity;
+    struct proc_scan_entry *entries;
+    size_t entryCount;
+    size_t entryCapacity;
+};
+
+struct proc_scan *proc_scan_create(void) {
+    struct proc_scan *scan = calloc(1, sizeof(*scan));
+    if (!scan) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    scan->procFd = -1;
+    scan->contexts = string_pool_create();
+    scan->direntBuffer = malloc(DIRENT_BUFFER_SIZE);
+    scan->contextBufferSize = INITIAL_CONTEXT_BUFFER_SIZE;
+    scan->contextBuffer = malloc(scan->contextBufferSize);
+    if (!scan->contexts || !scan->direntBuffer || !scan->contextBuffer) {
+        proc_scan_destroy(scan);
+        errno = ENOMEM;
+        return NULL;
+    }
+    scan->procFd = TEMP_FAILURE_RETRY(open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (scan->procFd == -1) {
+        int savedErrno = errno;
+        proc_scan_destroy(scan);
+        errno = savedErrno;
+        return NULL;
+    }
+    return scan;
+}
+
+void proc_scan_destroy(struct proc_scan *scan) {
+    if (scan->procFd != -1) {
+        close(scan->procFd);
+    }
+    if (scan->contexts) {
+        string_pool_destroy(scan->contexts);
+    }
+    free(scan->direntBuffer);
+    free(scan->contextBuffer);
+    free(scan->pids);
+    free(scan->entries);
+    free(scan);
+}
+
+// Returns the number, or -1 if the name isn't all digits, like the name of a process in /proc.
+static pid_t parsePid(const char *name) {
+    if (!*name) {
+        return -1;
+    }
+    pid_t pid = 0;
+    for (const char *nameChar = name; *nameChar; ++nameChar) {
+        if (*nameChar < '0' || *nameChar > '9' || pid > (INT32_MAX - 9) / 10) {
+            return -1;
+        }
+        pid = pid * 10 + (*nameChar - '0');
+    }
+    return pid;
+}
+
+// Collects the numeric names in the directory into scan->pids, and returns their count or -1 with
+// errno set.
+static ssize_t readPids(struct proc_scan *scan, int directoryFd) {
+    if (lseek(directoryFd, 0, SEEK_SET) == -1) {
+        return -1;
+    }
+    size_t pidCount = 0;
+    while (true) {
+        long length = syscall(SYS_getdents64, directoryFd, scan->direntBuffer, DIRENT_BUFFER_SIZE);
+        if (length == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (!length) {
+            break;
+        }
+        for (long offset = 0; offset < length;) {
+            const struct LinuxDirent64 *dirent = (const struct LinuxDirent64 *) (scan->direntBuffer
+                    + offset);
+            offset += dirent->d_reclen;
+            pid_t pid = parsePid(dirent->d_name);
+            if (pid == -1) {
+                continue;
+            }
+            if (pidCount == scan->pidCapacity) {
+                size_t newCapacity = scan->pidCapacity ? 2 * scan->pidCapacity : 1024;
+                pid_t *newPids = realloc(scan->pids, newCapacity * sizeof(*newPids));
+                if (!newPids) {
+                    errno = ENOMEM;
+                    return -1;
+                }
+                scan->pids = newPids;
+                scan->pidCapacity = newCapacity;
+            }
+            scan->pids[pidCount] = pid;
+            ++pidCount;
+        }
+    }
+    return (ssize_t) pidCount;
+}
+
+// Reads attr/current at the path relative to /proc into the pool. Returns 0 on success, 1 if the
+// process is gone or has no context, or -1 with errno set.
+static int readContext(struct proc_scan *scan, const char *path, uint32_t *outContext) {
+    int fd = TEMP_FAILURE_RETRY(openat(scan->procFd, path, O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return 1;
+    }
+    ssize_t length;
+    while (true) {
+        length = TEMP_FAILURE_RETRY(pread(fd, scan->contextBuffer, scan->contextBufferSize, 0));
+        if (length == -1 || (size_t) length < scan->contextBufferSize) {
+            break;
+        }
+        // The context may have been truncated, so retry with a larger buffer.
+        size_t newSize = 2 * scan->contextBufferSize;
+        char *newBuffer = realloc(scan->contextBuffer, newSize);
+        if (!newBuffer) {
+            close(fd);
+            errno = ENOMEM;
+            return -1;
+        }
+        scan->contextBuffer = newBuffer;
+        scan->contextBufferSize = newSize;
+    }
+    close(fd);
+    if (length == -1) {
+        return 1;
+    }
+    // The kernel includes the terminating NUL, and some versions a newline.
+    size_t contextLength = (size_t) length;
+    while (contextLength && (scan->contextBuffer[contextLength - 1] == '\0'
+            || scan->contextBuffer[contextLength - 1] == '\n')) {
+        --contextLength;
+    }
+    if (!contextLength) {
+        return 1;
+    }
+    ssize_t context = string_pool_add(scan->contexts, scan->contextBuffer, contextLength);
+    if (context == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    *outContext = (uint32_t) context;
+    return 0;
+}
+
+static int addEntry(struct proc_scan *scan, pid_t pid, pid_t tid, uint32_t context) {
+    if (scan->entryCount == scan->entryCapacity) {
+        size_t newCapacity = scan->entryCapacity ? 2 * scan->entryCapacity : 1024;
+        struct proc_scan_entry *newEntries = realloc(scan->entries,
+                                                     newCapacity * sizeof(*newEntries));
+        if (!newEntries) {
+            errno = ENOMEM;
+            return -1;
+        }
+        scan->entries = newEntries;
+        scan->entryCapacity = newCapacity;
+    }
+    struct proc_scan_entry *entry = &scan->entries[scan->entryCount];
+    entry->pid = pid;
+    entry->tid = tid;
+    entry->context = context;
+    ++scan->entryCount;
+    return 0;
+}
+
+// Adds the threads of a process. A process that is gone is skipped.
+static int scanThreads(struct proc_scan *scan, pid_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "%d/task", pid);
+    int taskFd = TEMP_FAILURE_RETRY(openat(scan->procFd, path, O_RDONLY | O_DIRECTORY
+            | O_CLOEXEC));
+    if (taskFd == -1) {
+        return 0;
+    }
+    // The process list was already copied out of the dirent buffer, so readPids() can reuse it,
+    // but it also reuses scan->pids, so the threads go after the processes.
+    ssize_t tidCount = readPids(scan, taskFd);
+    close(taskFd);
+    if (tidCount == -1) {
+        return errno == ENOMEM ? -1 : 0;
+    }
+    for (ssize_t i = 0; i < tidCount; ++i) {
+        pid_t tid = scan->pids[i];
+        snprintf(path, sizeof(path), "%d/task/%d/attr/current", pid, tid);
+        uint32_t context;
+        int result = readContext(scan, path, &context);
+        if (result == -1) {
+            return -1;
+        }
+        if (!result && addEntry(scan, pid, tid, context)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+ssize_t proc_scan_run(struct proc_scan *scan, bool includeThreads,
+                      const struct proc_scan_entry **entries) {
+    scan->entryCount = 0;
+    ssize_t pidCount = readPids(scan, scan->procFd);
+    if (pidCount == -1) {
+        return -1;
+    }
+    if (includeThreads) {
+        // scanThreads() reuses scan->pids, so keep the processes in the entries first, with
+        // tid as a placeholder.
+        for (ssize_t i = 0; i < pidCount; ++i) {
+            if (addEntry(scan, scan->pids[i], 0, 0)) {
+                return -1;
+            }
+        }
+        size_t processCount = scan->entryCount;
+        for (size_t i = 0; i < processCount; ++i) {
+            if (scanThreads(scan, scan->entries[i].pid)) {
+                return -1;
+            }
+        }
+        // Drop the placeholders.
+        scan->entryCount -= processCount;
+        memmove(scan->entries, scan->entries + processCount,
+                scan->entryCount * sizeof(*scan->entries));
+    } else {
+        char path[32];
+        for (ssize_t i = 0; i < pidCount; ++i) {
+            pid_t pid = scan->pids[i];
+            snprintf(path, sizeof(path), "%d/attr/current", pid);
+            uint32_t context;
+            int result = readContext(scan, path, &context);
+            if (result == -1) {
+                return -1;
+            }
+            if (!result && addEntry(scan, pid, pid, context)) {
+                return -1;
+            }
+        }
+    }
+    *entries = scan->entries;
+    return (ssize_t) scan->entryCount;
+}
+
+const char *proc_scan_get_context(const struct proc_scan *scan, uint32_t context) {
+    if (context >= string_pool_get_count(scan->contexts)) {
+        return NULL;
+    }
+    return string_pool_get(scan->contexts, context);
+}
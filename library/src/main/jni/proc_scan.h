@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_PROC_SCAN_H
+#define LIBSELINUX_JNI_PROC_SCAN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// A scanner of the contexts of all processes, like getpidcon() for each of them, but walking /proc
+// with getdents64() and opening each attr/current relative to a /proc file descriptor that is kept
+// open. Buffers are kept across scans, and contexts are interned into a pool that lives as long as
+// the scanner, so that repeated scans only allocate for contexts never seen before. Not
+// thread-safe.
+struct proc_scan;
+
+struct proc_scan_entry {
+    pid_t pid;
+    // The same as pid unless threads are included.
+    pid_t tid;
+    // Index of the context for proc_scan_get_context().
+    uint32_t context;
+};
+
+// Returns a new scanner, or NULL with errno set.
+struct proc_scan *proc_scan_create(void);
+
+void proc_scan_destroy(struct proc_scan *scan);
+
+// Scans the processes, and each of their threads if includeThreads. Processes and threads that
+// exit during the scan, or have no context, are left out. Returns the number of entries, which stay
+// valid until the next scan, or -1 with errno set.
+ssize_t proc_scan_run(struct proc_scan *scan, bool includeThreads,
+                      const struct proc_scan_entry **entries);
+
+// Returns the context of an index in a proc_scan_entry, or NULL if it isn't one.
+const char *proc_scan_get_context(const struct proc_scan *scan, uint32_t context);
+
+#endif // LIBSELINUX_JNI_PROC_SCAN_H
@@ -0,0 +1,459 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "property_trie.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atomic_file.h"
+#include "spec_file.h"
+#include "string_pool.h"
+
+#define PROPERTY_TRIE_MAGIC 0x49525450 // "PTRI"
+#define PROPERTY_TRIE_VERSION 1
+
+// All offsets are relative to the start of the header, and everything is aligned to 4 bytes.
+struct TrieHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t rootOffset;
+    // The context of "*", or PROPERTY_TRIE_NO_CONTEXT.
+    uint32_t defaultContextIndex;
+    uint32_t contextCount;
+    // Offsets of NUL-terminated context strings.
+    uint32_t contextOffsetsOffset;
+};
+
+struct TrieChild {
+    uint32_t firstByte;
+    uint32_t offset;
+};
+
+// Followed by childCount children sorted by their first byte, and then the edge label leading into
+// this node.
+struct TrieNode {
+    uint32_t edgeLength;
+    // The context of the property prefix ending at this node, or PROPERTY_TRIE_NO_CONTEXT.
+    uint32_t contextIndex;
+    uint32_t childCount;
+    struct TrieChild children[];
+};
+
+struct property_trie {
+    const uint8_t *data;
+    size_t size;
+    bool mapped;
+};
+
+struct Buffer {
+    uint8_t *bytes;
+    size_t size;
+    size_t capacity;
+};
+
+static size_t alignSize(size_t size) {
+    return (size + 3) & ~(size_t) 3;
+}
+
+// Returns the offset of the zeroed space, or SIZE_MAX if out of memory.
+static size_t appendToBuffer(struct Buffer *buffer, size_t size) {
+    size_t alignedSize = alignSize(size);
+    if (buffer->capacity - buffer->size < alignedSize) {
+        size_t newCapacity = buffer->capacity ? buffer->capacity : 4096;
+        while (newCapacity - buffer->size < alignedSize) {
+            newCapacity *= 2;
+        }
+        if (newCapacity > UINT32_MAX) {
+            return SIZE_MAX;
+        }
+        uint8_t *newBytes = realloc(buffer->bytes, newCapacity);
+        if (!newBytes) {
+            return SIZE_MAX;
+        }
+        buffer->bytes = newBytes;
+        buffer->capacity = newCapacity;
+    }
+    size_t offset = buffer->size;
+    memset(buffer->bytes + offset, 0, alignedSize);
+    buffer->size += alignedSize;
+    return offset;
+}
+
+struct PropertySpec {
+    const char *name;
+    size_t nameLength;
+    uint32_t contextIndex;
+};
+
+struct BuildState {
+    struct PropertySpec *specs;
+    size_t specCount;
+    size_t specCapacity;
+    struct string_pool *names;
+    struct string_pool *contexts;
+    uint32_t defaultContextIndex;
+};
+
+static int addSpec(void *cookie, char **fields, size_t fieldCount, unsigned int lineNumber) {
+    struct BuildState *state = cookie;
+    // Like label_backends_android.c, only the first two fields matter.
+    if (fieldCount < 2) {
+        errno = EINVAL;
+        return -1;
+    }
+    ssize_t contextIndex = string_pool_add(state->contexts, fields[1], strlen(fields[1]));
+    if (contextIndex == -1) {
+        return -1;
+    }
+    if (fields[0][0] == '*') {
+        state->defaultContextIndex = (uint32_t) contextIndex;
+        return 0;
+    }
+    size_t nameLength = strlen(fields[0]);
+    ssize_t nameIndex = string_pool_add(state->names, fields[0], nameLength);
+    if (nameIndex == -1) {
+        return -1;
+    }
+    if (state->specCount == state->specCapacity) {
+        size_t newSpecCapacity = state->specCapacity ? state->specCapacity * 2 : 256;
+        struct PropertySpec *newSpecs = realloc(state->specs,
+                                                newSpecCapacity * sizeof(*newSpecs));
+        if (!newSpecs) {
+            errno = ENOMEM;
+            return -1;
+        }
+        state->specs = newSpecs;
+        state->specCapacity = newSpecCapacity;
+    }
+    struct PropertySpec *spec = &state->specs[state->specCount++];
+    spec->name = string_pool_get(state->names, (size_t) nameIndex);
+    spec->nameLength = nameLength;
+    spec->contextIndex = (uint32_t) contextIndex;
+    return 0;
+}
+
+static int compareSpecs(const void *spec1, const void *spec2) {
+    return strcmp(((const struct PropertySpec *) spec1)->name,
+                  ((const struct PropertySpec *) spec2)->name);
+}
+
+// Writes the node for specs sharing the first depth bytes, whose edge label starts at edgeStart.
+// Returns the offset of the node, or SIZE_MAX if out of memory.
+static size_t writeNode(struct Buffer *buffer, const struct PropertySpec *specs, size_t specCount,
+                        size_t depth, size_t edgeStart) {
+    uint32_t contextIndex = PROPERTY_TRIE_NO_CONTEXT;
+    size_t childStart = 0;
+    if (specs[0].nameLength == depth) {
+        contextIndex = specs[0].contextIndex;
+        childStart = 1;
+    }
+    uint32_t childCount = 0;
+    for (size_t i = childStart; i < specCount; ++i) {
+        if (i == childStart || specs[i].name[depth] != specs[i - 1].name[depth]) {
+            ++childCount;
+        }
+    }
+    size_t edgeLength = depth - edgeStart;
+    size_t nodeOffset = appendToBuffer(buffer, sizeof(struct TrieNode)
+            + childCount * sizeof(struct TrieChild) + edgeLength);
+    if (nodeOffset == SIZE_MAX) {
+        return SIZE_MAX;
+    }
+    struct TrieNode *node = (struct TrieNode *) (buffer->bytes + nodeOffset);
+    node->edgeLength = (uint32_t) edgeLength;
+    node->contextIndex = contextIndex;
+    node->childCount = childCount;
+    memcpy(&node->children[childCount], specs[0].name + edgeStart, edgeLength);
+
+    uint32_t childIndex = 0;
+    for (size_t groupStart = childStart; groupStart < specCount; ) {
+        size_t groupEnd = groupStart + 1;
+        while (groupEnd < specCount
+                && specs[groupEnd].name[depth] == specs[groupStart].name[depth]) {
+            ++groupEnd;
+        }
+        // Sorted, so the common prefix of the group is that of its first and last specs.
+        const struct PropertySpec *firstSpec = &specs[groupStart];
+        const struct PropertySpec *lastSpec = &specs[groupEnd - 1];
+        size_t childDepth = depth + 1;
+        while (childDepth < firstSpec->nameLength
+                && firstSpec->name[childDepth] == lastSpec->name[childDepth]) {
+            ++childDepth;
+        }
+        size_t childOffset = writeNode(buffer, firstSpec, groupEnd - groupStart, childDepth,
+                                       depth);
+        if (childOffset == SIZE_MAX) {
+            return SIZE_MAX;
+        }
+        // The buffer may have moved.
+        node = (struct TrieNode *) (buffer->bytes + nodeOffset);
+        node->children[childIndex].firstByte = (unsigned char) firstSpec->name[depth];
+        node->children[childIndex].offset = (uint32_t) childOffset;
+        ++childIndex;
+        groupStart = groupEnd;
+    }
+    return nodeOffset;
+}
+
+static bool writeTrie(struct Buffer *buffer, struct BuildState *state) {
+    size_t headerOffset = appendToBuffer(buffer, sizeof(struct TrieHeader));
+    if (headerOffset == SIZE_MAX) {
+        return false;
+    }
+    size_t contextCount = string_pool_get_count(state->contexts);
+    size_t contextOffsetsOffset = appendToBuffer(buffer, contextCount * sizeof(uint32_t));
+    if (contextOffsetsOffset == SIZE_MAX) {
+        return false;
+    }
+    for (size_t i = 0; i < contextCount; ++i) {
+        size_t contextLength = string_pool_get_length(state->contexts, i);
+        size_t contextOffset = appendToBuffer(buffer, contextLength + 1);
+        if (contextOffset == SIZE_MAX) {
+            return false;
+        }
+        memcpy(buffer->bytes + contextOffset, string_pool_get(state->contexts, i), contextLength);
+        ((uint32_t *) (buffer->bytes + contextOffsetsOffset))[i] = (uint32_t) contextOffset;
+    }
+    size_t rootOffset;
+    if (state->specCount) {
+        qsort(state->specs, state->specCount, sizeof(*state->specs), compareSpecs);
+        size_t uniqueSpecCount = 1;
+        for (size_t i = 1; i < state->specCount; ++i) {
+            struct PropertySpec *spec = &state->specs[i];
+            struct PropertySpec *previousSpec = &state->specs[uniqueSpecCount - 1];
+            if (spec->name == previousSpec->name) {
+                // Same as nodups_specs() in label_backends_android.c.
+                if (spec->contextIndex != previousSpec->contextIndex) {
+                    errno = EINVAL;
+                    return false;
+                }
+                continue;
+            }
+            state->specs[uniqueSpecCount++] = *spec;
+        }
+        state->specCount = uniqueSpecCount;
+        rootOffset = writeNode(buffer, state->specs, state->specCount, 0, 0);
+    } else {
+        rootOffset = appendToBuffer(buffer, sizeof(struct TrieNode));
+        if (rootOffset != SIZE_MAX) {
+            ((struct TrieNode *) (buffer->bytes + rootOffset))->contextIndex =
+                    PROPERTY_TRIE_NO_CONTEXT;
+        }
+    }
+    if (rootOffset == SIZE_MAX) {
+        return false;
+    }
+    struct TrieHeader *header = (struct TrieHeader *) (buffer->bytes + headerOffset);
+    header->magic = PROPERTY_TRIE_MAGIC;
+    header->version = PROPERTY_TRIE_VERSION;
+    header->size = (uint32_t) buffer->size;
+    header->rootOffset = (uint32_t) rootOffset;
+    header->defaultContextIndex = state->defaultContextIndex;
+    header->contextCount = (uint32_t) contextCount;
+    header->contextOffsetsOffset = (uint32_t) contextOffsetsOffset;
+    return true;
+}
+
+struct property_trie *property_trie_build(const char *const *specFiles, size_t specFileCount) {
+    struct BuildState state = {};
+    state.defaultContextIndex = PROPERTY_TRIE_NO_CONTEXT;
+    state.names = string_pool_create();
+    state.contexts = string_pool_create();
+    struct Buffer buffer = {};
+    struct property_trie *trie = NULL;
+    if (!state.names || !state.contexts) {
+        errno = ENOMEM;
+        goto finish;
+    }
+    for (size_t i = 0; i < specFileCount; ++i) {
+        if (spec_file_for_each_line(specFiles[i], addSpec, &state) == -1) {
+            goto finish;
+        }
+    }
+    errno = ENOMEM;
+    if (!writeTrie(&buffer, &state)) {
+        goto finish;
+    }
+    trie = malloc(sizeof(*trie));
+    if (!trie) {
+        goto finish;
+    }
+    trie->data = buffer.bytes;
+    trie->size = buffer.size;
+    trie->mapped = false;
+    buffer.bytes = NULL;
+finish:
+    free(buffer.bytes);
+    free(state.specs);
+    if (state.names) {
+        string_pool_destroy(state.names);
+    }
+    if (state.contexts) {
+        string_pool_destroy(state.contexts);
+    }
+    return trie;
+}
+
+static const struct TrieNode *getNode(const struct property_trie *trie, uint32_t offset) {
+    if (offset > trie->size || trie->size - offset < sizeof(struct TrieNode)) {
+        return NULL;
+    }
+    const struct TrieNode *node = (const struct TrieNode *) (trie->data + offset);
+    size_t nodeSize = sizeof(*node) + (size_t) node->childCount * sizeof(struct TrieChild)
+            + node->edgeLength;
+    if (trie->size - offset < nodeSize) {
+        return NULL;
+    }
+    return node;
+}
+
+static bool isTrieValid(const struct property_trie *trie) {
+    if (trie->size < sizeof(struct TrieHeader) || (uintptr_t) trie->data % 4) {
+        return false;
+    }
+    const struct TrieHeader *header = (const struct TrieHeader *) trie->data;
+    if (header->magic != PROPERTY_TRIE_MAGIC || header->version != PROPERTY_TRIE_VERSION
+            || header->size != trie->size || header->contextOffsetsOffset % 4
+            || header->contextOffsetsOffset > trie->size
+            || (trie->size - header->contextOffsetsOffset) / sizeof(uint32_t)
+                    < header->contextCount
+            || (header->defaultContextIndex != PROPERTY_TRIE_NO_CONTEXT
+                    && header->defaultContextIndex >= header->contextCount)
+            || header->rootOffset % 4 || !getNode(trie, header->rootOffset)) {
+        return false;
+    }
+    const uint32_t *contextOffsets = (const uint32_t *) (trie->data
+            + header->contextOffsetsOffset);
+    for (uint32_t i = 0; i < header->contextCount; ++i) {
+        if (contextOffsets[i] >= trie->size || !memchr(trie->data + contextOffsets[i], '\0',
+                                                       trie->size - contextOffsets[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct property_trie *property_trie_load(const char *path) {
+    int fd = TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC));
+    if (fd == -1) {
+        return NULL;
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) == -1) {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return NULL;
+    }
+    size_t size = (size_t) fileStat.st_size;
+    void *data = size ? mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    int savedErrno = size ? errno : EINVAL;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = savedErrno;
+        return NULL;
+    }
+    struct property_trie *trie = malloc(sizeof(*trie));
+    if (!trie) {
+        munmap(data, size);
+        errno = ENOMEM;
+        return NULL;
+    }
+    trie->data = data;
+    trie->size = size;
+    trie->mapped = true;
+    if (!isTrieValid(trie)) {
+        property_trie_destroy(trie);
+        errno = EINVAL;
+        return NULL;
+    }
+    return trie;
+}
+
+int property_trie_save(const struct property_trie *trie, const char *path) {
+    // Readers must never map a partial trie.
+    return atomic_file_write(path, trie->data, trie->size);
+}
+
+void property_trie_destroy(struct property_trie *trie) {
+    if (trie->mapped) {
+        munmap((void *) trie->data, trie->size);
+    } else {
+        free((void *) trie->data);
+    }
+    free(trie);
+}
+
+static const struct TrieChild *findChild(const struct TrieNode *node, unsigned char byte) {
+    uint32_t low = 0;
+    uint32_t high = node->childCount;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        const struct TrieChild *child = &node->children[middle];
+        if (child->firstByte == byte) {
+            return child;
+        } else if (child->firstByte < byte) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return NULL;
+}
+
+uint32_t property_trie_lookup(const struct property_trie *trie, const char *name) {
+    const struct TrieHeader *header = (const struct TrieHeader *) trie->data;
+    // Deeper nodes are longer prefixes, so the last context on the path wins.
+    uint32_t contextIndex = header->defaultContextIndex;
+    const char *remainingName = name;
+    size_t remainingLength = strlen(name);
+    const struct TrieNode *node = getNode(trie, header->rootOffset);
+    while (node) {
+        const char *edge = (const char *) &node->children[node->childCount];
+        if (remainingLength < node->edgeLength
+                || memcmp(remainingName, edge, node->edgeLength)) {
+            break;
+        }
+        remainingName += node->edgeLength;
+        remainingLength -= node->edgeLength;
+        if (node->contextIndex != PROPERTY_TRIE_NO_CONTEXT
+                && node->contextIndex < header->contextCount) {
+            contextIndex = node->contextIndex;
+        }
+        if (!remainingLength) {
+            break;
+        }
+        const struct TrieChild *child = findChild(node, (unsigned char) *remainingName);
+        node = child && !(child->offset % 4) ? getNode(trie, child->offset) : NULL;
+        if (node && !node->edgeLength) {
+            // Only the root has an empty edge, and a corrupt file must not make us loop forever.
+            break;
+        }
+    }
+    if (contextIndex == PROPERTY_TRIE_NO_CONTEXT) {
+        errno = ENOENT;
+    }
+    return contextIndex;
+}
+
+uint32_t property_trie_get_context_count(const struct property_trie *trie) {
+    const struct TrieHeader *header = (const struct TrieHeader *) trie->data;
+    return header->contextCount;
+}
+
+const char *property_trie_get_context(const struct property_trie *trie, uint32_t index) {
+    const struct TrieHeader *header = (const struct TrieHeader *) trie->data;
+    const uint32_t *contextOffsets = (const uint32_t *) (trie->data
+            + header->contextOffsetsOffset);
+    return (const char *) (trie->data + contextOffsets[index]);
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_PROPERTY_TRIE_H
+#define LIBSELINUX_JNI_PROPERTY_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A serialized radix trie over property_contexts, similar in spirit to the property_info area of
+// Android, so that looking up a property costs O(name length) instead of a scan over all specs.
+// The matching rules are the same as property_lookup() in label_backends_android.c: the longest
+// prefix wins, and "*" matches everything else. The serialized form is position independent, so it
+// can be saved to a file and mapped back later without parsing.
+struct property_trie;
+
+#define PROPERTY_TRIE_NO_CONTEXT UINT32_MAX
+
+struct property_trie *property_trie_build(const char *const *specFiles, size_t specFileCount);
+
+struct property_trie *property_trie_load(const char *path);
+
+int property_trie_save(const struct property_trie *trie, const char *path);
+
+void property_trie_destroy(struct property_trie *trie);
+
+// Returns the index of the context for the property, or PROPERTY_TRIE_NO_CONTEXT with errno set.
+uint32_t property_trie_lookup(const struct property_trie *trie, const char *name);
+
+uint32_t property_trie_get_context_count(const struct property_trie *trie);
+
+const char *property_trie_get_context(const struct property_trie *trie, uint32_t index);
+
+#endif // LIBSELINUX_JNI_PROPERTY_TRIE_H
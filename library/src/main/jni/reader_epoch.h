@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_READER_EPOCH_H
+#define LIBSELINUX_JNI_READER_EPOCH_H
+
+#include <sched.h>
+
+// Lets readers use a pointer without a lock while a writer replaces it, and tells the writer when
+// the replaced one can be freed. Readers register themselves in readers[epoch & 1] for as long as
+// they use the pointer, and a writer publishes the replacement, advances epoch and then waits for
+// the readers of the previous epoch to drain. Readers of the new epoch can only see the
+// replacement. Zero-initialized, and writers must be serialized.
+struct reader_epoch {
+    unsigned int epoch;
+    unsigned int readers[2];
+};
+
+// Returns the index to pass to reader_epoch_leave(). The pointer must be loaded afterwards, with
+// __ATOMIC_SEQ_CST.
+static inline unsigned int reader_epoch_enter(struct reader_epoch *readerEpoch) {
+    for (;;) {
+        unsigned int epoch = __atomic_load_n(&readerEpoch->epoch, __ATOMIC_SEQ_CST);
+        unsigned int readerIndex = epoch & 1;
+        __atomic_fetch_add(&readerEpoch->readers[readerIndex], 1, __ATOMIC_SEQ_CST);
+        // If a writer advanced the epoch in between, it might not wait for us.
+        if (__atomic_load_n(&readerEpoch->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return readerIndex;
+        }
+        __atomic_fetch_sub(&readerEpoch->readers[readerIndex], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+static inline void reader_epoch_leave(struct reader_epoch *readerEpoch, unsigned int readerIndex) {
+    __atomic_fetch_sub(&readerEpoch->readers[readerIndex], 1, __ATOMIC_RELEASE);
+}
+
+// Must be called after publishing the replacement with __ATOMIC_SEQ_CST. Returns once no reader
+// can see what was replaced anymore.
+static inline void reader_epoch_synchronize(struct reader_epoch *readerEpoch) {
+    unsigned int epoch = __atomic_load_n(&readerEpoch->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&readerEpoch->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(&readerEpoch->readers[epoch & 1], __ATOMIC_ACQUIRE)) {
+        sched_yield();
+    }
+}
+
+#endif // LIBSELINUX_JNI_READER_EPOCH_H
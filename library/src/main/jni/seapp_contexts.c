@@ -0,0 +1,625 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "seapp_contexts.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "spec_file.h"
+#include "string_pool.h"
+
+// From android_filesystem_config.h.
+#define AID_APP_START 10000
+#define AID_SDK_SANDBOX_PROCESS_START 20000
+#define AID_ISOLATED_START 90000
+#define AID_USER_OFFSET 100000
+
+// The flags that a rule always matches against, whether or not it specifies them.
+#define SEAPP_ALWAYS_MATCHED_FLAGS (SEAPP_IS_SYSTEM_SERVER | SEAPP_FROM_RUN_AS \
+        | SEAPP_IS_ISOLATED_COMPUTE_APP | SEAPP_IS_SDK_SANDBOX_AUDIT | SEAPP_IS_SDK_SANDBOX_NEXT)
+
+enum LevelFrom {
+    LEVEL_FROM_NONE,
+    LEVEL_FROM_APP,
+    LEVEL_FROM_USER,
+    LEVEL_FROM_ALL,
+};
+
+struct StringSelector {
+    // Pooled and lower-cased without the trailing '*', or NULL if unspecified.
+    const char *string;
+    size_t length;
+    size_t index;
+    bool isPrefix;
+};
+
+struct SeappRule {
+    uint32_t order;
+    unsigned int flagMask;
+    unsigned int flagValue;
+    struct StringSelector user;
+    const char *seinfo;
+    size_t seinfoIndex;
+    struct StringSelector name;
+    int minTargetSdkVersion;
+    const char *domain;
+    const char *type;
+    enum LevelFrom levelFrom;
+    const char *level;
+};
+
+// The exact string selectors that rules are indexed by, from the most to the least selective. The
+// flag and minTargetSdkVersion= selectors take a single comparison per rule and aren't indexed.
+enum IndexedSelector {
+    INDEXED_SELECTOR_NAME,
+    INDEXED_SELECTOR_SEINFO,
+    INDEXED_SELECTOR_USER,
+    INDEXED_SELECTOR_COUNT,
+};
+
+// The rules that have an output for a kind, sorted by specificity, with the positions of the rules
+// for each key in a compressed sparse row layout. The key of a rule is its most selective exact
+// string selector, so that it can only match queries having that string.
+struct SeappIndex {
+    const struct SeappRule **rules;
+    size_t ruleCount;
+    // Positions of the rules without an exact string selector.
+    uint32_t *genericPositions;
+    size_t genericPositionCount;
+    // Indexed by key, of size key count + 1.
+    uint32_t *keyPositionStarts;
+    uint32_t *keyPositions;
+};
+
+struct seapp_contexts {
+    // Lower-cased user=, seinfo= and name= values.
+    struct string_pool *selectors;
+    // Case preserving domain=, type= and level= values.
+    struct string_pool *outputs;
+    struct SeappRule *rules;
+    size_t ruleCount;
+    size_t ruleCapacity;
+    struct SeappIndex indices[2];
+};
+
+static void toLowerCase(char *string) {
+    for (; *string; ++string) {
+        if (*string >= 'A' && *string <= 'Z') {
+            *string = (char) (*string - 'A' + 'a');
+        }
+    }
+}
+
+static bool parseBoolean(const char *value, bool *outBoolean) {
+    if (!strcasecmp(value, "true")) {
+        *outBoolean = true;
+    } else if (!strcasecmp(value, "false")) {
+        *outBoolean = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseFlag(const char *value, unsigned int flag, bool alwaysMatched,
+                      struct SeappRule *rule) {
+    bool boolean;
+    if (!parseBoolean(value, &boolean)) {
+        return false;
+    }
+    if (!alwaysMatched) {
+        rule->flagMask |= flag;
+    }
+    if (boolean) {
+        rule->flagValue |= flag;
+    } else {
+        rule->flagValue &= ~flag;
+    }
+    return true;
+}
+
+static bool poolString(struct string_pool *pool, const char *string, size_t length,
+                       const char **outString, size_t *outIndex) {
+    ssize_t index = string_pool_add(pool, string, length);
+    if (index == -1) {
+        return false;
+    }
+    *outString = string_pool_get(pool, (size_t) index);
+    if (outIndex) {
+        *outIndex = (size_t) index;
+    }
+    return true;
+}
+
+static bool parseStringSelector(struct seapp_contexts *contexts, char *value,
+                                struct StringSelector *selector) {
+    toLowerCase(value);
+    size_t length = strlen(value);
+    selector->isPrefix = length && value[length - 1] == '*';
+    if (selector->isPrefix) {
+        --length;
+    }
+    selector->length = length;
+    return poolString(contexts->selectors, value, length, &selector->string, &selector->index);
+}
+
+// Returns 0 on success, or an errno.
+static int parseField(struct seapp_contexts *contexts, struct SeappRule *rule, char *field) {
+    char *value = strchr(field, '=');
+    if (!value) {
+        return EINVAL;
+    }
+    *value++ = '\0';
+    if (!*value) {
+        return EINVAL;
+    }
+    const char *key = field;
+    bool parsed;
+    if (!strcasecmp(key, "isSystemServer")) {
+        parsed = parseFlag(value, SEAPP_IS_SYSTEM_SERVER, true, rule);
+    } else if (!strcasecmp(key, "isEphemeralApp")) {
+        parsed = parseFlag(value, SEAPP_IS_EPHEMERAL_APP, false, rule);
+    } else if (!strcasecmp(key, "user")) {
+        if (!parseStringSelector(contexts, value, &rule->user)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else if (!strcasecmp(key, "seinfo")) {
+        // Like android_seapp.c, ':' is reserved for the attributes appended to seinfo.
+        if (strchr(value, ':')) {
+            return EINVAL;
+        }
+        toLowerCase(value);
+        if (!poolString(contexts->selectors, value, strlen(value), &rule->seinfo,
+                        &rule->seinfoIndex)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else if (!strcasecmp(key, "name")) {
+        if (!parseStringSelector(contexts, value, &rule->name)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else if (!strcasecmp(key, "isPrivApp")) {
+        parsed = parseFlag(value, SEAPP_IS_PRIV_APP, false, rule);
+    } else if (!strcasecmp(key, "minTargetSdkVersion")) {
+        char *end;
+        errno = 0;
+        long minTargetSdkVersion = strtol(value, &end, 10);
+        parsed = !errno && !*end && minTargetSdkVersion >= 0 && minTargetSdkVersion <= INT32_MAX;
+        rule->minTargetSdkVersion = (int) minTargetSdkVersion;
+    } else if (!strcasecmp(key, "fromRunAs")) {
+        parsed = parseFlag(value, SEAPP_FROM_RUN_AS, true, rule);
+    } else if (!strcasecmp(key, "isIsolatedComputeApp")) {
+        parsed = parseFlag(value, SEAPP_IS_ISOLATED_COMPUTE_APP, true, rule);
+    } else if (!strcasecmp(key, "isSdkSandboxAudit")) {
+        parsed = parseFlag(value, SEAPP_IS_SDK_SANDBOX_AUDIT, true, rule);
+    } else if (!strcasecmp(key, "isSdkSandboxNext")) {
+        parsed = parseFlag(value, SEAPP_IS_SDK_SANDBOX_NEXT, true, rule);
+    } else if (!strcasecmp(key, "domain")) {
+        if (!poolString(contexts->outputs, value, strlen(value), &rule->domain, NULL)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else if (!strcasecmp(key, "type")) {
+        if (!poolString(contexts->outputs, value, strlen(value), &rule->type, NULL)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else if (!strcasecmp(key, "levelFrom")) {
+        parsed = true;
+        if (!strcasecmp(value, "none")) {
+            rule->levelFrom = LEVEL_FROM_NONE;
+        } else if (!strcasecmp(value, "app")) {
+            rule->levelFrom = LEVEL_FROM_APP;
+        } else if (!strcasecmp(value, "user")) {
+            rule->levelFrom = LEVEL_FROM_USER;
+        } else if (!strcasecmp(value, "all")) {
+            rule->levelFrom = LEVEL_FROM_ALL;
+        } else {
+            parsed = false;
+        }
+    } else if (!strcasecmp(key, "levelFromUid")) {
+        // Deprecated in favor of levelFrom=app.
+        bool levelFromUid = false;
+        parsed = parseBoolean(value, &levelFromUid);
+        rule->levelFrom = levelFromUid ? LEVEL_FROM_APP : LEVEL_FROM_NONE;
+    } else if (!strcasecmp(key, "level")) {
+        if (!poolString(contexts->outputs, value, strlen(value), &rule->level, NULL)) {
+            return ENOMEM;
+        }
+        parsed = true;
+    } else {
+        // Ignoring an unknown selector would make the rule match more than it should.
+        parsed = false;
+    }
+    return parsed ? 0 : EINVAL;
+}
+
+static int addRule(void *cookie, char **fields, size_t fieldCount, unsigned int lineNumber) {
+    struct seapp_contexts *contexts = cookie;
+    if (contexts->ruleCount == contexts->ruleCapacity) {
+        size_t newRuleCapacity = contexts->ruleCapacity ? contexts->ruleCapacity * 2 : 64;
+        struct SeappRule *newRules = realloc(contexts->rules, newRuleCapacity
+                * sizeof(*newRules));
+        if (!newRules) {
+            errno = ENOMEM;
+            return -1;
+        }
+        contexts->rules = newRules;
+        contexts->ruleCapacity = newRuleCapacity;
+    }
+    struct SeappRule *rule = &contexts->rules[contexts->ruleCount];
+    memset(rule, 0, sizeof(*rule));
+    rule->order = (uint32_t) contexts->ruleCount;
+    rule->flagMask = SEAPP_ALWAYS_MATCHED_FLAGS;
+    for (size_t i = 0; i < fieldCount; ++i) {
+        int error = parseField(contexts, rule, fields[i]);
+        if (error) {
+            errno = error;
+            return -1;
+        }
+    }
+    ++contexts->ruleCount;
+    return 0;
+}
+
+static int compareFlag(const struct SeappRule *rule1, const struct SeappRule *rule2,
+                       unsigned int flag, bool isSet) {
+    bool flag1 = (isSet ? rule1->flagMask : rule1->flagValue) & flag;
+    bool flag2 = (isSet ? rule2->flagMask : rule2->flagValue) & flag;
+    return flag1 == flag2 ? 0 : flag1 ? -1 : 1;
+}
+
+static int compareStringSelectors(const struct StringSelector *selector1,
+                                  const struct StringSelector *selector2) {
+    if (!selector1->string != !selector2->string) {
+        return selector1->string ? -1 : 1;
+    }
+    if (!selector1->string) {
+        return 0;
+    }
+    // A fixed string comes before a prefix, and a longer prefix before a shorter one.
+    if (selector1->isPrefix != selector2->isPrefix) {
+        return selector2->isPrefix ? -1 : 1;
+    }
+    if (selector1->isPrefix && selector1->length != selector2->length) {
+        return selector1->length > selector2->length ? -1 : 1;
+    }
+    return 0;
+}
+
+// The same precedence as seapp_context_cmp() in android_seapp.c, made stable by file order.
+static int compareRules(const void *rulePointer1, const void *rulePointer2) {
+    const struct SeappRule *rule1 = *(const struct SeappRule *const *) rulePointer1;
+    const struct SeappRule *rule2 = *(const struct SeappRule *const *) rulePointer2;
+    int result;
+    if ((result = compareFlag(rule1, rule2, SEAPP_IS_SYSTEM_SERVER, false))
+            || (result = compareFlag(rule1, rule2, SEAPP_IS_EPHEMERAL_APP, true))
+            || (result = compareStringSelectors(&rule1->user, &rule2->user))) {
+        return result;
+    }
+    if (!rule1->seinfo != !rule2->seinfo) {
+        return rule1->seinfo ? -1 : 1;
+    }
+    if ((result = compareStringSelectors(&rule1->name, &rule2->name))
+            || (result = compareFlag(rule1, rule2, SEAPP_IS_PRIV_APP, true))) {
+        return result;
+    }
+    if (rule1->minTargetSdkVersion != rule2->minTargetSdkVersion) {
+        return rule1->minTargetSdkVersion > rule2->minTargetSdkVersion ? -1 : 1;
+    }
+    if ((result = compareFlag(rule1, rule2, SEAPP_FROM_RUN_AS, false))
+            || (result = compareFlag(rule1, rule2, SEAPP_IS_ISOLATED_COMPUTE_APP, false))
+            || (result = compareFlag(rule1, rule2, SEAPP_IS_SDK_SANDBOX_AUDIT, false))
+            || (result = compareFlag(rule1, rule2, SEAPP_IS_SDK_SANDBOX_NEXT, false))) {
+        return result;
+    }
+    return rule1->order < rule2->order ? -1 : rule1->order > rule2->order ? 1 : 0;
+}
+
+static bool hasOutput(const struct SeappRule *rule, enum seapp_kind kind) {
+    return kind == SEAPP_KIND_DOMAIN ? rule->domain != NULL : rule->type != NULL;
+}
+
+static size_t getKey(size_t selectorIndex, enum IndexedSelector selector) {
+    return selectorIndex * INDEXED_SELECTOR_COUNT + selector;
+}
+
+// Returns the key of the rule, or -1 if it has no exact string selector.
+static ssize_t getRuleKey(const struct SeappRule *rule) {
+    if (rule->name.string && !rule->name.isPrefix) {
+        return (ssize_t) getKey(rule->name.index, INDEXED_SELECTOR_NAME);
+    }
+    if (rule->seinfo) {
+        return (ssize_t) getKey(rule->seinfoIndex, INDEXED_SELECTOR_SEINFO);
+    }
+    if (rule->user.string && !rule->user.isPrefix) {
+        return (ssize_t) getKey(rule->user.index, INDEXED_SELECTOR_USER);
+    }
+    return -1;
+}
+
+static bool buildIndex(struct seapp_contexts *contexts, enum seapp_kind kind) {
+    struct SeappIndex *index = &contexts->indices[kind];
+    size_t ruleCount = 0;
+    for (size_t i = 0; i < contexts->ruleCount; ++i) {
+        if (hasOutput(&contexts->rules[i], kind)) {
+            ++ruleCount;
+        }
+    }
+    size_t keyCount = string_pool_get_count(contexts->selectors) * INDEXED_SELECTOR_COUNT;
+    index->rules = malloc((ruleCount ? ruleCount : 1) * sizeof(*index->rules));
+    index->genericPositions = malloc((ruleCount ? ruleCount : 1)
+            * sizeof(*index->genericPositions));
+    index->keyPositionStarts = calloc(keyCount + 1, sizeof(*index->keyPositionStarts));
+    index->keyPositions = malloc((ruleCount ? ruleCount : 1) * sizeof(*index->keyPositions));
+    if (!index->rules || !index->genericPositions || !index->keyPositionStarts
+            || !index->keyPositions) {
+        return false;
+    }
+    for (size_t i = 0; i < contexts->ruleCount; ++i) {
+        if (hasOutput(&contexts->rules[i], kind)) {
+            index->rules[index->ruleCount++] = &contexts->rules[i];
+        }
+    }
+    qsort(index->rules, index->ruleCount, sizeof(*index->rules), compareRules);
+    // Count the rules for each key, turn the counts into starts, and then fill them in.
+    for (size_t i = 0; i < index->ruleCount; ++i) {
+        ssize_t key = getRuleKey(index->rules[i]);
+        if (key != -1) {
+            ++index->keyPositionStarts[key + 1];
+        }
+    }
+    for (size_t i = 0; i < keyCount; ++i) {
+        index->keyPositionStarts[i + 1] += index->keyPositionStarts[i];
+    }
+    uint32_t *keyFillPositions = malloc((keyCount ? keyCount : 1) * sizeof(*keyFillPositions));
+    if (!keyFillPositions) {
+        return false;
+    }
+    memcpy(keyFillPositions, index->keyPositionStarts, keyCount * sizeof(*keyFillPositions));
+    for (size_t i = 0; i < index->ruleCount; ++i) {
+        ssize_t key = getRuleKey(index->rules[i]);
+        if (key != -1) {
+            index->keyPositions[keyFillPositions[key]++] = (uint32_t) i;
+        } else {
+            index->genericPositions[index->genericPositionCount++] = (uint32_t) i;
+        }
+    }
+    free(keyFillPositions);
+    return true;
+}
+
+static void destroyIndex(struct SeappIndex *index) {
+    free(index->keyPositions);
+    free(index->keyPositionStarts);
+    free(index->genericPositions);
+    free(index->rules);
+}
+
+struct seapp_contexts *seapp_contexts_build(const char *const *specFiles, size_t specFileCount) {
+    struct seapp_contexts *contexts = calloc(1, sizeof(*contexts));
+    if (!contexts) {
+        return NULL;
+    }
+    contexts->selectors = string_pool_create();
+    contexts->outputs = string_pool_create();
+    if (!contexts->selectors || !contexts->outputs) {
+        seapp_contexts_destroy(contexts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (size_t i = 0; i < specFileCount; ++i) {
+        if (spec_file_for_each_line(specFiles[i], addRule, contexts) == -1) {
+            int savedErrno = errno;
+            seapp_contexts_destroy(contexts);
+            errno = savedErrno;
+            return NULL;
+        }
+    }
+    if (!buildIndex(contexts, SEAPP_KIND_DOMAIN) || !buildIndex(contexts, SEAPP_KIND_TYPE)) {
+        seapp_contexts_destroy(contexts);
+        errno = ENOMEM;
+        return NULL;
+    }
+    return contexts;
+}
+
+void seapp_contexts_destroy(struct seapp_contexts *contexts) {
+    destroyIndex(&contexts->indices[SEAPP_KIND_TYPE]);
+    destroyIndex(&contexts->indices[SEAPP_KIND_DOMAIN]);
+    free(contexts->rules);
+    if (contexts->outputs) {
+        string_pool_destroy(contexts->outputs);
+    }
+    if (contexts->selectors) {
+        string_pool_destroy(contexts->selectors);
+    }
+    free(contexts);
+}
+
+struct QuerySelector {
+    // Lower-cased, or NULL if unspecified.
+    const char *string;
+    // The pooled copy for comparing against exact selectors, or NULL if absent from the pool.
+    const char *pooledString;
+    ssize_t index;
+};
+
+static void initQuerySelector(const struct seapp_contexts *contexts, char *string,
+                              struct QuerySelector *selector) {
+    selector->string = string;
+    selector->pooledString = NULL;
+    selector->index = -1;
+    if (string) {
+        toLowerCase(string);
+        selector->index = string_pool_find(contexts->selectors, string, strlen(string));
+        if (selector->index != -1) {
+            selector->pooledString = string_pool_get(contexts->selectors,
+                                                     (size_t) selector->index);
+        }
+    }
+}
+
+static bool matchesStringSelector(const struct StringSelector *selector,
+                                  const struct QuerySelector *querySelector) {
+    if (!selector->string) {
+        return true;
+    }
+    if (selector->isPrefix) {
+        return querySelector->string && !strncmp(querySelector->string, selector->string,
+                                                 selector->length);
+    }
+    return querySelector->pooledString == selector->string;
+}
+
+static bool matchesRule(const struct SeappRule *rule, const struct seapp_query *query,
+                        const struct QuerySelector *user, const struct QuerySelector *seinfo,
+                        const struct QuerySelector *name) {
+    return (query->flags & rule->flagMask) == rule->flagValue
+            && matchesStringSelector(&rule->user, user)
+            && (!rule->seinfo || seinfo->pooledString == rule->seinfo)
+            && matchesStringSelector(&rule->name, name)
+            && rule->minTargetSdkVersion <= query->targetSdkVersion;
+}
+
+struct PositionList {
+    const uint32_t *positions;
+    size_t count;
+};
+
+static void addKeyPositionList(const struct SeappIndex *index,
+                               const struct QuerySelector *querySelector,
+                               enum IndexedSelector selector, struct PositionList *lists,
+                               size_t *listCount) {
+    if (querySelector->index == -1) {
+        return;
+    }
+    size_t key = getKey((size_t) querySelector->index, selector);
+    uint32_t start = index->keyPositionStarts[key];
+    uint32_t end = index->keyPositionStarts[key + 1];
+    if (start == end) {
+        return;
+    }
+    struct PositionList *list = &lists[*listCount];
+    list->positions = index->keyPositions + start;
+    list->count = end - start;
+    ++*listCount;
+}
+
+static char *newContext(const struct SeappRule *rule, enum seapp_kind kind, uid_t userId,
+                        uid_t appId) {
+    char level[64];
+    switch (rule->levelFrom) {
+        case LEVEL_FROM_APP:
+            snprintf(level, sizeof(level), "s0:c%u,c%u", appId & 0xff,
+                     256 + (appId >> 8 & 0xff));
+            break;
+        case LEVEL_FROM_USER:
+            snprintf(level, sizeof(level), "s0:c%u,c%u", 512 + (userId & 0xff),
+                     768 + (userId >> 8 & 0xff));
+            break;
+        case LEVEL_FROM_ALL:
+            snprintf(level, sizeof(level), "s0:c%u,c%u,c%u,c%u", appId & 0xff,
+                     256 + (appId >> 8 & 0xff), 512 + (userId & 0xff), 768 + (userId >> 8 & 0xff));
+            break;
+        default:
+            snprintf(level, sizeof(level), "%s", rule->level ? rule->level : "s0");
+    }
+    char *context;
+    int result = kind == SEAPP_KIND_DOMAIN ? asprintf(&context, "u:r:%s:%s", rule->domain, level)
+            : asprintf(&context, "u:object_r:%s:%s", rule->type, level);
+    if (result == -1) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return context;
+}
+
+char *seapp_contexts_lookup(const struct seapp_contexts *contexts, enum seapp_kind kind,
+                            const struct seapp_query *query) {
+    uid_t userId = query->uid / AID_USER_OFFSET;
+    uid_t appId = query->uid % AID_USER_OFFSET;
+    const char *user = query->user;
+    if (appId >= AID_ISOLATED_START) {
+        appId -= AID_ISOLATED_START;
+        user = user ? user : "_isolated";
+    } else if (appId >= AID_SDK_SANDBOX_PROCESS_START) {
+        appId -= AID_SDK_SANDBOX_PROCESS_START;
+        user = user ? user : "_sdksandbox";
+    } else if (appId >= AID_APP_START) {
+        appId -= AID_APP_START;
+        user = user ? user : "_app";
+    }
+    // Lower-case copies of the selectors of the query, in one allocation.
+    size_t userSize = user ? strlen(user) + 1 : 0;
+    size_t seinfoSize = query->seinfo ? strlen(query->seinfo) + 1 : 0;
+    size_t nameSize = query->name ? strlen(query->name) + 1 : 0;
+    char *strings = malloc(userSize + seinfoSize + nameSize + 1);
+    if (!strings) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    if (user) {
+        memcpy(strings, user, userSize);
+    }
+    if (query->seinfo) {
+        memcpy(strings + userSize, query->seinfo, seinfoSize);
+    }
+    if (query->name) {
+        memcpy(strings + userSize + seinfoSize, query->name, nameSize);
+    }
+    struct QuerySelector userSelector;
+    initQuerySelector(contexts, user ? strings : NULL, &userSelector);
+    struct QuerySelector seinfoSelector;
+    initQuerySelector(contexts, query->seinfo ? strings + userSize : NULL, &seinfoSelector);
+    struct QuerySelector nameSelector;
+    initQuerySelector(contexts, query->name ? strings + userSize + seinfoSize : NULL,
+                      &nameSelector);
+
+    // Merge the rules for the exact strings of the query with the rules without any, in order of
+    // specificity.
+    const struct SeappIndex *index = &contexts->indices[kind];
+    struct PositionList lists[INDEXED_SELECTOR_COUNT + 1];
+    size_t listCount = 0;
+    addKeyPositionList(index, &nameSelector, INDEXED_SELECTOR_NAME, lists, &listCount);
+    addKeyPositionList(index, &seinfoSelector, INDEXED_SELECTOR_SEINFO, lists, &listCount);
+    addKeyPositionList(index, &userSelector, INDEXED_SELECTOR_USER, lists, &listCount);
+    lists[listCount].positions = index->genericPositions;
+    lists[listCount].count = index->genericPositionCount;
+    ++listCount;
+    const struct SeappRule *matchedRule = NULL;
+    for (;;) {
+        struct PositionList *nextList = NULL;
+        for (size_t i = 0; i < listCount; ++i) {
+            if (lists[i].count && (!nextList || *lists[i].positions < *nextList->positions)) {
+                nextList = &lists[i];
+            }
+        }
+        if (!nextList) {
+            break;
+        }
+        const struct SeappRule *rule = index->rules[*nextList->positions];
+        ++nextList->positions;
+        --nextList->count;
+        if (matchesRule(rule, query, &userSelector, &seinfoSelector, &nameSelector)) {
+            matchedRule = rule;
+            break;
+        }
+    }
+    free(strings);
+    if (!matchedRule) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return newContext(matchedRule, kind, userId, appId);
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_SEAPP_CONTEXTS_H
+#define LIBSELINUX_JNI_SEAPP_CONTEXTS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// The seapp_contexts matching of android_seapp.c in the Android fork of libselinux, which upstream
+// libselinux doesn't have. Rules are presorted by the same specificity order, and indexed by their
+// most selective exact name=, seinfo= or user= selector, so that a lookup only evaluates the rules
+// for the strings of its query and the rules without any. The isPrivApp= and minTargetSdkVersion=
+// selectors are cheaper to check per rule than to index. Selectors are pooled and lower-cased
+// once, so that exact matches compare pointers. Immutable once built, so lookups may run
+// concurrently.
+struct seapp_contexts;
+
+enum seapp_kind {
+    SEAPP_KIND_DOMAIN = 0,
+    SEAPP_KIND_TYPE = 1,
+};
+
+#define SEAPP_IS_SYSTEM_SERVER 0x1
+#define SEAPP_IS_EPHEMERAL_APP 0x2
+#define SEAPP_IS_PRIV_APP 0x4
+#define SEAPP_FROM_RUN_AS 0x8
+#define SEAPP_IS_ISOLATED_COMPUTE_APP 0x10
+#define SEAPP_IS_SDK_SANDBOX_AUDIT 0x20
+#define SEAPP_IS_SDK_SANDBOX_NEXT 0x40
+
+struct seapp_query {
+    // The user= to match, or NULL to derive it from uid for app, SDK sandbox and isolated uids like
+    // android_seapp.c does. Other uids need their android_ids name here.
+    const char *user;
+    const char *seinfo;
+    const char *name;
+    unsigned int flags;
+    int targetSdkVersion;
+    uid_t uid;
+};
+
+struct seapp_contexts *seapp_contexts_build(const char *const *specFiles, size_t specFileCount);
+
+void seapp_contexts_destroy(struct seapp_contexts *contexts);
+
+// Returns the context for the first matching rule in a newly allocated string, like
+// "u:r:untrusted_app:s0:c10,c256,c512,c768" for SEAPP_KIND_DOMAIN, or NULL with errno set, which is
+// ENOENT if no rule matches. kind must be a valid enum seapp_kind.
+char *seapp_contexts_lookup(const struct seapp_contexts *contexts, enum seapp_kind kind,
+                            const struct seapp_query *query);
+
+#endif // LIBSELINUX_JNI_SEAPP_CONTEXTS_H
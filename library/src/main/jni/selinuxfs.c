@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "selinuxfs.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "init_lazy.h"
+#include "selinux_internal.h"
+
+static pthread_mutex_t selinuxfsMutex = PTHREAD_MUTEX_INITIALIZER;
+static int selinuxfsFd = -1;
+
+static int getSelinuxfsFd(void) {
+    int fd = __atomic_load_n(&selinuxfsFd, __ATOMIC_ACQUIRE);
+    if (fd != -1) {
+        return fd;
+    }
+    // selinux_mnt is only found on first use.
+    selinux_lazy_init();
+    pthread_mutex_lock(&selinuxfsMutex);
+    fd = selinuxfsFd;
+    if (fd == -1) {
+        if (selinux_mnt) {
+            fd = TEMP_FAILURE_RETRY(open(selinux_mnt, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+            if (fd != -1) {
+                __atomic_store_n(&selinuxfsFd, fd, __ATOMIC_RELEASE);
+            }
+        } else {
+            errno = ENOENT;
+        }
+    }
+    pthread_mutex_unlock(&selinuxfsMutex);
+    return fd;
+}
+
+static bool isSameFile(const struct stat *stat1, const struct stat *stat2) {
+    return stat1->st_dev == stat2->st_dev && stat1->st_ino == stat2->st_ino;
+}
+
+// Replaces staleFd if selinuxfs is no longer mounted where it was opened from. Returns the new file
+// descriptor, or -1 if nothing changed.
+static int reopenSelinuxfsFd(int staleFd) {
+    pthread_mutex_lock(&selinuxfsMutex);
+    int fd = -1;
+    struct stat staleStat;
+    struct stat mountStat;
+    if (selinuxfsFd != staleFd) {
+        // Another thread got here first.
+        fd = selinuxfsFd;
+    } else if (selinux_mnt && fstat(staleFd, &staleStat) == 0 && stat(selinux_mnt, &mountStat) == 0
+            && !isSameFile(&staleStat, &mountStat)) {
+        fd = TEMP_FAILURE_RETRY(open(selinux_mnt, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if (fd != -1) {
+            // The stale file descriptor is leaked on purpose, because another thread may still be
+            // using it, and closing it would let its number be reused for an unrelated file.
+            __atomic_store_n(&selinuxfsFd, fd, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&selinuxfsMutex);
+    return fd;
+}
+
+int selinuxfs_open(const char *name, int flags) {
+    int directoryFd = getSelinuxfsFd();
+    if (directoryFd == -1) {
+        return -1;
+    }
+    int fd = TEMP_FAILURE_RETRY(openat(directoryFd, name, flags | O_CLOEXEC));
+    if (fd == -1 && (errno == ENOENT || errno == ENODEV || errno == ESTALE)) {
+        // Only check for a remount when something failed, so that the common path stays a single
+        // openat().
+        int savedErrno = errno;
+        directoryFd = reopenSelinuxfsFd(directoryFd);
+        if (directoryFd != -1) {
+            fd = TEMP_FAILURE_RETRY(openat(directoryFd, name, flags | O_CLOEXEC));
+        } else {
+            errno = savedErrno;
+        }
+    }
+    return fd;
+}
+
+ssize_t selinuxfs_transaction(const char *name, const void *request, size_t requestSize,
+                              void *response, size_t responseSize) {
+    int fd = selinuxfs_open(name, O_RDWR);
+    if (fd == -1) {
+        return -1;
+    }
+    ssize_t result = TEMP_FAILURE_RETRY(write(fd, request, requestSize));
+    if (result != -1) {
+        result = response ? TEMP_FAILURE_RETRY(read(fd, response, responseSize)) : 0;
+    }
+    int savedErrno = errno;
+    close(fd);
+    errno = savedErrno;
+    return result;
+}
@@ -0,0 +1,24 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_SELINUXFS_H
+#define LIBSELINUX_JNI_SELINUXFS_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Opens a node of selinuxfs relative to a directory file descriptor that is kept open, so that we
+// don't walk the path from the mount point every time. If the node can't be found, the directory
+// is reopened once in case selinuxfs was remounted.
+int selinuxfs_open(const char *name, int flags);
+
+// Performs a transaction on a node of selinuxfs, i.e. writes the request and then optionally reads
+// the response. The kernel only allows one transaction per open file (see
+// simple_transaction_get()), so file descriptors of transaction nodes can't be pooled, and a new
+// file is opened for each call. Returns the length of the response read, or -1 with errno set.
+ssize_t selinuxfs_transaction(const char *name, const void *request, size_t requestSize,
+                              void *response, size_t responseSize);
+
+#endif // LIBSELINUX_JNI_SELINUXFS_H
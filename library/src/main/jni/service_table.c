@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "service_table.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "spec_file.h"
+#include "string_pool.h"
+
+struct ServiceEntry {
+    uint32_t hash;
+    // The line of the entry across all spec files, so that exact entries can be ordered against the
+    // catch-all.
+    uint32_t order;
+    uint32_t contextIndex;
+    const char *name;
+};
+
+struct service_table {
+    struct string_pool *names;
+    struct string_pool *contexts;
+
+    struct ServiceEntry *entries;
+    size_t entryCount;
+    size_t entryCapacity;
+    // Indices into entries plus one, or 0 for an empty slot.
+    uint32_t *slots;
+    size_t slotCapacity;
+
+    // The first "*" entry, which lookup_exact_match() treats as matching every name.
+    struct ServiceEntry catchAllEntry;
+    bool hasCatchAllEntry;
+
+    uint32_t order;
+};
+
+static bool isCatchAll(const char *name) {
+    return !strcmp(name, "*");
+}
+
+static const struct ServiceEntry *findEntry(const struct service_table *table, const char *name,
+                                            uint32_t hash) {
+    size_t mask = table->slotCapacity - 1;
+    for (size_t i = hash & mask; table->slots[i]; i = (i + 1) & mask) {
+        const struct ServiceEntry *entry = &table->entries[table->slots[i] - 1];
+        if (entry->hash == hash && !strcmp(entry->name, name)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static bool growSlots(struct service_table *table) {
+    size_t newSlotCapacity = table->slotCapacity ? table->slotCapacity * 2 : 64;
+    uint32_t *newSlots = calloc(newSlotCapacity, sizeof(*newSlots));
+    if (!newSlots) {
+        return false;
+    }
+    size_t mask = newSlotCapacity - 1;
+    for (size_t i = 0; i < table->entryCount; ++i) {
+        size_t slotIndex = table->entries[i].hash & mask;
+        while (newSlots[slotIndex]) {
+            slotIndex = (slotIndex + 1) & mask;
+        }
+        newSlots[slotIndex] = (uint32_t) (i + 1);
+    }
+    free(table->slots);
+    table->slots = newSlots;
+    table->slotCapacity = newSlotCapacity;
+    return true;
+}
+
+static struct ServiceEntry *appendEntry(struct service_table *table) {
+    if (table->entryCount == table->entryCapacity) {
+        size_t newEntryCapacity = table->entryCapacity ? table->entryCapacity * 2 : 64;
+        struct ServiceEntry *newEntries = realloc(table->entries, newEntryCapacity
+                * sizeof(*newEntries));
+        if (!newEntries) {
+            return NULL;
+        }
+        table->entries = newEntries;
+        table->entryCapacity = newEntryCapacity;
+    }
+    return &table->entries[table->entryCount++];
+}
+
+static int addSpec(void *cookie, char **fields, size_t fieldCount, unsigned int lineNumber) {
+    struct service_table *table = cookie;
+    // Like label_backends_android.c, only the first two fields matter.
+    if (fieldCount < 2) {
+        errno = EINVAL;
+        return -1;
+    }
+    uint32_t order = table->order++;
+    ssize_t contextIndex = string_pool_add(table->contexts, fields[1], strlen(fields[1]));
+    if (contextIndex == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    size_t nameLength = strlen(fields[0]);
+    size_t nameCount = string_pool_get_count(table->names);
+    ssize_t nameIndex = string_pool_add(table->names, fields[0], nameLength);
+    if (nameIndex == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    const char *name = string_pool_get(table->names, (size_t) nameIndex);
+    uint32_t hash = hashBytes(name, nameLength);
+    if ((size_t) nameIndex < nameCount) {
+        // Same as nodups_specs() in label_backends_android.c, except that we only need to keep the
+        // first one because it always wins.
+        const struct ServiceEntry *entry = isCatchAll(name) ? &table->catchAllEntry
+                : findEntry(table, name, hash);
+        if (entry && entry->contextIndex != (uint32_t) contextIndex) {
+            errno = EINVAL;
+            return -1;
+        }
+        return 0;
+    }
+    struct ServiceEntry *entry;
+    if (isCatchAll(name)) {
+        entry = &table->catchAllEntry;
+        table->hasCatchAllEntry = true;
+    } else {
+        // Keep the load factor at or below one half.
+        if ((table->entryCount + 1) * 2 > table->slotCapacity && !growSlots(table)) {
+            errno = ENOMEM;
+            return -1;
+        }
+        entry = appendEntry(table);
+        if (entry) {
+            size_t mask = table->slotCapacity - 1;
+            size_t slotIndex = hash & mask;
+            while (table->slots[slotIndex]) {
+                slotIndex = (slotIndex + 1) & mask;
+            }
+            table->slots[slotIndex] = (uint32_t) table->entryCount;
+        }
+    }
+    if (!entry) {
+        errno = ENOMEM;
+        return -1;
+    }
+    entry->hash = hash;
+    entry->order = order;
+    entry->contextIndex = (uint32_t) contextIndex;
+    entry->name = name;
+    return 0;
+}
+
+struct service_table *service_table_build(const char *const *specFiles, size_t specFileCount) {
+    struct service_table *table = calloc(1, sizeof(*table));
+    if (!table) {
+        return NULL;
+    }
+    table->names = string_pool_create();
+    table->contexts = string_pool_create();
+    if (!table->names || !table->contexts || !growSlots(table)) {
+        service_table_destroy(table);
+        errno = ENOMEM;
+        return NULL;
+    }
+    for (size_t i = 0; i < specFileCount; ++i) {
+        if (spec_file_for_each_line(specFiles[i], addSpec, table) == -1) {
+            int savedErrno = errno;
+            service_table_destroy(table);
+            errno = savedErrno;
+            return NULL;
+        }
+    }
+    return table;
+}
+
+void service_table_destroy(struct service_table *table) {
+    free(table->slots);
+    free(table->entries);
+    if (table->contexts) {
+        string_pool_destroy(table->contexts);
+    }
+    if (table->names) {
+        string_pool_destroy(table->names);
+    }
+    free(table);
+}
+
+uint32_t service_table_lookup(const struct service_table *table, const char *name) {
+    const struct ServiceEntry *entry = findEntry(table, name, hashBytes(name, strlen(name)));
+    // The catch-all only takes precedence over an exact entry after it.
+    if (table->hasCatchAllEntry && (!entry || table->catchAllEntry.order < entry->order)) {
+        return table->catchAllEntry.contextIndex;
+    }
+    if (!entry) {
+        errno = ENOENT;
+        return SERVICE_TABLE_NO_CONTEXT;
+    }
+    return entry->contextIndex;
+}
+
+uint32_t service_table_get_context_count(const struct service_table *table) {
+    return (uint32_t) string_pool_get_count(table->contexts);
+}
+
+const char *service_table_get_context(const struct service_table *table, uint32_t index) {
+    return string_pool_get(table->contexts, index);
+}
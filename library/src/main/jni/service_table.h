@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_SERVICE_TABLE_H
+#define LIBSELINUX_JNI_SERVICE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// An index over service_contexts, where every entry is an exact service name except for "*". Exact
+// names go into an open addressing hash table, and the first "*" entry is kept aside as the
+// catch-all. The matching rules are the same as lookup_exact_match() in label_backends_android.c:
+// the first entry in file order that is either the name or "*" wins, and there is no other
+// pattern matching, so e.g. "foo*" only matches the service named "foo*".
+struct service_table;
+
+#define SERVICE_TABLE_NO_CONTEXT UINT32_MAX
+
+struct service_table *service_table_build(const char *const *specFiles, size_t specFileCount);
+
+void service_table_destroy(struct service_table *table);
+
+// Returns the index of the context for the service, or SERVICE_TABLE_NO_CONTEXT with errno set.
+uint32_t service_table_lookup(const struct service_table *table, const char *name);
+
+uint32_t service_table_get_context_count(const struct service_table *table);
+
+const char *service_table_get_context(const struct service_table *table, uint32_t index);
+
+#endif // LIBSELINUX_JNI_SERVICE_TABLE_H
@@ -0,0 +1,259 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "sid_table.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "reader_epoch.h"
+
+#define INITIAL_CAPACITY 1024
+
+// The number of slots of the previous table moved over by each insert while rehashing.
+#define REHASH_STEP 64
+
+struct SidEntry {
+    struct security_id sid;
+    uint32_t hash;
+    size_t length;
+    char context[];
+};
+
+struct SidSlots {
+    size_t mask;
+    struct SidEntry *slots[];
+};
+
+struct sid_table {
+    // Lookups search current and then previous, which is non-NULL while rehashing. Slots are
+    // published with release stores, and a finished rehash waits for lookups before freeing
+    // previous.
+    struct SidSlots *current;
+    struct SidSlots *previous;
+    struct reader_epoch readerEpoch;
+
+    // Serializes inserts and rehashing, and guards the fields below.
+    pthread_mutex_t mutex;
+    size_t rehashIndex;
+    size_t count;
+    // Every entry ever added, for destroying them.
+    struct SidEntry **entries;
+    size_t entryCapacity;
+};
+
+static struct SidSlots *newSlots(size_t capacity) {
+    struct SidSlots *slots = calloc(1, sizeof(*slots) + capacity * sizeof(*slots->slots));
+    if (!slots) {
+        return NULL;
+    }
+    slots->mask = capacity - 1;
+    return slots;
+}
+
+struct sid_table *sid_table_create(void) {
+    struct sid_table *table = calloc(1, sizeof(*table));
+    if (!table) {
+        return NULL;
+    }
+    table->current = newSlots(INITIAL_CAPACITY);
+    if (!table->current) {
+        free(table);
+        return NULL;
+    }
+    pthread_mutex_init(&table->mutex, NULL);
+    return table;
+}
+
+void sid_table_destroy(struct sid_table *table) {
+    for (size_t i = 0; i < table->count; ++i) {
+        free(table->entries[i]);
+    }
+    free(table->entries);
+    free(table->previous);
+    free(table->current);
+    pthread_mutex_destroy(&table->mutex);
+    free(table);
+}
+
+static struct SidEntry *findInSlots(const struct SidSlots *slots, const char *context,
+                                    size_t length, uint32_t hash) {
+    for (size_t i = hash & slots->mask; ; i = (i + 1) & slots->mask) {
+        struct SidEntry *entry = __atomic_load_n(&slots->slots[i], __ATOMIC_ACQUIRE);
+        if (!entry) {
+            return NULL;
+        }
+        if (entry->hash == hash && entry->length == length
+                && !memcmp(entry->context, context, length)) {
+            return entry;
+        }
+    }
+}
+
+static void putInSlots(struct SidSlots *slots, struct SidEntry *entry) {
+    size_t i = entry->hash & slots->mask;
+    while (slots->slots[i]) {
+        i = (i + 1) & slots->mask;
+    }
+    __atomic_store_n(&slots->slots[i], entry, __ATOMIC_RELEASE);
+}
+
+static struct SidEntry *findLockFree(struct sid_table *table, const char *context, size_t length,
+                                     uint32_t hash) {
+    unsigned int readerIndex = reader_epoch_enter(&table->readerEpoch);
+    // A context that is being moved is in both tables, and one that was added after we loaded
+    // current is simply missed and found again with the lock held.
+    struct SidSlots *current = __atomic_load_n(&table->current, __ATOMIC_SEQ_CST);
+    struct SidSlots *previous = __atomic_load_n(&table->previous, __ATOMIC_SEQ_CST);
+    struct SidEntry *entry = findInSlots(current, context, length, hash);
+    if (!entry && previous) {
+        entry = findInSlots(previous, context, length, hash);
+    }
+    reader_epoch_leave(&table->readerEpoch, readerIndex);
+    return entry;
+}
+
+// Moves up to REHASH_STEP slots of previous into current, and frees previous once it's empty.
+static void rehashStepLocked(struct sid_table *table, size_t step) {
+    struct SidSlots *previous = table->previous;
+    if (!previous) {
+        return;
+    }
+    size_t capacity = previous->mask + 1;
+    // Compared against the remaining slots, since step may be SIZE_MAX.
+    size_t end = step < capacity - table->rehashIndex ? table->rehashIndex + step : capacity;
+    for (; table->rehashIndex < end; ++table->rehashIndex) {
+        struct SidEntry *entry = previous->slots[table->rehashIndex];
+        if (entry) {
+            putInSlots(table->current, entry);
+        }
+    }
+    if (table->rehashIndex < capacity) {
+        return;
+    }
+    __atomic_store_n(&table->previous, NULL, __ATOMIC_SEQ_CST);
+    reader_epoch_synchronize(&table->readerEpoch);
+    free(previous);
+}
+
+static bool growLocked(struct sid_table *table) {
+    // Keep the load factor of current at or below three quarters, counting the entries it will
+    // receive from previous.
+    size_t capacity = table->current->mask + 1;
+    if ((table->count + 1) * 4 <= capacity * 3) {
+        return true;
+    }
+    // Only one rehash at a time. This is rare, since each insert moves REHASH_STEP slots.
+    rehashStepLocked(table, SIZE_MAX);
+    struct SidSlots *slots = newSlots(capacity * 2);
+    if (!slots) {
+        return false;
+    }
+    table->rehashIndex = 0;
+    __atomic_store_n(&table->previous, table->current, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&table->current, slots, __ATOMIC_SEQ_CST);
+    return true;
+}
+
+int sid_table_context_to_sid(struct sid_table *table, const char *context, security_id_t *sid) {
+    size_t length = strlen(context);
+    uint32_t hash = hashBytes(context, length);
+    struct SidEntry *entry = findLockFree(table, context, length, hash);
+    if (entry) {
+        *sid = &entry->sid;
+        return 0;
+    }
+    pthread_mutex_lock(&table->mutex);
+    entry = findInSlots(table->current, context, length, hash);
+    if (!entry && table->previous) {
+        entry = findInSlots(table->previous, context, length, hash);
+    }
+    if (entry) {
+        pthread_mutex_unlock(&table->mutex);
+        *sid = &entry->sid;
+        return 0;
+    }
+    if (table->count == table->entryCapacity) {
+        size_t newEntryCapacity = table->entryCapacity ? table->entryCapacity * 2 : 256;
+        struct SidEntry **newEntries = realloc(table->entries,
+                                               newEntryCapacity * sizeof(*newEntries));
+        if (!newEntries) {
+            pthread_mutex_unlock(&table->mutex);
+            errno = ENOMEM;
+            return -1;
+        }
+        table->entries = newEntries;
+        table->entryCapacity = newEntryCapacity;
+    }
+    if (!growLocked(table)) {
+        pthread_mutex_unlock(&table->mutex);
+        errno = ENOMEM;
+        return -1;
+    }
+    entry = malloc(sizeof(*entry) + length + 1);
+    if (!entry) {
+        pthread_mutex_unlock(&table->mutex);
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(entry->context, context, length + 1);
+    entry->sid.ctx = entry->context;
+    entry->sid.refcnt = 1;
+    entry->hash = hash;
+    entry->length = length;
+    table->entries[table->count] = entry;
+    __atomic_store_n(&table->count, table->count + 1, __ATOMIC_RELAXED);
+    putInSlots(table->current, entry);
+    rehashStepLocked(table, REHASH_STEP);
+    pthread_mutex_unlock(&table->mutex);
+    *sid = &entry->sid;
+    return 0;
+}
+
+size_t sid_table_get_count(const struct sid_table *table) {
+    return __atomic_load_n(&table->count, __ATOMIC_RELAXED);
+}
+
+static size_t getProbeHistogramIndex(size_t probeCount) {
+    if (probeCount <= 4) {
+        return probeCount - 1;
+    }
+    size_t index = 4;
+    for (size_t limit = 8; probeCount > limit && index < SID_TABLE_PROBE_HISTOGRAM_SIZE - 1;
+            limit *= 2) {
+        ++index;
+    }
+    return index;
+}
+
+// Adds the entries in slots from index start on.
+static void addSlotsStats(const struct SidSlots *slots, size_t start,
+                          struct sid_table_stats *stats) {
+    stats->capacity += slots->mask + 1;
+    for (size_t i = start; i <= slots->mask; ++i) {
+        const struct SidEntry *entry = slots->slots[i];
+        if (entry) {
+            size_t probeCount = ((i - entry->hash) & slots->mask) + 1;
+            ++stats->probe_histogram[getProbeHistogramIndex(probeCount)];
+        }
+    }
+}
+
+void sid_table_get_stats(struct sid_table *table, struct sid_table_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&table->mutex);
+    stats->count = table->count;
+    addSlotsStats(table->current, 0, stats);
+    if (table->previous) {
+        // Entries already moved are only counted where they are now.
+        addSlotsStats(table->previous, table->rehashIndex, stats);
+    }
+    pthread_mutex_unlock(&table->mutex);
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_SID_TABLE_H
+#define LIBSELINUX_JNI_SID_TABLE_H
+
+#include <stddef.h>
+
+#include <selinux/avc.h>
+
+// A replacement for the fixed-size chained table in avc_sidtab.c, for interning the tens of
+// thousands of contexts seen in a scan. It is an open addressing table that grows by incremental
+// rehashing, so no single insert pays for moving everything, and lookups of contexts already in it
+// take no lock. SIDs are never removed, and stay valid until the table is destroyed.
+struct sid_table;
+
+#define SID_TABLE_PROBE_HISTOGRAM_SIZE 8
+
+struct sid_table_stats {
+    size_t count;
+    // The number of slots, including those of the previous table while rehashing.
+    size_t capacity;
+    // The number of entries found after 1, 2, 3, 4, 5-8, 9-16, 17-32 and more probes, which is the
+    // open addressing counterpart of a chain length.
+    size_t probe_histogram[SID_TABLE_PROBE_HISTOGRAM_SIZE];
+};
+
+struct sid_table *sid_table_create(void);
+
+// There must be no concurrent use of the table.
+void sid_table_destroy(struct sid_table *table);
+
+// Returns 0 with the SID for the raw context, adding it if absent, or -1 with errno set.
+int sid_table_context_to_sid(struct sid_table *table, const char *context, security_id_t *sid);
+
+size_t sid_table_get_count(const struct sid_table *table);
+
+// Walks the slots with the lock held, so this is meant for diagnostics rather than frequent calls.
+void sid_table_get_stats(struct sid_table *table, struct sid_table_stats *stats);
+
+#endif // LIBSELINUX_JNI_SID_TABLE_H
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "spec_file.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+int spec_file_for_each_line(const char *path, spec_file_line_callback callback, void *cookie) {
+    FILE *file = fopen(path, "re");
+    if (!file) {
+        return -1;
+    }
+    int result = 0;
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    unsigned int lineNumber = 0;
+    while (getline(&line, &lineCapacity, file) != -1) {
+        ++lineNumber;
+        char *fields[SPEC_FILE_MAX_FIELDS];
+        size_t fieldCount = 0;
+        char *lineChar = line;
+        for (;;) {
+            while (*lineChar && isspace((unsigned char) *lineChar)) {
+                ++lineChar;
+            }
+            if (!*lineChar || (!fieldCount && *lineChar == '#')) {
+                break;
+            }
+            if (fieldCount == SPEC_FILE_MAX_FIELDS) {
+                errno = EINVAL;
+                result = -1;
+                break;
+            }
+            fields[fieldCount++] = lineChar;
+            while (*lineChar && !isspace((unsigned char) *lineChar)) {
+                ++lineChar;
+            }
+            if (*lineChar) {
+                *lineChar++ = '\0';
+            }
+        }
+        if (result || (fieldCount && callback(cookie, fields, fieldCount, lineNumber) == -1)) {
+            result = -1;
+            break;
+        }
+    }
+    if (!result && ferror(file)) {
+        errno = EIO;
+        result = -1;
+    }
+    free(line);
+    fclose(file);
+    return result;
+}
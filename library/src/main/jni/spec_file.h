@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_SPEC_FILE_H
+#define LIBSELINUX_JNI_SPEC_FILE_H
+
+#include <stddef.h>
+
+#define SPEC_FILE_MAX_FIELDS 16
+
+// Called with the whitespace separated fields of a line, which may be modified. Returns 0 to
+// continue, or -1 with errno set to stop.
+typedef int (*spec_file_line_callback)(void *cookie, char **fields, size_t fieldCount,
+                                       unsigned int lineNumber);
+
+// Calls the callback for each line of a spec file that isn't empty or a comment, like
+// read_spec_entries() in label_support.c. Returns 0 on success, or -1 with errno set.
+int spec_file_for_each_line(const char *path, spec_file_line_callback callback, void *cookie);
+
+#endif // LIBSELINUX_JNI_SPEC_FILE_H
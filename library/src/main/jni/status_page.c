@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "status_page.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <linux/netlink.h>
+#include <linux/selinux_netlink.h>
+
+#include <selinux/selinux.h>
+
+#include "selinuxfs.h"
+
+// The same as struct selinux_kernel_status in the kernel, where sequence is odd while the kernel
+// is updating the page.
+struct KernelStatus {
+    uint32_t version;
+    uint32_t sequence;
+    uint32_t enforcing;
+    uint32_t policyload;
+    uint32_t deny_unknown;
+} __attribute__((packed));
+
+static pthread_once_t openOnce = PTHREAD_ONCE_INIT;
+static const struct KernelStatus *kernelStatus;
+static int openErrno;
+
+// The netlink fallback, guarded by netlinkMutex. The AVC owns the socket of avc_netlink_open(),
+// so we have our own.
+static pthread_mutex_t netlinkMutex = PTHREAD_MUTEX_INITIALIZER;
+static int netlinkFd = -1;
+static struct status_page_state netlinkState;
+
+static const struct KernelStatus *mapKernelStatus(void) {
+    int fd = selinuxfs_open("status", O_RDONLY);
+    if (fd == -1) {
+        return NULL;
+    }
+    void *page = mmap(NULL, (size_t) sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED, fd, 0);
+    int savedErrno = errno;
+    close(fd);
+    if (page == MAP_FAILED) {
+        errno = savedErrno;
+        return NULL;
+    }
+    const struct KernelStatus *status = page;
+    if (status->version < 1) {
+        munmap(page, (size_t) sysconf(_SC_PAGESIZE));
+        errno = ENOTSUP;
+        return NULL;
+    }
+    return status;
+}
+
+static int openNetlink(void) {
+    int fd = socket(PF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_SELINUX);
+    if (fd == -1) {
+        return -1;
+    }
+    struct sockaddr_nl address = {
+            .nl_family = AF_NETLINK,
+            .nl_groups = SELNL_GRP_AVC
+    };
+    if (bind(fd, (struct sockaddr *) &address, sizeof(address))) {
+        int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return -1;
+    }
+    return fd;
+}
+
+// Like security_deny_unknown(), which isn't part of our build.
+static bool readDenyUnknown(void) {
+    int fd = selinuxfs_open("deny_unknown", O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    char value;
+    ssize_t length = TEMP_FAILURE_RETRY(read(fd, &value, sizeof(value)));
+    close(fd);
+    return length == 1 && value == '1';
+}
+
+// Re-reads what the notifications don't carry, or may have been dropped. Must be called with
+// netlinkMutex held, or from openStatus().
+static void refreshNetlinkStateLocked(bool refreshEnforcing) {
+    if (refreshEnforcing) {
+        int enforcing = security_getenforce();
+        if (enforcing != -1) {
+            netlinkState.enforcing = enforcing != 0;
+        }
+    }
+    netlinkState.deny_unknown = readDenyUnknown();
+}
+
+static void openStatus(void) {
+    kernelStatus = mapKernelStatus();
+    if (kernelStatus) {
+        return;
+    }
+    netlinkFd = openNetlink();
+    if (netlinkFd == -1) {
+        openErrno = errno;
+        return;
+    }
+    // Read after binding, so that no change in between is missed.
+    refreshNetlinkStateLocked(true);
+}
+
+static void readKernelStatus(struct status_page_state *state) {
+    uint32_t sequence;
+    do {
+        while ((sequence = __atomic_load_n(&kernelStatus->sequence, __ATOMIC_ACQUIRE)) & 1) {
+            sched_yield();
+        }
+        state->enforcing = __atomic_load_n(&kernelStatus->enforcing, __ATOMIC_RELAXED) != 0;
+        state->policyload = __atomic_load_n(&kernelStatus->policyload, __ATOMIC_RELAXED);
+        state->deny_unknown = __atomic_load_n(&kernelStatus->deny_unknown, __ATOMIC_RELAXED) != 0;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while (__atomic_load_n(&kernelStatus->sequence, __ATOMIC_RELAXED) != sequence);
+    state->sequence = sequence;
+}
+
+// Applies the pending notifications to netlinkState, like avc_netlink_check_nb() does for the AVC.
+static void drainNetlinkLocked(void) {
+    char buffer[1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+    while (true) {
+        ssize_t length = TEMP_FAILURE_RETRY(recv(netlinkFd, buffer, sizeof(buffer), 0));
+        if (length == -1) {
+            if (errno == ENOBUFS) {
+                // Notifications were dropped, so assume anything might have changed.
+                refreshNetlinkStateLocked(true);
+                netlinkState.sequence += 2;
+                ++netlinkState.policyload;
+                continue;
+            }
+            break;
+        }
+        if (!length) {
+            break;
+        }
+        size_t remainingLength = (size_t) length;
+        for (const struct nlmsghdr *header = (const struct nlmsghdr *) buffer;
+                NLMSG_OK(header, remainingLength);
+                header = NLMSG_NEXT(header, remainingLength)) {
+            switch (header->nlmsg_type) {
+                case SELNL_MSG_SETENFORCE: {
+                    const struct selnl_msg_setenforce *message = NLMSG_DATA(header);
+                    netlinkState.enforcing = message->val != 0;
+                    netlinkState.sequence += 2;
+                    break;
+                }
+                case SELNL_MSG_POLICYLOAD: {
+                    const struct selnl_msg_policyload *message = NLMSG_DATA(header);
+                    netlinkState.policyload = message->seqno;
+                    // The new policy may handle unknown classes and permissions differently.
+                    refreshNetlinkStateLocked(false);
+                    netlinkState.sequence += 2;
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+int status_page_read(struct status_page_state *state) {
+    pthread_once(&openOnce, openStatus);
+    if (kernelStatus) {
+        readKernelStatus(state);
+        return 0;
+    }
+    if (netlinkFd == -1) {
+        errno = openErrno;
+        return -1;
+    }
+    pthread_mutex_lock(&netlinkMutex);
+    drainNetlinkLocked();
+    *state = netlinkState;
+    pthread_mutex_unlock(&netlinkMutex);
+    return 0;
+}
+
+bool status_page_policy_changed(uint32_t *policyload) {
+    struct status_page_state state;
+    if (status_page_read(&state)) {
+        return true;
+    }
+    bool changed = state.policyload != *policyload;
+    *policyload = state.policyload;
+    return changed;
+}
@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_STATUS_PAGE_H
+#define LIBSELINUX_JNI_STATUS_PAGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The kernel status from the status page of selinuxfs, which is mapped once and then read without
+// any system call. If the page is unavailable, a netlink socket is drained instead, which costs a
+// recv() per read.
+
+struct status_page_state {
+    // Changes whenever anything below does.
+    uint32_t sequence;
+    bool enforcing;
+    // The number of policy loads, only ever compared for changes.
+    uint32_t policyload;
+    bool deny_unknown;
+};
+
+// Reads the current kernel status. Returns 0 on success, or -1 with errno set if neither the status
+// page nor netlink is available.
+int status_page_read(struct status_page_state *state);
+
+// Returns whether a policy was loaded since policyload was read, and updates it. Returns true if
+// the status can't be read, so that callers err on the side of invalidating.
+bool status_page_policy_changed(uint32_t *policyload);
+
+#endif // LIBSELINUX_JNI_STATUS_PAGE_H
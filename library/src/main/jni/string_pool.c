@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "string_pool.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+
+#define CHUNK_SIZE 16384
+
+struct Chunk {
+    char *bytes;
+    size_t size;
+    size_t capacity;
+};
+
+struct PooledString {
+    const char *string;
+    size_t length;
+    uint32_t hash;
+};
+
+struct string_pool {
+    struct Chunk *chunks;
+    size_t chunkCount;
+    size_t chunkCapacity;
+    struct PooledString *strings;
+    size_t stringCount;
+    size_t stringCapacity;
+    // Open addressing with linear probing over index + 1, with 0 for an empty slot.
+    size_t *table;
+    size_t tableCapacity;
+};
+
+struct string_pool *string_pool_create(void) {
+    return calloc(1, sizeof(struct string_pool));
+}
+
+void string_pool_destroy(struct string_pool *pool) {
+    for (size_t i = 0; i < pool->chunkCount; ++i) {
+        free(pool->chunks[i].bytes);
+    }
+    free(pool->chunks);
+    free(pool->strings);
+    free(pool->table);
+    free(pool);
+}
+
+static size_t *findTableSlot(const struct string_pool *pool, const char *string, size_t length,
+                             uint32_t hash) {
+    size_t mask = pool->tableCapacity - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        size_t *slot = &pool->table[i];
+        if (!*slot) {
+            return slot;
+        }
+        const struct PooledString *pooledString = &pool->strings[*slot - 1];
+        if (pooledString->hash == hash && pooledString->length == length
+                && !memcmp(pooledString->string, string, length)) {
+            return slot;
+        }
+    }
+}
+
+static bool growTable(struct string_pool *pool) {
+    if ((pool->stringCount + 1) * 4 <= pool->tableCapacity * 3) {
+        return true;
+    }
+    size_t newTableCapacity = pool->tableCapacity ? pool->tableCapacity * 2 : 64;
+    size_t *newTable = calloc(newTableCapacity, sizeof(*newTable));
+    if (!newTable) {
+        return false;
+    }
+    size_t newMask = newTableCapacity - 1;
+    for (size_t i = 0; i < pool->stringCount; ++i) {
+        size_t j = pool->strings[i].hash & newMask;
+        while (newTable[j]) {
+            j = (j + 1) & newMask;
+        }
+        newTable[j] = i + 1;
+    }
+    free(pool->table);
+    pool->table = newTable;
+    pool->tableCapacity = newTableCapacity;
+    return true;
+}
+
+static char *allocateInChunk(struct string_pool *pool, size_t size) {
+    struct Chunk *chunk = pool->chunkCount ? &pool->chunks[pool->chunkCount - 1] : NULL;
+    if (!chunk || chunk->capacity - chunk->size < size) {
+        if (pool->chunkCount == pool->chunkCapacity) {
+            size_t newChunkCapacity = pool->chunkCapacity ? pool->chunkCapacity * 2 : 8;
+            struct Chunk *newChunks = realloc(pool->chunks,
+                                              newChunkCapacity * sizeof(*newChunks));
+            if (!newChunks) {
+                return NULL;
+            }
+            pool->chunks = newChunks;
+            pool->chunkCapacity = newChunkCapacity;
+        }
+        size_t capacity = size > CHUNK_SIZE ? size : CHUNK_SIZE;
+        char *bytes = malloc(capacity);
+        if (!bytes) {
+            return NULL;
+        }
+        chunk = &pool->chunks[pool->chunkCount++];
+        chunk->bytes = bytes;
+        chunk->size = 0;
+        chunk->capacity = capacity;
+    }
+    char *bytes = chunk->bytes + chunk->size;
+    chunk->size += size;
+    return bytes;
+}
+
+ssize_t string_pool_add(struct string_pool *pool, const char *string, size_t length) {
+    uint32_t hash = hashBytes(string, length);
+    if (pool->tableCapacity) {
+        size_t *slot = findTableSlot(pool, string, length, hash);
+        if (*slot) {
+            return (ssize_t) (*slot - 1);
+        }
+    }
+    if (!growTable(pool)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (pool->stringCount == pool->stringCapacity) {
+        size_t newStringCapacity = pool->stringCapacity ? pool->stringCapacity * 2 : 64;
+        struct PooledString *newStrings = realloc(pool->strings,
+                                                  newStringCapacity * sizeof(*newStrings));
+        if (!newStrings) {
+            errno = ENOMEM;
+            return -1;
+        }
+        pool->strings = newStrings;
+        pool->stringCapacity = newStringCapacity;
+    }
+    char *pooledBytes = allocateInChunk(pool, length + 1);
+    if (!pooledBytes) {
+        errno = ENOMEM;
+        return -1;
+    }
+    memcpy(pooledBytes, string, length);
+    pooledBytes[length] = '\0';
+    size_t index = pool->stringCount++;
+    struct PooledString *pooledString = &pool->strings[index];
+    pooledString->string = pooledBytes;
+    pooledString->length = length;
+    pooledString->hash = hash;
+    *findTableSlot(pool, string, length, hash) = index + 1;
+    return (ssize_t) index;
+}
+
+ssize_t string_pool_find(const struct string_pool *pool, const char *string, size_t length) {
+    if (!pool->tableCapacity) {
+        return -1;
+    }
+    size_t *slot = findTableSlot(pool, string, length, hashBytes(string, length));
+    return *slot ? (ssize_t) (*slot - 1) : -1;
+}
+
+const char *string_pool_get(const struct string_pool *pool, size_t index) {
+    return pool->strings[index].string;
+}
+
+size_t string_pool_get_length(const struct string_pool *pool, size_t index) {
+    return pool->strings[index].length;
+}
+
+size_t string_pool_get_count(const struct string_pool *pool) {
+    return pool->stringCount;
+}
+
+bool string_pool_contains(const struct string_pool *pool, const void *pointer) {
+    const char *pointerChars = pointer;
+    for (size_t i = 0; i < pool->chunkCount; ++i) {
+        const struct Chunk *chunk = &pool->chunks[i];
+        if (pointerChars >= chunk->bytes && pointerChars < chunk->bytes + chunk->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t string_pool_get_footprint(const struct string_pool *pool) {
+    size_t footprint = sizeof(*pool) + pool->chunkCapacity * sizeof(*pool->chunks)
+            + pool->stringCapacity * sizeof(*pool->strings)
+            + pool->tableCapacity * sizeof(*pool->table);
+    for (size_t i = 0; i < pool->chunkCount; ++i) {
+        footprint += pool->chunks[i].capacity;
+    }
+    return footprint;
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_STRING_POOL_H
+#define LIBSELINUX_JNI_STRING_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// A pool of unique, immutable strings packed into large chunks. Strings are never removed, so both
+// their pointers and their indices stay valid until the pool is destroyed. Not thread-safe.
+struct string_pool;
+
+struct string_pool *string_pool_create(void);
+
+void string_pool_destroy(struct string_pool *pool);
+
+// Returns the index of the pooled copy of the string, adding it if absent, or -1 if out of memory.
+ssize_t string_pool_add(struct string_pool *pool, const char *string, size_t length);
+
+// Returns the index of the pooled copy of the string, or -1 if absent.
+ssize_t string_pool_find(const struct string_pool *pool, const char *string, size_t length);
+
+const char *string_pool_get(const struct string_pool *pool, size_t index);
+
+size_t string_pool_get_length(const struct string_pool *pool, size_t index);
+
+size_t string_pool_get_count(const struct string_pool *pool);
+
+// Returns whether the pointer points into a string owned by the pool.
+bool string_pool_contains(const struct string_pool *pool, const void *pointer);
+
+// Returns the number of bytes allocated for the pool.
+size_t string_pool_get_footprint(const struct string_pool *pool);
+
+#endif // LIBSELINUX_JNI_STRING_POOL_H
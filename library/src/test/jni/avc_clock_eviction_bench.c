@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Replays a hot working set of a quarter of the default front cache capacity, interleaved with a
+// scan of tuples that are each queried only once. New entries start unreferenced and hot ones keep
+// their reference bit set, so CLOCK should evict the scan and keep the hot set, one eviction per
+// miss. Checks every decision against the made-up policy.
+//
+// Usage: avc_clock_eviction_bench [round count]
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "avc_query.h"
+#include "bench.h"
+#include "fake_selinux.h"
+
+#define HOT_TUPLE_COUNT 128
+#define SCAN_BATCH_SIZE 64
+#define SCAN_SOURCE_COUNT 256
+#define SCAN_TARGET_COUNT 256
+#define MIN_HOT_HIT_PERCENT 95
+
+struct Batch {
+    security_id_t sourceSids[HOT_TUPLE_COUNT];
+    security_id_t targetSids[HOT_TUPLE_COUNT];
+    security_class_t targetClasses[HOT_TUPLE_COUNT];
+    access_vector_t requestedPermissions[HOT_TUPLE_COUNT];
+    uint64_t decisions[HOT_TUPLE_COUNT / 64];
+    size_t count;
+};
+
+static uint64_t nextRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static security_id_t getSid(const char *format, unsigned int index) {
+    char context[64];
+    snprintf(context, sizeof(context), format, index);
+    security_id_t sid;
+    CHECK(!avc_query_context_to_sid(context, &sid));
+    return sid;
+}
+
+static void addTuple(struct Batch *batch, security_id_t sourceSid, security_id_t targetSid,
+                     security_class_t targetClass) {
+    size_t index = batch->count++;
+    batch->sourceSids[index] = sourceSid;
+    batch->targetSids[index] = targetSid;
+    batch->targetClasses[index] = targetClass;
+    // Ask for the lowest allowed permission, so that each tuple always gets the same answer.
+    access_vector_t allowed = fake_selinux_get_allowed(sourceSid, targetSid, targetClass);
+    batch->requestedPermissions[index] = allowed ? allowed & -allowed : 1;
+}
+
+static void swapTuples(struct Batch *batch, size_t i, size_t j) {
+    security_id_t sourceSid = batch->sourceSids[i];
+    batch->sourceSids[i] = batch->sourceSids[j];
+    batch->sourceSids[j] = sourceSid;
+    security_id_t targetSid = batch->targetSids[i];
+    batch->targetSids[i] = batch->targetSids[j];
+    batch->targetSids[j] = targetSid;
+    security_class_t targetClass = batch->targetClasses[i];
+    batch->targetClasses[i] = batch->targetClasses[j];
+    batch->targetClasses[j] = targetClass;
+    access_vector_t requestedPermission = batch->requestedPermissions[i];
+    batch->requestedPermissions[i] = batch->requestedPermissions[j];
+    batch->requestedPermissions[j] = requestedPermission;
+}
+
+static void queryBatch(struct Batch *batch) {
+    CHECK(!avc_query_has_perm_batch(batch->sourceSids, batch->targetSids, batch->targetClasses,
+                                    batch->requestedPermissions, batch->count, batch->decisions));
+    for (size_t i = 0; i < batch->count; ++i) {
+        access_vector_t allowed = fake_selinux_get_allowed(batch->sourceSids[i],
+                                                           batch->targetSids[i],
+                                                           batch->targetClasses[i]);
+        bool expected = !(batch->requestedPermissions[i] & ~allowed);
+        CHECK(!!(batch->decisions[i / 64] & UINT64_C(1) << i % 64) == expected);
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long roundCount = getCountArgument(argc, argv, 1, 1000);
+    CHECK(roundCount <= (unsigned long) SCAN_SOURCE_COUNT * SCAN_TARGET_COUNT
+            * FAKE_SELINUX_CLASS_COUNT / SCAN_BATCH_SIZE);
+    CHECK(!avc_query_open(NULL, 0));
+    security_id_t scanSourceSids[SCAN_SOURCE_COUNT];
+    for (unsigned int i = 0; i < SCAN_SOURCE_COUNT; ++i) {
+        scanSourceSids[i] = getSid("u:r:scan_source_%u:s0", i);
+    }
+    security_id_t scanTargetSids[SCAN_TARGET_COUNT];
+    for (unsigned int i = 0; i < SCAN_TARGET_COUNT; ++i) {
+        scanTargetSids[i] = getSid("u:object_r:scan_target_%u:s0", i);
+    }
+    struct Batch hotBatch = { .count = 0 };
+    for (unsigned int i = 0; i < HOT_TUPLE_COUNT; ++i) {
+        addTuple(&hotBatch, getSid("u:r:hot_source_%u:s0", i % 16),
+                 getSid("u:object_r:hot_target_%u:s0", i / 16), (security_class_t) (i % 4 + 1));
+    }
+    queryBatch(&hotBatch);
+
+    struct avc_query_cache_stats stats;
+    avc_query_get_cache_stats(&stats);
+    uint64_t hotLookups = 0;
+    uint64_t hotHits = 0;
+    uint64_t scanNanos = 0;
+    uint64_t random = UINT64_C(0x9e3779b97f4a7c15);
+    unsigned long scanIndex = 0;
+    for (unsigned long i = 0; i < roundCount; ++i) {
+        // Shuffle the hot set, so that its order within a set doesn't line up with the hand.
+        for (size_t j = HOT_TUPLE_COUNT - 1; j > 0; --j) {
+            size_t k = nextRandom(&random) % (j + 1);
+            swapTuples(&hotBatch, j, k);
+        }
+        struct avc_query_cache_stats hotStats;
+        avc_query_get_cache_stats(&hotStats);
+        queryBatch(&hotBatch);
+        struct avc_query_cache_stats newHotStats;
+        avc_query_get_cache_stats(&newHotStats);
+        hotLookups += newHotStats.lookups - hotStats.lookups;
+        hotHits += newHotStats.hits - hotStats.hits;
+
+        struct Batch scanBatch = { .count = 0 };
+        for (size_t j = 0; j < SCAN_BATCH_SIZE; ++j, ++scanIndex) {
+            addTuple(&scanBatch, scanSourceSids[scanIndex % SCAN_SOURCE_COUNT],
+                     scanTargetSids[scanIndex / SCAN_SOURCE_COUNT % SCAN_TARGET_COUNT],
+                     (security_class_t) (scanIndex / (SCAN_SOURCE_COUNT * SCAN_TARGET_COUNT)
+                             + 1));
+        }
+        uint64_t startNanos = getNanos();
+        queryBatch(&scanBatch);
+        scanNanos += getNanos() - startNanos;
+    }
+    struct avc_query_cache_stats newStats;
+    avc_query_get_cache_stats(&newStats);
+    uint64_t misses = newStats.misses - stats.misses;
+    uint64_t evictions = newStats.evictions - stats.evictions;
+    double hotHitPercent = (double) hotHits * 100 / (double) hotLookups;
+    printf("capacity %zu, hot set %d, scan %lu\n", newStats.capacity, HOT_TUPLE_COUNT,
+           roundCount * SCAN_BATCH_SIZE);
+    printf("hot hits %.2f%%, %" PRIu64 " misses, %" PRIu64 " evictions, %.0f ns per scan miss\n",
+           hotHitPercent, misses, evictions,
+           (double) scanNanos / (double) (roundCount * SCAN_BATCH_SIZE));
+    CHECK(evictions <= misses);
+    CHECK(hotHitPercent >= MIN_HOT_HIT_PERCENT);
+    avc_query_close();
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Measures avc_query_has_perm_batch() on 1 to 16 threads over a working set that fits the front
+// cache, and checks every decision against the made-up policy. Hits take no lock, so throughput
+// should grow with the threads, while the AVC only sees the first miss of each tuple.
+//
+// Usage: avc_front_cache_bench [batch count per thread]
+
+#include <stdio.h>
+
+#include "avc_query.h"
+#include "bench.h"
+#include "fake_selinux.h"
+
+#define SOURCE_COUNT 16
+#define TARGET_COUNT 16
+#define CLASS_COUNT 4
+#define BATCH_SIZE 256
+#define CACHE_THRESHOLD 8192
+
+struct Workload {
+    security_id_t sourceSids[SOURCE_COUNT];
+    security_id_t targetSids[TARGET_COUNT];
+    unsigned long batchCount;
+    // Whether to check every batch rather than only the last one, which would dominate the time.
+    bool checkAll;
+};
+
+static uint64_t nextRandom(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static void runBatches(void *argument, unsigned int threadIndex) {
+    const struct Workload *workload = argument;
+    security_id_t sourceSids[BATCH_SIZE];
+    security_id_t targetSids[BATCH_SIZE];
+    security_class_t targetClasses[BATCH_SIZE];
+    access_vector_t requestedPermissions[BATCH_SIZE];
+    uint64_t decisions[BATCH_SIZE / 64];
+    uint64_t random = UINT64_C(0x9e3779b97f4a7c15) * (threadIndex + 1);
+    for (unsigned long i = 0; i < workload->batchCount; ++i) {
+        for (size_t j = 0; j < BATCH_SIZE; ++j) {
+            uint64_t value = nextRandom(&random);
+            sourceSids[j] = workload->sourceSids[value % SOURCE_COUNT];
+            targetSids[j] = workload->targetSids[value / SOURCE_COUNT % TARGET_COUNT];
+            targetClasses[j] = (security_class_t) (value / (SOURCE_COUNT * TARGET_COUNT)
+                    % CLASS_COUNT + 1);
+            requestedPermissions[j] = (access_vector_t) 1 << (value >> 32) % 32;
+        }
+        CHECK(!avc_query_has_perm_batch(sourceSids, targetSids, targetClasses,
+                                        requestedPermissions, BATCH_SIZE, decisions));
+        if (!workload->checkAll && i + 1 < workload->batchCount) {
+            continue;
+        }
+        for (size_t j = 0; j < BATCH_SIZE; ++j) {
+            access_vector_t allowed = fake_selinux_get_allowed(sourceSids[j], targetSids[j],
+                                                               targetClasses[j]);
+            bool expected = !(requestedPermissions[j] & ~allowed);
+            CHECK(!!(decisions[j / 64] & UINT64_C(1) << j % 64) == expected);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    struct Workload workload;
+    workload.batchCount = getCountArgument(argc, argv, 1, 2000);
+    CHECK(!avc_query_open(NULL, 0));
+    CHECK(!avc_query_set_cache_threshold(CACHE_THRESHOLD));
+    char context[64];
+    for (int i = 0; i < SOURCE_COUNT; ++i) {
+        snprintf(context, sizeof(context), "u:r:source_%d:s0", i);
+        CHECK(!avc_query_context_to_sid(context, &workload.sourceSids[i]));
+    }
+    for (int i = 0; i < TARGET_COUNT; ++i) {
+        snprintf(context, sizeof(context), "u:object_r:target_%d:s0", i);
+        CHECK(!avc_query_context_to_sid(context, &workload.targetSids[i]));
+    }
+    // Warm up, so that every run only measures hits.
+    workload.checkAll = true;
+    runBatches(&workload, 0);
+    workload.checkAll = false;
+    unsigned long tupleCount = SOURCE_COUNT * TARGET_COUNT * CLASS_COUNT;
+    // A tuple misses once when first allowed, and once more when first denied.
+    CHECK(fake_selinux_get_avc_query_count() <= 2 * tupleCount);
+    for (unsigned int threadCount = 1; threadCount <= BENCH_MAX_THREAD_COUNT; threadCount *= 2) {
+        struct avc_query_cache_stats stats;
+        avc_query_get_cache_stats(&stats);
+        unsigned long avcQueryCount = fake_selinux_get_avc_query_count();
+        uint64_t nanos = runThreads(threadCount, runBatches, &workload);
+        struct avc_query_cache_stats newStats;
+        avc_query_get_cache_stats(&newStats);
+        uint64_t lookups = newStats.lookups - stats.lookups;
+        uint64_t hits = newStats.hits - stats.hits;
+        printf("%2u threads: %8.2f M queries/s, %6.2f%% hits, %lu AVC queries\n", threadCount,
+               (double) lookups * 1000 / (double) nanos, (double) hits * 100 / (double) lookups,
+               fake_selinux_get_avc_query_count() - avcQueryCount);
+    }
+    avc_query_close();
+    return 0;
+}
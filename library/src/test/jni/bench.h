@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_TEST_BENCH_H
+#define LIBSELINUX_JNI_TEST_BENCH_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define BENCH_MAX_THREAD_COUNT 16
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            exit(EXIT_FAILURE); \
+        } \
+    } while (0)
+
+static inline uint64_t getNanos(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
+
+// Returns argv[index] as a positive count, or defaultCount if absent.
+static inline unsigned long getCountArgument(int argc, char **argv, int index,
+                                             unsigned long defaultCount) {
+    if (argc <= index) {
+        return defaultCount;
+    }
+    char *end;
+    unsigned long count = strtoul(argv[index], &end, 10);
+    if (*end || !count) {
+        fprintf(stderr, "Invalid count: %s\n", argv[index]);
+        exit(EXIT_FAILURE);
+    }
+    return count;
+}
+
+struct BenchThread {
+    void (*run)(void *, unsigned int);
+    void *argument;
+    unsigned int threadIndex;
+};
+
+static inline void *runBenchThread(void *argument) {
+    struct BenchThread *thread = argument;
+    thread->run(thread->argument, thread->threadIndex);
+    return NULL;
+}
+
+// Runs run(argument, threadIndex) on threadCount threads at once, and returns the nanoseconds from
+// starting the first one to the last one finishing.
+static inline uint64_t runThreads(unsigned int threadCount, void (*run)(void *, unsigned int),
+                                  void *argument) {
+    struct BenchThread threads[BENCH_MAX_THREAD_COUNT];
+    pthread_t pthreads[BENCH_MAX_THREAD_COUNT];
+    CHECK(threadCount <= BENCH_MAX_THREAD_COUNT);
+    uint64_t startNanos = getNanos();
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        threads[i].run = run;
+        threads[i].argument = argument;
+        threads[i].threadIndex = i;
+        CHECK(!pthread_create(&pthreads[i], NULL, runBenchThread, &threads[i]));
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        CHECK(!pthread_join(pthreads[i], NULL));
+    }
+    return getNanos() - startNanos;
+}
+
+#endif // LIBSELINUX_JNI_TEST_BENCH_H
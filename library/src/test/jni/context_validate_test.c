@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Validates a batch of contexts with many duplicates, and checks that each unique context reaches
+// selinuxfs once, that policy loads and flushes make them reach it again, including when they
+// happen in the middle of a check, and that answers stay right while flushes race with batches.
+//
+// Usage: context_validate_test [context count] [unique context count]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "context_validate.h"
+#include "fake_selinux.h"
+#include "fake_selinuxfs.h"
+
+#define RACE_THREAD_COUNT 4
+#define RACE_BATCH_COUNT 20
+
+struct Contexts {
+    char **contexts;
+    size_t count;
+    uint64_t *results;
+};
+
+static unsigned int racingValidatorCount;
+
+// Every third unique context is invalid, since the fake context node only accepts "u:".
+static bool isValid(size_t index, size_t uniqueCount) {
+    return index % uniqueCount % 3;
+}
+
+static void validateAll(struct Contexts *contexts, size_t uniqueCount, uint64_t *results) {
+    CHECK(!selinux_validate_batch((const char *const *) contexts->contexts, contexts->count,
+                                  results));
+    for (size_t i = 0; i < contexts->count; ++i) {
+        CHECK(!!(results[i / 64] & UINT64_C(1) << i % 64) == isValid(i, uniqueCount));
+    }
+}
+
+static unsigned long countTransactions(struct Contexts *contexts, size_t uniqueCount) {
+    unsigned long transactionCount = fake_selinuxfs_get_transaction_count();
+    validateAll(contexts, uniqueCount, contexts->results);
+    return fake_selinuxfs_get_transaction_count() - transactionCount;
+}
+
+static void flushInTransaction(void) {
+    fake_selinuxfs_set_transaction_hook(NULL);
+    selinux_validate_cache_flush();
+}
+
+static void loadPolicyInTransaction(void) {
+    fake_selinuxfs_set_transaction_hook(NULL);
+    fake_selinux_load_policy();
+}
+
+// Checks that a context checked while the hook runs doesn't keep an answer from before it.
+static void checkRace(const char *context, void (*hook)(void)) {
+    fake_selinuxfs_set_transaction_hook(hook);
+    unsigned long transactionCount = fake_selinuxfs_get_transaction_count();
+    CHECK(!selinux_validate_cached(context));
+    CHECK(fake_selinuxfs_get_transaction_count() == transactionCount + 1);
+    CHECK(!selinux_validate_cached(context));
+    CHECK(fake_selinuxfs_get_transaction_count() == transactionCount + 2);
+    CHECK(!selinux_validate_cached(context));
+    CHECK(fake_selinuxfs_get_transaction_count() == transactionCount + 2);
+}
+
+struct RaceTest {
+    struct Contexts *contexts;
+    size_t uniqueCount;
+};
+
+static void runRaceThread(void *argument, unsigned int threadIndex) {
+    struct RaceTest *test = argument;
+    if (!threadIndex) {
+        while (__atomic_load_n(&racingValidatorCount, __ATOMIC_ACQUIRE)) {
+            selinux_validate_cache_flush();
+        }
+        return;
+    }
+    uint64_t *results = malloc((test->contexts->count + 63) / 64 * sizeof(*results));
+    CHECK(results);
+    for (int i = 0; i < RACE_BATCH_COUNT; ++i) {
+        validateAll(test->contexts, test->uniqueCount, results);
+    }
+    free(results);
+    __atomic_fetch_sub(&racingValidatorCount, 1, __ATOMIC_RELEASE);
+}
+
+int main(int argc, char **argv) {
+    struct Contexts contexts;
+    contexts.count = getCountArgument(argc, argv, 1, 50000);
+    size_t uniqueCount = getCountArgument(argc, argv, 2, 1000);
+    CHECK(uniqueCount <= contexts.count);
+    contexts.contexts = malloc(contexts.count * sizeof(*contexts.contexts));
+    contexts.results = malloc((contexts.count + 63) / 64 * sizeof(*contexts.results));
+    CHECK(contexts.contexts && contexts.results);
+    for (size_t i = 0; i < contexts.count; ++i) {
+        CHECK(asprintf(&contexts.contexts[i], "%s:type_%zu:s0",
+                       isValid(i, uniqueCount) ? "u:r" : "x:r", i % uniqueCount) != -1);
+    }
+
+    CHECK(countTransactions(&contexts, uniqueCount) == uniqueCount);
+    CHECK(countTransactions(&contexts, uniqueCount) == 0);
+    unsigned long transactionCount = fake_selinuxfs_get_transaction_count();
+    CHECK(!selinux_validate_cached(contexts.contexts[1]));
+    CHECK(fake_selinuxfs_get_transaction_count() == transactionCount);
+
+    fake_selinux_load_policy();
+    CHECK(countTransactions(&contexts, uniqueCount) == uniqueCount);
+    selinux_validate_cache_flush();
+    CHECK(countTransactions(&contexts, uniqueCount) == uniqueCount);
+    CHECK(countTransactions(&contexts, uniqueCount) == 0);
+
+    checkRace("u:r:flush_race:s0", flushInTransaction);
+    checkRace("u:r:policy_load_race:s0", loadPolicyInTransaction);
+
+    struct RaceTest raceTest = { &contexts, uniqueCount };
+    racingValidatorCount = RACE_THREAD_COUNT;
+    runThreads(RACE_THREAD_COUNT + 1, runRaceThread, &raceTest);
+    printf("%zu contexts, %zu unique, %lu transactions\n", contexts.count, uniqueCount,
+           fake_selinuxfs_get_transaction_count());
+
+    for (size_t i = 0; i < contexts.count; ++i) {
+        free(contexts.contexts[i]);
+    }
+    free(contexts.contexts);
+    free(contexts.results);
+    return 0;
+}
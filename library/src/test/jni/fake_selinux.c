@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "fake_selinux.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "class_map.h"
+#include "fake_selinuxfs.h"
+#include "hash.h"
+
+static pthread_mutex_t callbackMutex = PTHREAD_MUTEX_INITIALIZER;
+static union selinux_callback callbacks[SELINUX_CB_POLICYLOAD + 1];
+
+static unsigned long avcQueryCount;
+static unsigned int pendingPolicyloadCount;
+
+static char classNames[FAKE_SELINUX_CLASS_COUNT + 1][16];
+static pthread_once_t classNamesOnce = PTHREAD_ONCE_INIT;
+
+static int defaultSetenforce(int enforcing) {
+    return 0;
+}
+
+static int defaultPolicyload(int seqno) {
+    return 0;
+}
+
+union selinux_callback selinux_get_callback(int type) {
+    pthread_mutex_lock(&callbackMutex);
+    union selinux_callback callback = callbacks[type];
+    pthread_mutex_unlock(&callbackMutex);
+    if (type == SELINUX_CB_SETENFORCE && !callback.func_setenforce) {
+        callback.func_setenforce = defaultSetenforce;
+    } else if (type == SELINUX_CB_POLICYLOAD && !callback.func_policyload) {
+        callback.func_policyload = defaultPolicyload;
+    }
+    return callback;
+}
+
+void selinux_set_callback(int type, union selinux_callback callback) {
+    pthread_mutex_lock(&callbackMutex);
+    callbacks[type] = callback;
+    pthread_mutex_unlock(&callbackMutex);
+}
+
+int avc_open(struct selinux_opt *options, unsigned int optionCount) {
+    return 0;
+}
+
+void avc_destroy(void) {}
+
+access_vector_t fake_selinux_get_allowed(security_id_t sourceSid, security_id_t targetSid,
+                                         security_class_t targetClass) {
+    uint64_t hash = mixHash(UINT64_C(0x9e3779b97f4a7c15), hashBytes64(sourceSid->ctx,
+                                                                       strlen(sourceSid->ctx)));
+    hash = mixHash(hash, hashBytes64(targetSid->ctx, strlen(targetSid->ctx)));
+    hash = mixHash(hash, targetClass);
+    return (access_vector_t) hash;
+}
+
+int avc_has_perm_noaudit(security_id_t sourceSid, security_id_t targetSid,
+                         security_class_t targetClass, access_vector_t requested,
+                         struct avc_entry_ref *entryRef, struct av_decision *decision) {
+    __atomic_fetch_add(&avcQueryCount, 1, __ATOMIC_RELAXED);
+    memset(decision, 0, sizeof(*decision));
+    decision->allowed = fake_selinux_get_allowed(sourceSid, targetSid, targetClass);
+    decision->decided = ~(access_vector_t) 0;
+    if (!requested || requested & ~decision->allowed) {
+        errno = EACCES;
+        return -1;
+    }
+    return 0;
+}
+
+unsigned long fake_selinux_get_avc_query_count(void) {
+    return __atomic_load_n(&avcQueryCount, __ATOMIC_RELAXED);
+}
+
+int avc_netlink_check_nb(void) {
+    // Called with avcMutex held, like the real one invokes the callbacks.
+    unsigned int count = __atomic_exchange_n(&pendingPolicyloadCount, 0, __ATOMIC_ACQ_REL);
+    for (unsigned int i = 0; i < count; ++i) {
+        selinux_get_callback(SELINUX_CB_POLICYLOAD).func_policyload(0);
+    }
+    return 0;
+}
+
+void fake_selinux_load_policy(void) {
+    fake_selinuxfs_advance_status(true);
+    __atomic_fetch_add(&pendingPolicyloadCount, 1, __ATOMIC_ACQ_REL);
+}
+
+static void initClassNames(void) {
+    for (int i = 1; i <= FAKE_SELINUX_CLASS_COUNT; ++i) {
+        snprintf(classNames[i], sizeof(classNames[i]), "class%d", i);
+    }
+}
+
+// Stands in for class_map.c, which would read the classes from selinuxfs.
+struct class_map {
+    int classCount;
+};
+
+static struct class_map classMap = { FAKE_SELINUX_CLASS_COUNT };
+
+struct class_map *class_map_load(void) {
+    pthread_once(&classNamesOnce, initClassNames);
+    return &classMap;
+}
+
+void class_map_destroy(struct class_map *map) {}
+
+const char *class_map_class_to_string(const struct class_map *map,
+                                      security_class_t securityClass) {
+    if (!securityClass || securityClass > map->classCount) {
+        return NULL;
+    }
+    return classNames[securityClass];
+}
+
+security_class_t class_map_string_to_class(const struct class_map *map, const char *name) {
+    int securityClass;
+    char end;
+    if (sscanf(name, "class%d%c", &securityClass, &end) != 1 || securityClass <= 0
+            || securityClass > map->classCount) {
+        return 0;
+    }
+    return (security_class_t) securityClass;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_TEST_FAKE_SELINUX_H
+#define LIBSELINUX_JNI_TEST_FAKE_SELINUX_H
+
+#include <stdbool.h>
+
+#include <selinux/avc.h>
+
+// The libselinux functions that our sources call and class_map.c, backed by a made-up policy that
+// allows a fixed pseudo-random set of permissions for each (source, target, class) tuple. Classes 1
+// to FAKE_SELINUX_CLASS_COUNT are named "class<n>".
+
+#define FAKE_SELINUX_CLASS_COUNT 64
+
+// Returns the permissions allowed by the made-up policy.
+access_vector_t fake_selinux_get_allowed(security_id_t sourceSid, security_id_t targetSid,
+                                         security_class_t targetClass);
+
+// The number of calls to avc_has_perm_noaudit() so far.
+unsigned long fake_selinux_get_avc_query_count(void);
+
+// Loads a new policy, which is noticed by the status page and by the next avc_netlink_check_nb().
+// The made-up policy itself stays the same.
+void fake_selinux_load_policy(void);
+
+#endif // LIBSELINUX_JNI_TEST_FAKE_SELINUX_H
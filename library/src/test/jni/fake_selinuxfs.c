@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#include "fake_selinuxfs.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <selinux/selinux.h>
+
+#include "selinuxfs.h"
+#include "status_page.h"
+
+static uint32_t statusSequence;
+static uint32_t statusPolicyload;
+static unsigned long transactionCount;
+static void (*transactionHook)(void);
+
+void fake_selinuxfs_advance_status(bool policyLoaded) {
+    if (policyLoaded) {
+        __atomic_fetch_add(&statusPolicyload, 1, __ATOMIC_RELAXED);
+    }
+    // Readers only look at the policy load count after the sequence.
+    __atomic_fetch_add(&statusSequence, 2, __ATOMIC_RELEASE);
+}
+
+int status_page_read(struct status_page_state *state) {
+    state->sequence = __atomic_load_n(&statusSequence, __ATOMIC_ACQUIRE);
+    state->enforcing = true;
+    state->policyload = __atomic_load_n(&statusPolicyload, __ATOMIC_RELAXED);
+    state->deny_unknown = false;
+    return 0;
+}
+
+bool status_page_policy_changed(uint32_t *policyload) {
+    struct status_page_state state;
+    status_page_read(&state);
+    bool changed = state.policyload != *policyload;
+    *policyload = state.policyload;
+    return changed;
+}
+
+unsigned long fake_selinuxfs_get_transaction_count(void) {
+    return __atomic_load_n(&transactionCount, __ATOMIC_RELAXED);
+}
+
+void fake_selinuxfs_set_transaction_hook(void (*hook)(void)) {
+    __atomic_store_n(&transactionHook, hook, __ATOMIC_RELEASE);
+}
+
+static void startTransaction(void) {
+    __atomic_fetch_add(&transactionCount, 1, __ATOMIC_RELAXED);
+    void (*hook)(void) = __atomic_load_n(&transactionHook, __ATOMIC_ACQUIRE);
+    if (hook) {
+        hook();
+    }
+}
+
+int selinuxfs_open(const char *name, int flags) {
+    errno = ENOENT;
+    return -1;
+}
+
+ssize_t selinuxfs_transaction(const char *name, const void *request, size_t requestSize,
+                              void *response, size_t responseSize) {
+    startTransaction();
+    if (strcmp(name, "context")) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (requestSize < 2 || memcmp(request, "u:", 2)) {
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+// Stands in for compute.c, which would go through the create node.
+int security_compute_create_raw(const char *sourceContext, const char *targetContext,
+                                security_class_t targetClass, char **newContext) {
+    startTransaction();
+    if (asprintf(newContext, "%s+%s:%u", sourceContext, targetContext, targetClass) == -1) {
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+#ifndef LIBSELINUX_JNI_TEST_FAKE_SELINUXFS_H
+#define LIBSELINUX_JNI_TEST_FAKE_SELINUXFS_H
+
+#include <stdbool.h>
+
+// The functions of selinuxfs.c, status_page.c and compute.c, backed by an in-memory status page.
+// The context node accepts contexts starting with "u:", and security_compute_create_raw() answers
+// "<source>+<target>:<class>" for any query.
+
+// Advances the sequence of the status page, and its policy load count if policyLoaded.
+void fake_selinuxfs_advance_status(bool policyLoaded);
+
+// The number of transactions so far, including those of security_compute_create_raw().
+unsigned long fake_selinuxfs_get_transaction_count(void);
+
+// Sets a function that is called at the start of each transaction, e.g. to load a policy in the
+// middle of one, or NULL.
+void fake_selinuxfs_set_transaction_hook(void (*hook)(void));
+
+#endif // LIBSELINUX_JNI_TEST_FAKE_SELINUXFS_H
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Checks selabel_concurrent_lookup() against selabel_lookup() of the real label_file.c, over a
+// generated file_contexts with stems, specs without a stem, file types, <<none>>, paths with
+// duplicate slashes and an empty path, so that a change in the lookup semantics of the submodule
+// fails here. Then measures both on 1 to 16 threads.
+//
+// Usage: label_file_concurrent_bench [round count per thread]
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <selinux/label.h>
+#include <selinux/selinux.h>
+
+#include "bench.h"
+#include "init_lazy.h"
+#include "label_file_concurrent.h"
+#include "label_file_memory.h"
+
+#define GROUP_COUNT 200
+
+struct Key {
+    char *path;
+    int type;
+};
+
+struct Bench {
+    struct selabel_handle *handle;
+    struct selabel_concurrent *concurrent;
+    struct Key *keys;
+    size_t keyCount;
+    unsigned long roundCount;
+};
+
+static const char *const STEMS[] = {
+    "/system", "/data", "/vendor", "/apex", "/dev", "/mnt", "/sys", "/odm"
+};
+#define STEM_COUNT (sizeof(STEMS) / sizeof(*STEMS))
+
+static void writeFileContexts(FILE *file) {
+    fputs("/.* u:object_r:default_file:s0\n", file);
+    for (int i = 0; i < GROUP_COUNT; ++i) {
+        const char *stem = STEMS[i % STEM_COUNT];
+        fprintf(file, "%s/dir_%d(/.*)? u:object_r:dir_%d:s0\n", stem, i, i);
+        fprintf(file, "%s/dir_%d/bin/[^/]+ -- u:object_r:exec_%d:s0\n", stem, i, i);
+        fprintf(file, "%s/dir_%d/lib(64)?/.*\\.so u:object_r:lib_%d:s0\n", stem, i, i);
+        fprintf(file, "%s/dir_%d/socket_[0-9]+ -s u:object_r:socket_%d:s0\n", stem, i, i);
+        fprintf(file, "%s/dir_%d/link -l u:object_r:link_%d:s0\n", stem, i, i);
+        fprintf(file, "%s/dir_%d/none <<none>>\n", stem, i);
+        fprintf(file, "/dir_%d_nostem.* u:object_r:nostem_%d:s0\n", i, i);
+        fprintf(file, "(/system|/vendor)/shared_%d -d u:object_r:shared_%d:s0\n", i, i);
+    }
+}
+
+__attribute__((format(printf, 3, 4)))
+static void addKey(struct Bench *bench, int type, const char *format, ...) {
+    bench->keys = realloc(bench->keys, (bench->keyCount + 1) * sizeof(*bench->keys));
+    CHECK(bench->keys);
+    struct Key *key = &bench->keys[bench->keyCount++];
+    va_list arguments;
+    va_start(arguments, format);
+    CHECK(vasprintf(&key->path, format, arguments) != -1);
+    va_end(arguments);
+    key->type = type;
+}
+
+static void addKeys(struct Bench *bench) {
+    for (int i = 0; i < GROUP_COUNT; ++i) {
+        const char *stem = STEMS[i % STEM_COUNT];
+        // The same path under another stem, where only the catch-all matches.
+        const char *otherStem = STEMS[(i + 1) % STEM_COUNT];
+        addKey(bench, 0, "%s/dir_%d", stem, i);
+        addKey(bench, S_IFDIR, "%s/dir_%d/sub/dir", stem, i);
+        addKey(bench, S_IFREG, "%s/dir_%d/bin/tool", stem, i);
+        addKey(bench, S_IFDIR, "%s/dir_%d/bin/tool", stem, i);
+        addKey(bench, 0, "%s/dir_%d//lib64/libfoo.so", stem, i);
+        addKey(bench, S_IFREG, "%s/dir_%d/lib/nested/libbar.so", stem, i);
+        addKey(bench, S_IFSOCK, "%s/dir_%d/socket_12", stem, i);
+        addKey(bench, S_IFREG, "%s/dir_%d/socket_12", stem, i);
+        addKey(bench, S_IFLNK, "%s/dir_%d/link", stem, i);
+        addKey(bench, S_IFREG, "%s/dir_%d/link", stem, i);
+        addKey(bench, 0, "%s/dir_%d/none", stem, i);
+        addKey(bench, 0, "%s/dir_%d/bin/tool", otherStem, i);
+        addKey(bench, S_IFREG, "/dir_%d_nostem/file", i);
+        addKey(bench, S_IFDIR, "/vendor/shared_%d", i);
+        addKey(bench, S_IFREG, "/system/shared_%d", i);
+        addKey(bench, 0, "/unknown/path_%d", i);
+    }
+    addKey(bench, 0, "%s", "");
+}
+
+static void checkLookups(struct Bench *bench) {
+    for (size_t i = 0; i < bench->keyCount; ++i) {
+        struct Key *key = &bench->keys[i];
+        char *expectedContext = NULL;
+        errno = 0;
+        int expectedResult = selabel_lookup(bench->handle, &expectedContext, key->path,
+                                            key->type);
+        int expectedErrno = errno;
+        char *context = NULL;
+        errno = 0;
+        int result = selabel_concurrent_lookup(bench->concurrent, &context, key->path, key->type);
+        int actualErrno = errno;
+        bool same = result == expectedResult && (result ? actualErrno == expectedErrno
+                : !strcmp(context, expectedContext));
+        if (!same) {
+            fprintf(stderr, "%s (%o): selabel_lookup() gave %d %s (%d), concurrent gave %d %s"
+                    " (%d)\n", key->path, key->type, expectedResult, expectedContext,
+                    expectedErrno, result, context, actualErrno);
+            exit(EXIT_FAILURE);
+        }
+        freecon(expectedContext);
+        free(context);
+    }
+}
+
+static void runLookups(void *argument, unsigned int threadIndex) {
+    struct Bench *bench = argument;
+    for (unsigned long i = 0; i < bench->roundCount; ++i) {
+        for (size_t j = 0; j < bench->keyCount; ++j) {
+            // Start at a different key on each thread.
+            struct Key *key = &bench->keys[(j + threadIndex * bench->keyCount
+                    / BENCH_MAX_THREAD_COUNT) % bench->keyCount];
+            char *context = NULL;
+            selabel_lookup(bench->handle, &context, key->path, key->type);
+            freecon(context);
+        }
+    }
+}
+
+static void runConcurrentLookups(void *argument, unsigned int threadIndex) {
+    struct Bench *bench = argument;
+    for (unsigned long i = 0; i < bench->roundCount; ++i) {
+        for (size_t j = 0; j < bench->keyCount; ++j) {
+            struct Key *key = &bench->keys[(j + threadIndex * bench->keyCount
+                    / BENCH_MAX_THREAD_COUNT) % bench->keyCount];
+            char *context = NULL;
+            selabel_concurrent_lookup(bench->concurrent, &context, key->path, key->type);
+            free(context);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    struct Bench bench = { .keys = NULL, .keyCount = 0 };
+    bench.roundCount = getCountArgument(argc, argv, 1, 20);
+    selinux_lazy_init();
+    char path[] = "/tmp/file_contexts.XXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd != -1);
+    FILE *file = fdopen(fd, "w");
+    CHECK(file);
+    writeFileContexts(file);
+    CHECK(!fclose(file));
+    struct selinux_opt options[] = {
+        { SELABEL_OPT_PATH, path }
+    };
+    bench.handle = selabel_open(SELABEL_CTX_FILE, options, 1);
+    CHECK(bench.handle);
+    struct selabel_handle *pooledHandle = selabel_open_pooled(SELABEL_CTX_FILE, options, 1);
+    CHECK(pooledHandle);
+    bench.concurrent = selabel_concurrent_create(pooledHandle, false);
+    CHECK(bench.concurrent);
+    unlink(path);
+    addKeys(&bench);
+
+    // Also compiles every regex that can be reached, so that runs only measure matching.
+    checkLookups(&bench);
+    for (unsigned int threadCount = 1; threadCount <= BENCH_MAX_THREAD_COUNT; threadCount *= 2) {
+        uint64_t lookups = (uint64_t) threadCount * bench.roundCount * bench.keyCount;
+        uint64_t nanos = runThreads(threadCount, runLookups, &bench);
+        uint64_t concurrentNanos = runThreads(threadCount, runConcurrentLookups, &bench);
+        printf("%2u threads: %8.2f k lookups/s selabel_lookup, %8.2f k lookups/s concurrent\n",
+               threadCount, (double) lookups * 1000000 / (double) nanos,
+               (double) lookups * 1000000 / (double) concurrentNanos);
+    }
+    // Nothing may have changed under the lookups from many threads.
+    checkLookups(&bench);
+
+    selabel_concurrent_destroy(bench.concurrent);
+    selabel_close(bench.handle);
+    for (size_t i = 0; i < bench.keyCount; ++i) {
+        free(bench.keys[i].path);
+    }
+    free(bench.keys);
+    return 0;
+}
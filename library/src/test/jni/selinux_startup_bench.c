@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Measures the time from loading the library to its first call, like System.loadLibrary() in the
+// static initializer of SeLinux followed by SeLinux.is_selinux_enabled(). Each round loads the
+// library with dlopen() in a new process, once with libselinux initialized on load, like the
+// constructor of init.c used to do, and once with it initialized by the first call, and checks
+// that loading alone leaves it uninitialized.
+//
+// Usage: selinux_startup_bench [round count]
+
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+struct Timing {
+    uint64_t loadNanos;
+    uint64_t firstCallNanos;
+};
+
+static void loadAndCall(bool initOnLoad, struct Timing *timing) {
+    uint64_t startNanos = getNanos();
+    void *module = dlopen(SELINUX_STARTUP_MODULE, RTLD_NOW | RTLD_LOCAL);
+    timing->loadNanos = getNanos() - startNanos;
+    CHECK(module);
+    void (*lazyInit)(void) = (void (*)(void)) dlsym(module, "selinux_lazy_init");
+    int (*firstCall)(void) = (int (*)(void)) dlsym(module, "selinux_startup_first_call");
+    bool (*isInitialized)(void) = (bool (*)(void)) dlsym(module,
+                                                         "selinux_startup_is_initialized");
+    CHECK(lazyInit && firstCall && isInitialized);
+    if (initOnLoad) {
+        startNanos = getNanos();
+        lazyInit();
+        timing->loadNanos += getNanos() - startNanos;
+    }
+    CHECK(isInitialized() == initOnLoad);
+    startNanos = getNanos();
+    firstCall();
+    timing->firstCallNanos = getNanos() - startNanos;
+    CHECK(isInitialized());
+}
+
+static void runRound(bool initOnLoad, struct Timing *timing) {
+    // So that a child failing a check doesn't print it again.
+    fflush(stdout);
+    int fds[2];
+    CHECK(!pipe(fds));
+    pid_t pid = fork();
+    CHECK(pid != -1);
+    if (!pid) {
+        close(fds[0]);
+        struct Timing childTiming;
+        loadAndCall(initOnLoad, &childTiming);
+        CHECK(write(fds[1], &childTiming, sizeof(childTiming)) == sizeof(childTiming));
+        _exit(EXIT_SUCCESS);
+    }
+    close(fds[1]);
+    ssize_t size = read(fds[0], timing, sizeof(*timing));
+    close(fds[0]);
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    CHECK(size == sizeof(*timing));
+}
+
+static void runRounds(const char *label, bool initOnLoad, unsigned long roundCount) {
+    uint64_t loadNanos = 0;
+    uint64_t firstCallNanos = 0;
+    for (unsigned long i = 0; i < roundCount; ++i) {
+        struct Timing timing;
+        runRound(initOnLoad, &timing);
+        loadNanos += timing.loadNanos;
+        firstCallNanos += timing.firstCallNanos;
+    }
+    printf("%-18s %8.1f us load, %8.1f us first call, %8.1f us load to first call\n", label,
+           (double) loadNanos / 1000 / (double) roundCount,
+           (double) firstCallNanos / 1000 / (double) roundCount,
+           (double) (loadNanos + firstCallNanos) / 1000 / (double) roundCount);
+}
+
+int main(int argc, char **argv) {
+    unsigned long roundCount = getCountArgument(argc, argv, 1, 200);
+    runRounds("init on load", true, roundCount);
+    runRounds("init on first call", false, roundCount);
+    return 0;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Linked with the library into the module that selinux_startup_bench loads, which only exports
+// these and what they pull in.
+
+#include <stdbool.h>
+
+#include <selinux/selinux.h>
+
+#include "init_lazy.h"
+#include "selinux_internal.h"
+
+// What a JNI function like SeLinux.is_selinux_enabled() does.
+int selinux_startup_first_call(void) {
+    selinux_lazy_init();
+    return is_selinux_enabled();
+}
+
+// init_lib() of init.c sets selinux_page_size first.
+bool selinux_startup_is_initialized(void) {
+    return selinux_page_size;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Counts the system calls and path lookups of queries through compute.c, which opens each node
+// relative to the selinuxfs directory that selinuxfs.c keeps open, against opening the node by its
+// full path like compute_av.c and compute_create.c in libselinux. A transaction node only takes
+// one write per open file, so both need an open, a write, a read and a close per query, but
+// opening by path looks up every component from the root. A directory of regular files stands in
+// for selinuxfs, so responses are empty and queries fail, but only after the same system calls.
+//
+// Usage: selinuxfs_syscall_bench [query count]
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <selinux/selinux.h>
+
+#include "bench.h"
+#include "init_lazy.h"
+#include "mapping.h"
+
+// The libselinux internals that selinuxfs.c and compute.c use, without a class mapping.
+
+char *selinux_mnt;
+
+void selinux_lazy_init(void) {}
+
+security_class_t unmap_class(security_class_t tclass) {
+    return tclass;
+}
+
+access_vector_t unmap_perm(security_class_t tclass, access_vector_t tperm) {
+    return tperm;
+}
+
+void map_decision(security_class_t tclass, struct av_decision *avd) {}
+
+int selinux_trans_to_raw_context(const char *trans, char **rawp) {
+    *rawp = strdup(trans);
+    return *rawp ? 0 : -1;
+}
+
+int selinux_raw_to_trans_context(const char *raw, char **transp) {
+    *transp = strdup(raw);
+    return *transp ? 0 : -1;
+}
+
+void freecon(char *con) {
+    free(con);
+}
+
+// System calls, wrapped with -Wl,--wrap.
+
+struct SyscallCounts {
+    unsigned long syscalls;
+    unsigned long pathComponents;
+};
+
+static struct SyscallCounts counts;
+
+static unsigned long countPathComponents(const char *path) {
+    unsigned long count = 0;
+    for (const char *pathChar = path; *pathChar; ++pathChar) {
+        if (*pathChar != '/' && (pathChar == path || pathChar[-1] == '/')) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+int __real_open(const char *path, int flags, ...);
+int __real_openat(int directoryFd, const char *path, int flags, ...);
+ssize_t __real_read(int fd, void *buffer, size_t size);
+ssize_t __real_write(int fd, const void *buffer, size_t size);
+int __real_close(int fd);
+
+int __wrap_open(const char *path, int flags, ...) {
+    va_list arguments;
+    va_start(arguments, flags);
+    mode_t mode = flags & O_CREAT ? va_arg(arguments, mode_t) : 0;
+    va_end(arguments);
+    ++counts.syscalls;
+    counts.pathComponents += countPathComponents(path);
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_openat(int directoryFd, const char *path, int flags, ...) {
+    va_list arguments;
+    va_start(arguments, flags);
+    mode_t mode = flags & O_CREAT ? va_arg(arguments, mode_t) : 0;
+    va_end(arguments);
+    ++counts.syscalls;
+    counts.pathComponents += countPathComponents(path);
+    return __real_openat(directoryFd, path, flags, mode);
+}
+
+ssize_t __wrap_read(int fd, void *buffer, size_t size) {
+    ++counts.syscalls;
+    return __real_read(fd, buffer, size);
+}
+
+ssize_t __wrap_write(int fd, const void *buffer, size_t size) {
+    ++counts.syscalls;
+    return __real_write(fd, buffer, size);
+}
+
+int __wrap_close(int fd) {
+    ++counts.syscalls;
+    return __real_close(fd);
+}
+
+// What compute_av.c and compute_create.c in libselinux do for each query.
+static void transactByPath(const char *name, const char *request) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", selinux_mnt, name);
+    int fd = open(path, O_RDWR | O_CLOEXEC);
+    CHECK(fd != -1);
+    CHECK(write(fd, request, strlen(request)) != -1);
+    char response[128];
+    CHECK(read(fd, response, sizeof(response) - 1) != -1);
+    close(fd);
+}
+
+static void queryByPath(unsigned long index) {
+    char request[128];
+    snprintf(request, sizeof(request), "u:r:source_%lu:s0 u:object_r:target_%lu:s0 %lu %x",
+             index % 64, index / 64 % 64, index % 32 + 1, 1u);
+    transactByPath(index % 2 ? "access" : "create", request);
+}
+
+static void queryThroughCompute(unsigned long index) {
+    char sourceContext[64];
+    char targetContext[64];
+    snprintf(sourceContext, sizeof(sourceContext), "u:r:source_%lu:s0", index % 64);
+    snprintf(targetContext, sizeof(targetContext), "u:object_r:target_%lu:s0", index / 64 % 64);
+    security_class_t targetClass = (security_class_t) (index % 32 + 1);
+    if (index % 2) {
+        struct av_decision decision;
+        security_compute_av_flags_raw(sourceContext, targetContext, targetClass, 1, &decision);
+    } else {
+        char *newContext = NULL;
+        if (!security_compute_create_raw(sourceContext, targetContext, targetClass,
+                                         &newContext)) {
+            freecon(newContext);
+        }
+    }
+}
+
+static void runQueries(const char *label, void (*query)(unsigned long), unsigned long queryCount,
+                       struct SyscallCounts *queryCounts) {
+    // Leaves out opening the directory once.
+    query(0);
+    counts.syscalls = 0;
+    counts.pathComponents = 0;
+    uint64_t startNanos = getNanos();
+    for (unsigned long i = 0; i < queryCount; ++i) {
+        query(i);
+    }
+    uint64_t nanos = getNanos() - startNanos;
+    *queryCounts = counts;
+    printf("%-14s %5.2f system calls, %5.2f path components, %6.0f ns per query\n", label,
+           (double) counts.syscalls / (double) queryCount,
+           (double) counts.pathComponents / (double) queryCount,
+           (double) nanos / (double) queryCount);
+}
+
+static void createNode(const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", selinux_mnt, name);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    CHECK(fd != -1);
+    close(fd);
+}
+
+static void removeNode(const char *name) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", selinux_mnt, name);
+    unlink(path);
+}
+
+int main(int argc, char **argv) {
+    unsigned long queryCount = getCountArgument(argc, argv, 1, 100000);
+    char root[] = "/tmp/selinuxfs.XXXXXX";
+    CHECK(mkdtemp(root));
+    // Nested like /sys/fs/selinux.
+    char mountPoint[PATH_MAX];
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys", root);
+    CHECK(!mkdir(mountPoint, 0700));
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys/fs", root);
+    CHECK(!mkdir(mountPoint, 0700));
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys/fs/selinux", root);
+    CHECK(!mkdir(mountPoint, 0700));
+    selinux_mnt = mountPoint;
+    createNode("access");
+    createNode("create");
+
+    struct SyscallCounts byPathCounts;
+    runQueries("by path", queryByPath, queryCount, &byPathCounts);
+    struct SyscallCounts throughComputeCounts;
+    runQueries("through dirfd", queryThroughCompute, queryCount, &throughComputeCounts);
+    CHECK(throughComputeCounts.syscalls <= byPathCounts.syscalls);
+    CHECK(throughComputeCounts.pathComponents == queryCount);
+
+    removeNode("access");
+    removeNode("create");
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys/fs/selinux", root);
+    rmdir(mountPoint);
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys/fs", root);
+    rmdir(mountPoint);
+    snprintf(mountPoint, sizeof(mountPoint), "%s/sys", root);
+    rmdir(mountPoint);
+    rmdir(root);
+    return 0;
+}
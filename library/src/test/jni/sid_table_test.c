@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Hai Zhang <dreaming.in.code.zh@gmail.com>
+ * All Rights Reserved.
+ */
+
+// Interns the same contexts from several threads at once, each in a different order, so that
+// inserts race with each other, with lock-free lookups and with incremental rehashing. Every thread
+// must get the same SID for a context, and the table must end up with each context exactly once.
+//
+// Usage: sid_table_test [context count]
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "sid_table.h"
+
+#define THREAD_COUNT 4
+
+struct Test {
+    struct sid_table *table;
+    unsigned long contextCount;
+    security_id_t *sids[THREAD_COUNT];
+};
+
+static void formatContext(char *context, size_t size, unsigned long index) {
+    snprintf(context, size, "u:object_r:type_%lu:s0:c%lu", index, index % 1024);
+}
+
+static void internContexts(void *argument, unsigned int threadIndex) {
+    struct Test *test = argument;
+    security_id_t *sids = test->sids[threadIndex];
+    char context[64];
+    for (unsigned long i = 0; i < test->contextCount; ++i) {
+        // Odd threads go backwards, so that they meet the even ones halfway.
+        unsigned long index = threadIndex % 2 ? test->contextCount - 1 - i : i;
+        index = (index + threadIndex / 2 * test->contextCount / THREAD_COUNT) % test->contextCount;
+        formatContext(context, sizeof(context), index);
+        security_id_t sid;
+        CHECK(!sid_table_context_to_sid(test->table, context, &sid));
+        CHECK(!strcmp(sid->ctx, context));
+        sids[index] = sid;
+    }
+}
+
+int main(int argc, char **argv) {
+    struct Test test;
+    test.contextCount = getCountArgument(argc, argv, 1, 100000);
+    test.table = sid_table_create();
+    CHECK(test.table);
+    for (unsigned int i = 0; i < THREAD_COUNT; ++i) {
+        test.sids[i] = calloc(test.contextCount, sizeof(*test.sids[i]));
+        CHECK(test.sids[i]);
+    }
+    uint64_t nanos = runThreads(THREAD_COUNT, internContexts, &test);
+
+    CHECK(sid_table_get_count(test.table) == test.contextCount);
+    char context[64];
+    for (unsigned long i = 0; i < test.contextCount; ++i) {
+        for (unsigned int j = 1; j < THREAD_COUNT; ++j) {
+            CHECK(test.sids[j][i] == test.sids[0][i]);
+        }
+        formatContext(context, sizeof(context), i);
+        security_id_t sid;
+        CHECK(!sid_table_context_to_sid(test.table, context, &sid));
+        CHECK(sid == test.sids[0][i]);
+    }
+    CHECK(sid_table_get_count(test.table) == test.contextCount);
+    struct sid_table_stats stats;
+    sid_table_get_stats(test.table, &stats);
+    size_t histogramCount = 0;
+    for (size_t i = 0; i < SID_TABLE_PROBE_HISTOGRAM_SIZE; ++i) {
+        histogramCount += stats.probe_histogram[i];
+    }
+    CHECK(stats.count == test.contextCount);
+    CHECK(histogramCount == test.contextCount);
+    CHECK(stats.capacity >= stats.count);
+    printf("%lu contexts on %d threads in %.2f ms, capacity %zu, %zu found on the first probe\n",
+           test.contextCount, THREAD_COUNT, (double) nanos / 1000000, stats.capacity,
+           stats.probe_histogram[0]);
+
+    for (unsigned int i = 0; i < THREAD_COUNT; ++i) {
+        free(test.sids[i]);
+    }
+    sid_table_destroy(test.table);
+    return 0;
+}